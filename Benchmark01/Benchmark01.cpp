@@ -0,0 +1,557 @@
+// Benchmark comparing LayeredAttributes_v2 with the dense LayeredAttributes_v7 engine,
+// the composed-transfer LayeredAttributes_v8 engine and the sorted-vector LayeredAttributes_v9 engine
+//
+// All engines are driven by the same pre-generated call sequence spread over a board of objects,
+// once with a read-heavy mix and once with a write-heavy mix. A third workload grows one deep stack
+// with effects arriving in random layer order and reads after every insert, and a fourth loads a
+// saved game's worth of effects one by one and, for v7 and v9, as one batch. A fifth keeps changing the
+// base value under a fixed stack and reads after every change. The last applies board-wide
+// effects to an AttributeWorld per entity, through the batched column kernel and as group effects.
+// A game-tree search is imitated by forking one loaded object over and over and changing each
+// child once, either its base values or its effects. Finally a board change dirties every entity
+// of a world, which is then read lazily or recomputed up front on a work-stealing pool, and a
+// full board goes through end-of-turn cleanup either by clearing and re-adding its static effects
+// or by letting "until end of turn" effects expire. Permanents then leave play one at a time, with
+// their effects removed either by clearing the board and replaying the survivors or by source.
+// The checksum of every value read is printed so the engines can be seen to agree. Build in Release
+// for meaningful numbers.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/AttributeWorld.hpp"
+#include "../src/ColumnKernels.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/LayeredAttributes_v7.hpp"
+#include "../src/LayeredAttributes_v8.hpp"
+#include "../src/LayeredAttributes_v9.hpp"
+#include "../src/WorkStealingPool.hpp"
+
+namespace {
+
+enum class CallType { Read, SetBase, AddEffect, Clear };
+
+struct Call {
+    CallType type;
+    size_t object;
+    LayeredEffectDefinition effect;
+};
+
+std::vector<Call> makeCalls(size_t objectCount, size_t callCount, int readPercent, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<size_t> object(0, objectCount - 1);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+    std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(-3, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+
+    std::vector<Call> calls;
+    calls.reserve(callCount);
+    for (size_t i = 0; i < callCount; ++i) {
+        Call call{ CallType::Read, object(rng), { AttributeKey(key(rng)), EffectOperation_Invalid, 0, 0 } };
+        int roll = percent(rng);
+        if (roll < readPercent) {
+            call.type = CallType::Read;
+        }
+        else if (roll == 99) {
+            // end of turn for this object
+            call.type = CallType::Clear;
+        }
+        else if (roll % 8 == 0) {
+            call.type = CallType::SetBase;
+            call.effect.Modification = modifier(rng);
+        }
+        else {
+            call.type = CallType::AddEffect;
+            call.effect = { AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+        }
+        calls.push_back(call);
+    }
+    return calls;
+}
+
+template <typename Implementation>
+void runWorkload(const std::string& engineName, const std::string& mixName, size_t objectCount, const std::vector<Call>& calls) {
+    std::vector<Implementation> board(objectCount);
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& call : calls) {
+        auto& attributes = board[call.object];
+        switch (call.type) {
+        case CallType::Read:
+            checksum += attributes.GetCurrentAttribute(call.effect.Attribute);
+            break;
+        case CallType::SetBase:
+            attributes.SetBaseAttribute(call.effect.Attribute, call.effect.Modification);
+            break;
+        case CallType::AddEffect:
+            attributes.AddLayeredEffect(call.effect);
+            break;
+        case CallType::Clear:
+            attributes.ClearLayeredEffects();
+            break;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << mixName << "\t" << engineName << "\t"
+        << nanoseconds / static_cast<double>(calls.size()) << " ns/op\t"
+        << "checksum " << checksum << "\n";
+}
+
+template <typename Implementation>
+void runDeepStack(const std::string& engineName, size_t effectCount) {
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> layer(1, 100);
+    std::uniform_int_distribution<int> modifier(1, 3);
+    Implementation attributes;
+    attributes.SetBaseAttribute(AttributeKey_Power, 1);
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < effectCount; ++i) {
+        attributes.AddLayeredEffect({ AttributeKey_Power, (i % 3) ? EffectOperation_Add : EffectOperation_Subtract, modifier(rng), layer(rng) });
+        checksum += attributes.GetCurrentAttribute(AttributeKey_Power);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << "deep stack (" << effectCount << " out-of-order effects)\t" << engineName << "\t"
+        << nanoseconds / static_cast<double>(effectCount) << " ns/op\t"
+        << "checksum " << checksum << "\n";
+}
+
+// A fixed stack of arithmetic and bitwise effects in random layers; the base value changes before
+// every read, which is what a board does when counters, copies or controllers change.
+template <typename Implementation>
+void runBaseChanges(const std::string& engineName, size_t effectCount) {
+    const size_t reads = 2000000;
+    std::mt19937 rng(9);
+    const EffectOperation operations[] = { EffectOperation_Add, EffectOperation_Subtract, EffectOperation_BitwiseOr, EffectOperation_BitwiseXor };
+    std::uniform_int_distribution<size_t> operation(0, std::size(operations) - 1);
+    std::uniform_int_distribution<int> modifier(1, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    Implementation attributes;
+    for (size_t i = 0; i < effectCount; ++i) {
+        attributes.AddLayeredEffect({ AttributeKey_Power, operations[operation(rng)], modifier(rng), layer(rng) });
+    }
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < reads; ++i) {
+        attributes.SetBaseAttribute(AttributeKey_Power, static_cast<int>(i % 7));
+        checksum += attributes.GetCurrentAttribute(AttributeKey_Power);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << "base changes (" << effectCount << " effects)\t" << engineName << "\t"
+        << nanoseconds / static_cast<double>(reads) << " ns/op\t"
+        << "checksum " << checksum << "\n";
+}
+
+std::vector<LayeredEffectDefinition> makeSavedGame(size_t effectCount) {
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+    std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(-3, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    std::vector<LayeredEffectDefinition> effects;
+    effects.reserve(effectCount);
+    for (size_t i = 0; i < effectCount; ++i) {
+        effects.push_back({ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) });
+    }
+    return effects;
+}
+
+template <typename Implementation, typename Load>
+void runBulkLoad(const std::string& engineName, const std::vector<LayeredEffectDefinition>& savedGame, Load load) {
+    const size_t repetitions = 20;
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repetitions; ++i) {
+        Implementation attributes;
+        load(attributes, savedGame);
+        for (int key = AttributeKey_Power; key <= AttributeKey_Controller; ++key) {
+            checksum += attributes.GetCurrentAttribute(AttributeKey(key));
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << "bulk load (" << savedGame.size() << " effects)\t" << engineName << "\t"
+        << nanoseconds / static_cast<double>(repetitions * savedGame.size()) << " ns/effect\t"
+        << "checksum " << checksum << "\n";
+}
+
+template <typename Implementation>
+void loadOneByOne(Implementation& attributes, const std::vector<LayeredEffectDefinition>& savedGame) {
+    for (const auto& effect : savedGame) {
+        attributes.AddLayeredEffect(effect);
+    }
+}
+
+enum class MassEffectMode { PerEntity, Batched, Group };
+
+// Board-wide effects on an AttributeWorld: each round adds an anthem-style effect to every
+// creature (one entity at a time, as one batched call, or once for a group holding every
+// creature), then reads the column back. Every tenth round the effects end.
+void runMassEffect(size_t entityCount, MassEffectMode mode) {
+    const size_t rounds = 50;
+    AttributeWorld world;
+    std::vector<AttributeWorld::Entity> creatures;
+    for (size_t i = 0; i < entityCount; ++i) {
+        creatures.push_back(world.CreateEntity());
+        world.SetBaseAttribute(creatures.back(), AttributeKey_Power, static_cast<int>(i % 5));
+    }
+    auto everyCreature = world.CreateGroup();
+    if (mode == MassEffectMode::Group) {
+        for (const auto& creature : creatures) {
+            world.AddToGroup(everyCreature, creature);
+        }
+    }
+    std::vector<AttributeWorld::GroupEffect> groupEffects;
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        LayeredEffectDefinition anthem{ AttributeKey_Power, (round % 2) ? EffectOperation_Add : EffectOperation_Subtract, 2, 7 };
+        if (mode == MassEffectMode::Batched) {
+            world.AddLayeredEffect(creatures, anthem);
+        }
+        else if (mode == MassEffectMode::Group) {
+            groupEffects.push_back(world.AddGroupEffect(everyCreature, anthem));
+        }
+        else {
+            for (const auto& creature : creatures) {
+                world.AddLayeredEffect(creature, anthem);
+            }
+        }
+        checksum += world.GetCurrentColumn(AttributeKey_Power)[round % entityCount];
+        if (round % 10 == 9) {
+            // end of turn
+            if (mode == MassEffectMode::Group) {
+                for (const auto& groupEffect : groupEffects) {
+                    world.RemoveGroupEffect(groupEffect);
+                }
+                groupEffects.clear();
+            }
+            else {
+                for (const auto& creature : creatures) {
+                    world.ClearLayeredEffects(creature);
+                }
+            }
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::string modeName = "AttributeWorld per entity";
+    if (mode == MassEffectMode::Batched) {
+        modeName = std::string("AttributeWorld batched (") + ColumnKernels::LevelName(ColumnKernels::DetectedLevel()) + ")";
+    }
+    else if (mode == MassEffectMode::Group) {
+        modeName = "AttributeWorld group effect";
+    }
+    std::cout << "mass effect (" << entityCount << " entities)\t" << modeName << "\t"
+        << nanoseconds / static_cast<double>(rounds * entityCount) << " ns/entity\t"
+        << "checksum " << checksum << "\n";
+}
+
+// One search node per iteration: fork the loaded parent, change the child once and evaluate it.
+// v2 has no fork, so it is copied.
+template <typename Implementation, typename Fork>
+void runFork(const std::string& engineName, const std::vector<LayeredEffectDefinition>& parentEffects, bool addEffect, Fork fork) {
+    const size_t nodes = 100000;
+    Implementation parent;
+    for (const auto& effect : parentEffects) {
+        parent.AddLayeredEffect(effect);
+    }
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nodes; ++i) {
+        Implementation child = fork(parent);
+        if (addEffect) {
+            child.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, static_cast<int>(i % 3), 7 });
+        }
+        else {
+            child.SetBaseAttribute(AttributeKey_Toughness, static_cast<int>(i % 5));
+        }
+        checksum += child.GetCurrentAttribute(AttributeKey_Power) + child.GetCurrentAttribute(AttributeKey_Toughness);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << "fork + " << (addEffect ? "add effect" : "set base") << " (" << parentEffects.size() << " effects)\t" << engineName << "\t"
+        << nanoseconds / static_cast<double>(nodes) << " ns/node\t"
+        << "checksum " << checksum << "\n";
+}
+
+// Every round changes the base value of every entity, which leaves every stack dirty, then
+// reads every attribute of every entity. threadCount 0 reads lazily, otherwise RecomputeDirty
+// runs on a pool with that many threads first.
+void runRecomputeDirty(size_t entityCount, size_t threadCount) {
+    const size_t rounds = 10;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+    std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(-3, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    AttributeWorld world;
+    std::vector<AttributeWorld::Entity> entities;
+    for (size_t i = 0; i < entityCount; ++i) {
+        entities.push_back(world.CreateEntity());
+        for (int effect = 0; effect < 20; ++effect) {
+            world.AddLayeredEffect(entities.back(), { AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) });
+        }
+    }
+    WorkStealingPool pool(std::max<size_t>(1, threadCount));
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (const auto& entity : entities) {
+            for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute) {
+                world.SetBaseAttribute(entity, AttributeKey(attribute), static_cast<int>(round));
+            }
+        }
+        if (threadCount != 0) {
+            world.RecomputeDirty(pool);
+        }
+        for (const auto& entity : entities) {
+            for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute) {
+                checksum += world.GetCurrentAttribute(entity, AttributeKey(attribute));
+            }
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::string modeName = threadCount == 0 ? std::string("lazy reads") : "RecomputeDirty, " + std::to_string(pool.ThreadCount()) + " threads";
+    std::cout << "dirty board (" << entityCount << " entities)\t" << modeName << "\t"
+        << nanoseconds / static_cast<double>(rounds * entityCount) << " ns/entity\t"
+        << "checksum " << checksum << "\n";
+}
+
+// Every creature has three static effects and gets two "until end of turn" effects per turn.
+// At the end of the turn they go away either by ClearLayeredEffects plus re-adding the statics
+// or through AdvanceTime; the board is read after each cleanup.
+void runEndOfTurn(size_t entityCount, bool expire) {
+    const size_t turns = 20;
+    AttributeWorld world;
+    std::vector<AttributeWorld::Entity> creatures;
+    const LayeredEffectDefinition statics[] = {
+        { AttributeKey_Power, EffectOperation_Add, 1, 7 },
+        { AttributeKey_Toughness, EffectOperation_Add, 1, 7 },
+        { AttributeKey_Types, EffectOperation_BitwiseOr, 4, 4 } };
+    for (size_t i = 0; i < entityCount; ++i) {
+        creatures.push_back(world.CreateEntity());
+        world.SetBaseAttribute(creatures.back(), AttributeKey_Power, static_cast<int>(i % 5));
+        for (const auto& effect : statics) {
+            world.AddLayeredEffect(creatures.back(), effect);
+        }
+    }
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t turn = 0; turn < turns; ++turn) {
+        for (const auto& creature : creatures) {
+            LayeredEffectDefinition giantGrowth{ AttributeKey_Power, EffectOperation_Add, 3, 7 };
+            LayeredEffectDefinition weakness{ AttributeKey_Toughness, EffectOperation_Subtract, 1, 7 };
+            if (expire) {
+                world.AddLayeredEffect(creature, giantGrowth, turn + 1);
+                world.AddLayeredEffect(creature, weakness, turn + 1);
+            }
+            else {
+                world.AddLayeredEffect(creature, giantGrowth);
+                world.AddLayeredEffect(creature, weakness);
+            }
+        }
+        if (expire) {
+            world.AdvanceTime(turn + 1);
+        }
+        else {
+            for (const auto& creature : creatures) {
+                world.ClearLayeredEffects(creature);
+                for (const auto& effect : statics) {
+                    world.AddLayeredEffect(creature, effect);
+                }
+            }
+        }
+        checksum += world.GetCurrentColumn(AttributeKey_Power)[turn % entityCount];
+        checksum += world.GetCurrentColumn(AttributeKey_Toughness)[turn % entityCount];
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << "end of turn (" << entityCount << " entities)\t" << (expire ? "AdvanceTime" : "clear + re-add statics") << "\t"
+        << nanoseconds / static_cast<double>(turns * entityCount) << " ns/entity\t"
+        << "checksum " << checksum << "\n";
+}
+
+// Every permanent puts a few effects on random creatures. Each time one leaves play and
+// another enters, the leaving permanent's effects are removed either by clearing every
+// creature and replaying the effects of the permanents still in play, or through
+// RemoveEffectsFromSource; the board is read after each departure.
+void runLeavesPlay(size_t creatureCount, size_t permanentCount, bool bySource) {
+    const size_t effectsPerPermanent = 20;
+    const size_t departures = 200;
+    struct Placed {
+        size_t creature;
+        LayeredEffectDefinition effect;
+    };
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> creature(0, creatureCount - 1);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Toughness);
+    std::uniform_int_distribution<int> operation(EffectOperation_Add, EffectOperation_Subtract);
+    std::uniform_int_distribution<int> modifier(1, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    auto makePermanent = [&]() {
+        std::vector<Placed> placed;
+        for (size_t i = 0; i < effectsPerPermanent; ++i) {
+            placed.push_back({ creature(rng), { AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) } });
+        }
+        return placed;
+    };
+
+    AttributeWorld world;
+    std::vector<AttributeWorld::Entity> creatures;
+    for (size_t i = 0; i < creatureCount; ++i) {
+        creatures.push_back(world.CreateEntity());
+        world.SetBaseAttribute(creatures.back(), AttributeKey_Power, static_cast<int>(i % 5));
+    }
+    // permanents in the order they entered play
+    std::vector<std::vector<Placed>> inPlay;
+    std::vector<AttributeWorld::Source> sources;
+    auto enter = [&](std::vector<Placed> placed) {
+        sources.push_back(world.CreateSource());
+        for (const auto& entry : placed) {
+            if (bySource) {
+                world.AddLayeredEffect(creatures[entry.creature], entry.effect, sources.back());
+            }
+            else {
+                world.AddLayeredEffect(creatures[entry.creature], entry.effect);
+            }
+        }
+        inPlay.push_back(std::move(placed));
+    };
+    for (size_t i = 0; i < permanentCount; ++i) {
+        enter(makePermanent());
+    }
+    std::vector<std::vector<Placed>> entering;
+    std::vector<size_t> leaving;
+    for (size_t i = 0; i < departures; ++i) {
+        entering.push_back(makePermanent());
+        leaving.push_back(std::uniform_int_distribution<size_t>(0, permanentCount - 1)(rng));
+    }
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < departures; ++i) {
+        size_t gone = leaving[i];
+        if (bySource) {
+            world.DestroySource(sources[gone]);
+        }
+        else {
+            for (const auto& entity : creatures) {
+                world.ClearLayeredEffects(entity);
+            }
+            for (size_t permanent = 0; permanent < inPlay.size(); ++permanent) {
+                if (permanent == gone) {
+                    continue;
+                }
+                for (const auto& entry : inPlay[permanent]) {
+                    world.AddLayeredEffect(creatures[entry.creature], entry.effect);
+                }
+            }
+        }
+        inPlay.erase(inPlay.begin() + gone);
+        sources.erase(sources.begin() + gone);
+        enter(std::move(entering[i]));
+        checksum += world.GetCurrentColumn(AttributeKey_Power)[i % creatureCount];
+        checksum += world.GetCurrentColumn(AttributeKey_Toughness)[i % creatureCount];
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    std::cout << "leaves play (" << permanentCount << " permanents, " << creatureCount << " creatures)\t"
+        << (bySource ? "RemoveEffectsFromSource" : "clear + replay survivors") << "\t"
+        << nanoseconds / static_cast<double>(departures) << " ns/departure\t"
+        << "checksum " << checksum << "\n";
+}
+
+} // namespace
+
+int main() {
+    const size_t objectCount = 2000;
+    const size_t callCount = 4000000;
+
+    struct Mix { std::string name; int readPercent; };
+    const Mix mixes[] = { { "read-heavy (90% reads)", 90 }, { "write-heavy (10% reads)", 10 } };
+
+    for (const auto& mix : mixes) {
+        auto calls = makeCalls(objectCount, callCount, mix.readPercent, 2025);
+        runWorkload<LayeredAttributes_v2>("LayeredAttributes_v2", mix.name, objectCount, calls);
+        runWorkload<LayeredAttributes_v7>("LayeredAttributes_v7", mix.name, objectCount, calls);
+        runWorkload<LayeredAttributes_v8>("LayeredAttributes_v8", mix.name, objectCount, calls);
+        runWorkload<LayeredAttributes_v9>("LayeredAttributes_v9", mix.name, objectCount, calls);
+    }
+
+    const size_t deepStackSize = 20000;
+    runDeepStack<LayeredAttributes_v2>("LayeredAttributes_v2", deepStackSize);
+    runDeepStack<LayeredAttributes_v7>("LayeredAttributes_v7", deepStackSize);
+    runDeepStack<LayeredAttributes_v8>("LayeredAttributes_v8", deepStackSize);
+    runDeepStack<LayeredAttributes_v9>("LayeredAttributes_v9", deepStackSize);
+
+    for (size_t effectCount : { 8, 64 }) {
+        runBaseChanges<LayeredAttributes_v2>("LayeredAttributes_v2", effectCount);
+        runBaseChanges<LayeredAttributes_v7>("LayeredAttributes_v7", effectCount);
+        runBaseChanges<LayeredAttributes_v8>("LayeredAttributes_v8", effectCount);
+        runBaseChanges<LayeredAttributes_v9>("LayeredAttributes_v9", effectCount);
+    }
+
+    auto savedGame = makeSavedGame(50000);
+    runBulkLoad<LayeredAttributes_v2>("LayeredAttributes_v2", savedGame, loadOneByOne<LayeredAttributes_v2>);
+    runBulkLoad<LayeredAttributes_v7>("LayeredAttributes_v7", savedGame, loadOneByOne<LayeredAttributes_v7>);
+    runBulkLoad<LayeredAttributes_v7>("LayeredAttributes_v7 (AddLayeredEffects)", savedGame,
+        [](LayeredAttributes_v7& attributes, const std::vector<LayeredEffectDefinition>& effects) { attributes.AddLayeredEffects(effects); });
+    runBulkLoad<LayeredAttributes_v9>("LayeredAttributes_v9", savedGame, loadOneByOne<LayeredAttributes_v9>);
+    runBulkLoad<LayeredAttributes_v9>("LayeredAttributes_v9 (AddLayeredEffects)", savedGame,
+        [](LayeredAttributes_v9& attributes, const std::vector<LayeredEffectDefinition>& effects) { attributes.AddLayeredEffects(effects); });
+
+    runMassEffect(100000, MassEffectMode::PerEntity);
+    runMassEffect(100000, MassEffectMode::Batched);
+    runMassEffect(100000, MassEffectMode::Group);
+
+    auto parentEffects = makeSavedGame(500);
+    for (bool addEffect : { false, true }) {
+        runFork<LayeredAttributes_v2>("LayeredAttributes_v2 (copy)", parentEffects, addEffect,
+            [](const LayeredAttributes_v2& parent) { return parent; });
+        runFork<LayeredAttributes_v7>("LayeredAttributes_v7 (Fork)", parentEffects, addEffect,
+            [](const LayeredAttributes_v7& parent) { return parent.Fork(); });
+    }
+
+    runEndOfTurn(100000, false);
+    runEndOfTurn(100000, true);
+
+    runLeavesPlay(2000, 500, false);
+    runLeavesPlay(2000, 500, true);
+
+    runRecomputeDirty(100000, 0);
+    runRecomputeDirty(100000, 1);
+    if (std::thread::hardware_concurrency() > 1) {
+        runRecomputeDirty(100000, std::thread::hardware_concurrency());
+    }
+    return 0;
+}
@@ -0,0 +1,647 @@
+// Micro-benchmark suite across every ILayeredAttributes implementation
+//
+// Each engine, current or archived, runs the same canonical workloads on a single object:
+//   read-heavy and write-heavy call mixes (with the occasional end-of-turn clear),
+//   descending-layer inserts (every effect lands in front of the stack),
+//   same-layer merges (one operation piling up in one layer),
+//   per-turn clear (a turn's worth of changes followed by ClearLayeredEffects),
+//   and stacks of 1 to 100k effects whose base value changes before every read.
+// Every workload is pre-generated, run once to warm up and then repeatedly; the suite reports the
+// mean ns/op with a 95% confidence interval (Student's t over the repetitions) and ops/sec. The
+// checksum of every value read is compared against LayeredAttributes_v2, the reference used by the
+// unit tests, and any disagreement is flagged.
+//
+// With --trace, the suite instead replays a recorded call trace (see AttributeTrace.hpp, e.g. one
+// written by GameplaySimulation01) against every engine and checks every read against the recording.
+//
+// With --memory, the suite instead builds a game's worth of attribute state (one v2 object per
+// card, and one AttributeWorld) on the global heap and on a per-game monotonic arena, and compares
+// the number of allocations and the time it takes to tear the game down again.
+//
+// With --timeline, every engine operation of the run is also written as a Chrome trace (see
+// Timeline.hpp); build with LAYERED_ATTRIBUTES_TIMELINE defined, e.g. make CPPFLAGS=-DLAYERED_ATTRIBUTES_TIMELINE.
+//
+// No dependencies beyond the standard library. On Linux: make -C Benchmark02
+//
+// Usage: Benchmark02 [--repetitions N] [--engine NAME] [--workload NAME] [--quick] [--trace FILE] [--memory] [--timeline FILE]
+// --engine and --workload keep only the entries whose name contains NAME; --quick caps the stack
+// sizes at 10k and shortens every workload.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/AttributeTrace.hpp"
+#include "../src/AttributeWorld.hpp"
+#include "../src/CountingResource.hpp"
+#include "../src/LayeredAttributes_v1.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/LayeredAttributes_v7.hpp"
+#include "../src/LayeredAttributes_v8.hpp"
+#include "../src/LayeredAttributes_v9.hpp"
+#include "../src/Timeline.hpp"
+#include "../src/archive/LA_v3_Extension_Removals.hpp"
+#include "../src/archive/LA_v3_Extension_Removals_v2.hpp"
+#include "../src/archive/LayeredAttributes_v3.hpp"
+#include "../src/archive/LayeredAttributes_v5.hpp"
+#include "../src/archive/LayeredAttributes_v6.hpp"
+
+namespace {
+
+enum class CallType { Read, SetBase, AddEffect, Clear };
+
+struct Call {
+    CallType type;
+    LayeredEffectDefinition effect;
+};
+
+struct Workload {
+    std::string name;
+    std::vector<Call> setup; // applied before the clock starts
+    std::vector<Call> calls;
+    // how many operations the timed calls count as, e.g. one per base change + read
+    size_t operations;
+};
+
+struct Options {
+    size_t repetitions = 10;
+    std::string engineFilter;
+    std::string workloadFilter;
+    bool quick = false;
+    std::string trace;
+    bool memory = false;
+    std::string timeline;
+};
+
+// Every repetition stops early once this much time has been spent on one engine and workload,
+// so that the slowest archived engines cannot stall the suite.
+const double BudgetSeconds = 20.0;
+
+Call read(AttributeKey attribute) {
+    return { CallType::Read, { attribute, EffectOperation_Invalid, 0, 0 } };
+}
+
+Call setBase(AttributeKey attribute, int value) {
+    return { CallType::SetBase, { attribute, EffectOperation_Invalid, value, 0 } };
+}
+
+Call addEffect(AttributeKey attribute, EffectOperation operation, int modification, int layer) {
+    return { CallType::AddEffect, { attribute, operation, modification, layer } };
+}
+
+Call clear() {
+    return { CallType::Clear, { AttributeKey_NotAssessed, EffectOperation_Invalid, 0, 0 } };
+}
+
+Workload makeMix(const std::string& name, size_t callCount, int readPercent, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+    std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(-3, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    Workload workload{ name, {}, {}, callCount };
+    for (size_t i = 0; i < callCount; ++i) {
+        AttributeKey attribute = AttributeKey(key(rng));
+        int roll = percent(rng);
+        if (roll < readPercent) {
+            workload.calls.push_back(read(attribute));
+        }
+        else if (roll == 99) {
+            workload.calls.push_back(clear());
+        }
+        else if (roll % 8 == 0) {
+            workload.calls.push_back(setBase(attribute, modifier(rng)));
+        }
+        else {
+            workload.calls.push_back(addEffect(attribute, EffectOperation(operation(rng)), modifier(rng), layer(rng)));
+        }
+    }
+    return workload;
+}
+
+// Layers count down, so every effect sorts in front of the whole stack; read after each insert.
+Workload makeDescendingInserts(size_t stackSize, size_t stacks) {
+    Workload workload{ "descending-layer inserts (" + std::to_string(stackSize) + " deep)", {}, {}, stackSize * stacks };
+    for (size_t stack = 0; stack < stacks; ++stack) {
+        for (size_t i = 0; i < stackSize; ++i) {
+            int layer = static_cast<int>(stackSize - i);
+            workload.calls.push_back(addEffect(AttributeKey_Power, (i % 3) ? EffectOperation_Add : EffectOperation_Subtract, 1 + static_cast<int>(i % 3), layer));
+            workload.calls.push_back(read(AttributeKey_Power));
+        }
+        workload.calls.push_back(clear());
+    }
+    return workload;
+}
+
+// The same operation in the same layer over and over, which merging engines fold into one effect.
+Workload makeSameLayerMerges(size_t effectCount) {
+    Workload workload{ "same-layer merges", {}, {}, effectCount };
+    for (size_t i = 0; i < effectCount; ++i) {
+        workload.calls.push_back(addEffect(AttributeKey_Power, EffectOperation_Add, 1 + static_cast<int>(i % 3), 4));
+        workload.calls.push_back(read(AttributeKey_Power));
+        if (i % 10000 == 9999) {
+            workload.calls.push_back(clear());
+        }
+    }
+    return workload;
+}
+
+// One turn: a few base changes, a dozen effects across the creature's attributes, a few reads,
+// then the end-of-turn clear. Counted per turn.
+Workload makePerTurnClear(size_t turns) {
+    std::mt19937 rng(29);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Types);
+    std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(-3, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    Workload workload{ "per-turn clear", {}, {}, turns };
+    for (size_t turn = 0; turn < turns; ++turn) {
+        workload.calls.push_back(setBase(AttributeKey_Power, static_cast<int>(turn % 5)));
+        workload.calls.push_back(setBase(AttributeKey_Toughness, static_cast<int>(turn % 7)));
+        for (int effect = 0; effect < 12; ++effect) {
+            workload.calls.push_back(addEffect(AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng)));
+        }
+        for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Types; ++attribute) {
+            workload.calls.push_back(read(AttributeKey(attribute)));
+        }
+        workload.calls.push_back(clear());
+    }
+    return workload;
+}
+
+// A stack of stackSize effects is loaded up front in ascending layers; every timed operation
+// changes the base value and reads, which forces a full recalculation in every engine.
+Workload makeStack(size_t stackSize, size_t operations) {
+    std::mt19937 rng(31);
+    std::uniform_int_distribution<int> operation(EffectOperation_Add, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(1, 3);
+    Workload workload{ "stack of " + std::to_string(stackSize) + " effects, base change + read", {}, {}, operations };
+    for (size_t i = 0; i < stackSize; ++i) {
+        int layer = static_cast<int>(i * 64 / stackSize);
+        EffectOperation op = EffectOperation(operation(rng));
+        if (op == EffectOperation_Multiply || op == EffectOperation_BitwiseAnd) {
+            // keep the values from collapsing to 0, so the checksum still says something
+            op = EffectOperation_Add;
+        }
+        workload.setup.push_back(addEffect(AttributeKey_Power, op, modifier(rng), layer));
+    }
+    for (size_t i = 0; i < operations; ++i) {
+        workload.calls.push_back(setBase(AttributeKey_Power, static_cast<int>(i % 11)));
+        workload.calls.push_back(read(AttributeKey_Power));
+    }
+    return workload;
+}
+
+void apply(ILayeredAttributes& attributes, const Call& call, int64_t& checksum) {
+    switch (call.type) {
+    case CallType::Read:
+        checksum += attributes.GetCurrentAttribute(call.effect.Attribute);
+        break;
+    case CallType::SetBase:
+        attributes.SetBaseAttribute(call.effect.Attribute, call.effect.Modification);
+        break;
+    case CallType::AddEffect:
+        attributes.AddLayeredEffect(call.effect);
+        break;
+    case CallType::Clear:
+        attributes.ClearLayeredEffects();
+        break;
+    }
+}
+
+struct Measurement {
+    std::vector<double> nanosecondsPerOperation;
+    int64_t checksum = 0;
+    bool consistent = true; // same checksum in every repetition
+    size_t mismatches = 0;  // trace replays only: reads that differ from the recording
+};
+
+// The engine is called through its concrete type, so no engine pays for virtual dispatch
+// that another one avoids.
+template <typename Implementation>
+Measurement measure(const Workload& workload, size_t repetitions) {
+    Measurement measurement;
+    auto budgetStart = std::chrono::steady_clock::now();
+    for (size_t repetition = 0; repetition <= repetitions; ++repetition) {
+        Implementation attributes;
+        int64_t ignored = 0;
+        for (const auto& call : workload.setup) {
+            apply(attributes, call, ignored);
+        }
+        int64_t checksum = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& call : workload.calls) {
+            switch (call.type) {
+            case CallType::Read:
+                checksum += attributes.Implementation::GetCurrentAttribute(call.effect.Attribute);
+                break;
+            case CallType::SetBase:
+                attributes.Implementation::SetBaseAttribute(call.effect.Attribute, call.effect.Modification);
+                break;
+            case CallType::AddEffect:
+                attributes.Implementation::AddLayeredEffect(call.effect);
+                break;
+            case CallType::Clear:
+                attributes.Implementation::ClearLayeredEffects();
+                break;
+            }
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        if (repetition == 0) {
+            // warm-up: caches, branch predictors and the allocator
+            measurement.checksum = checksum;
+        }
+        else {
+            double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+            measurement.nanosecondsPerOperation.push_back(nanoseconds / static_cast<double>(workload.operations));
+            measurement.consistent = measurement.consistent && checksum == measurement.checksum;
+        }
+        if (std::chrono::duration<double>(stop - budgetStart).count() > BudgetSeconds && measurement.nanosecondsPerOperation.size() >= 2) {
+            break;
+        }
+    }
+    return measurement;
+}
+
+template <typename Implementation>
+Measurement replay(const AttributeTrace& trace, size_t repetitions) {
+    Measurement measurement;
+    auto budgetStart = std::chrono::steady_clock::now();
+    for (size_t repetition = 0; repetition <= repetitions; ++repetition) {
+        AttributeTrace::ReplayResult result = trace.Replay<Implementation>();
+        if (repetition == 0) {
+            measurement.checksum = result.checksum;
+            measurement.mismatches = result.mismatches;
+        }
+        else {
+            measurement.nanosecondsPerOperation.push_back(result.seconds * 1e9 / static_cast<double>(std::max<size_t>(1, result.calls)));
+            measurement.consistent = measurement.consistent && result.checksum == measurement.checksum;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - budgetStart).count();
+        if (elapsed > BudgetSeconds && measurement.nanosecondsPerOperation.size() >= 2) {
+            break;
+        }
+    }
+    return measurement;
+}
+
+// two-sided 95% quantile of Student's t distribution
+double studentT95(size_t degreesOfFreedom) {
+    static const double table[] = { 0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    return degreesOfFreedom < std::size(table) ? table[degreesOfFreedom] : 1.960;
+}
+
+struct Interval {
+    double mean = 0.0;
+    double halfWidth = 0.0; // of the 95% confidence interval
+};
+
+Interval confidenceInterval(const std::vector<double>& samples) {
+    Interval interval;
+    for (double sample : samples) {
+        interval.mean += sample;
+    }
+    interval.mean /= static_cast<double>(std::max<size_t>(1, samples.size()));
+    double variance = 0.0;
+    for (double sample : samples) {
+        variance += (sample - interval.mean) * (sample - interval.mean);
+    }
+    variance /= static_cast<double>(samples.size() > 1 ? samples.size() - 1 : 1);
+    interval.halfWidth = samples.size() > 1 ? studentT95(samples.size() - 1) * std::sqrt(variance / static_cast<double>(samples.size())) : 0.0;
+    return interval;
+}
+
+struct Engine {
+    std::string name;
+    Measurement (*measure)(const Workload&, size_t);
+    Measurement (*replay)(const AttributeTrace&, size_t);
+    bool archived;
+};
+
+void report(const Workload& workload, const Engine& engine, const Measurement& measurement, const int64_t* referenceChecksum) {
+    const auto& samples = measurement.nanosecondsPerOperation;
+    Interval interval = confidenceInterval(samples);
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1);
+    line << workload.name << "\t" << engine.name << (engine.archived ? " (archived)" : "") << "\t"
+        << interval.mean << " +/- " << interval.halfWidth << " ns/op\t"
+        << std::setprecision(0) << 1e9 / interval.mean << " ops/sec\t"
+        << "n=" << samples.size() << "\t"
+        << "checksum " << measurement.checksum;
+    if (!measurement.consistent) {
+        line << "\tVARIES BETWEEN RUNS";
+    }
+    if (referenceChecksum != nullptr && *referenceChecksum != measurement.checksum) {
+        line << "\tDIFFERS FROM v2";
+    }
+    if (measurement.mismatches != 0) {
+        line << "\t" << measurement.mismatches << " READS DIFFER FROM THE TRACE";
+    }
+    std::cout << line.str() << std::endl;
+}
+
+bool contains(const std::string& name, const std::string& filter) {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+// One game: every card gets a couple of base values and its effects, read as they land. Building
+// and tearing it down is what a game server does for every game it hosts.
+struct Game {
+    size_t cardCount;
+    std::vector<Call> cardCalls; // the same calls for every card, offset by the card index
+};
+
+Game makeGame(size_t cardCount, size_t effectsPerCard) {
+    std::mt19937 rng(37);
+    std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+    std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+    std::uniform_int_distribution<int> modifier(-3, 3);
+    std::uniform_int_distribution<int> layer(1, 7);
+    Game game{ cardCount, {} };
+    game.cardCalls.push_back(setBase(AttributeKey_Power, 2));
+    game.cardCalls.push_back(setBase(AttributeKey_Toughness, 3));
+    for (size_t i = 0; i < effectsPerCard; ++i) {
+        AttributeKey attribute = AttributeKey(key(rng));
+        game.cardCalls.push_back(addEffect(attribute, EffectOperation(operation(rng)), modifier(rng), layer(rng)));
+        game.cardCalls.push_back(read(attribute));
+    }
+    return game;
+}
+
+struct GameMeasurement {
+    std::vector<double> buildMilliseconds;
+    std::vector<double> teardownMilliseconds;
+    uint64_t allocations = 0;     // upstream allocations to build one game
+    size_t peakBytes = 0;
+    int64_t checksum = 0;
+};
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One LayeredAttributes_v2 per card, the objects themselves allocated from the resource as well.
+int64_t buildObjects(const Game& game, std::pmr::memory_resource* resource, std::pmr::vector<LayeredAttributes_v2>& cards) {
+    int64_t checksum = 0;
+    // reserved up front: the objects are not moved afterwards, a copy would leave the resource
+    cards.reserve(game.cardCount);
+    for (size_t card = 0; card < game.cardCount; ++card) {
+        cards.emplace_back(false, 10, resource);
+        for (const auto& call : game.cardCalls) {
+            Call offset = call;
+            offset.effect.Modification += static_cast<int>(card % 5);
+            apply(cards.back(), offset, checksum);
+        }
+    }
+    return checksum;
+}
+
+int64_t buildWorld(const Game& game, AttributeWorld& world) {
+    int64_t checksum = 0;
+    for (size_t card = 0; card < game.cardCount; ++card) {
+        AttributeWorld::Entity entity = world.CreateEntity();
+        for (const auto& call : game.cardCalls) {
+            int modification = call.effect.Modification + static_cast<int>(card % 5);
+            if (call.type == CallType::SetBase) {
+                world.SetBaseAttribute(entity, call.effect.Attribute, modification);
+            }
+            else if (call.type == CallType::AddEffect) {
+                world.AddLayeredEffect(entity, { call.effect.Attribute, call.effect.Operation, modification, call.effect.Layer });
+            }
+            else if (call.type == CallType::Read) {
+                checksum += world.GetCurrentAttribute(entity, call.effect.Attribute);
+            }
+        }
+    }
+    return checksum;
+}
+
+// Builds and tears down the game repetitions + 1 times (the first one warms up). On the arena,
+// teardown is running the destructors, which deallocate nothing, plus one release().
+GameMeasurement measureGame(const Game& game, bool world, bool arena, size_t repetitions) {
+    GameMeasurement measurement;
+    for (size_t repetition = 0; repetition <= repetitions; ++repetition) {
+        CountingResource counting;
+        std::pmr::monotonic_buffer_resource arenaResource(&counting);
+        std::pmr::memory_resource* resource = arena ? static_cast<std::pmr::memory_resource*>(&arenaResource) : &counting;
+
+        auto buildStart = std::chrono::steady_clock::now();
+        std::unique_ptr<AttributeWorld> attributeWorld;
+        std::pmr::vector<LayeredAttributes_v2> cards(resource);
+        int64_t checksum = 0;
+        if (world) {
+            attributeWorld = std::make_unique<AttributeWorld>(false, false, resource);
+            checksum = buildWorld(game, *attributeWorld);
+        }
+        else {
+            checksum = buildObjects(game, resource, cards);
+        }
+        double buildMilliseconds = millisecondsSince(buildStart);
+
+        auto teardownStart = std::chrono::steady_clock::now();
+        attributeWorld.reset();
+        cards.clear();
+        cards.shrink_to_fit();
+        arenaResource.release();
+        double teardownMilliseconds = millisecondsSince(teardownStart);
+
+        measurement.allocations = counting.Allocations();
+        measurement.peakBytes = counting.PeakBytes();
+        measurement.checksum = checksum;
+        if (repetition != 0) {
+            measurement.buildMilliseconds.push_back(buildMilliseconds);
+            measurement.teardownMilliseconds.push_back(teardownMilliseconds);
+        }
+    }
+    return measurement;
+}
+
+void compareMemory(const Options& options) {
+    Game game = makeGame(options.quick ? 1000 : 10000, 40);
+    std::cout << "game of " << game.cardCount << " cards, " << (game.cardCalls.size() - 2) / 2 << " effects per card\n";
+    std::cout << "engine\tresource\tallocations\tpeak\tbuild\tteardown\trepetitions\tchecksum\n";
+    for (bool world : { false, true }) {
+        std::string name = world ? "AttributeWorld" : "LayeredAttributes_v2";
+        if (!contains(name, options.engineFilter)) {
+            continue;
+        }
+        int64_t heapChecksum = 0;
+        for (bool arena : { false, true }) {
+            GameMeasurement measurement = measureGame(game, world, arena, options.repetitions);
+            Interval build = confidenceInterval(measurement.buildMilliseconds);
+            Interval teardown = confidenceInterval(measurement.teardownMilliseconds);
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(2);
+            line << name << "\t" << (arena ? "monotonic arena" : "global heap") << "\t"
+                << measurement.allocations << "\t"
+                << measurement.peakBytes / 1024 << " KB\t"
+                << build.mean << " +/- " << build.halfWidth << " ms\t"
+                << teardown.mean << " +/- " << teardown.halfWidth << " ms\t"
+                << "n=" << measurement.teardownMilliseconds.size() << "\t"
+                << "checksum " << measurement.checksum;
+            if (!arena) {
+                heapChecksum = measurement.checksum;
+            }
+            else if (measurement.checksum != heapChecksum) {
+                line << "\tDIFFERS FROM THE HEAP";
+            }
+            std::cout << line.str() << std::endl;
+        }
+    }
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue) {
+            options.repetitions = std::max<size_t>(1, std::stoul(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--engine") == 0 && hasValue) {
+            options.engineFilter = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--workload") == 0 && hasValue) {
+            options.workloadFilter = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && hasValue) {
+            options.trace = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--memory") == 0) {
+            options.memory = true;
+        }
+        else if (std::strcmp(argv[i], "--timeline") == 0 && hasValue) {
+            options.timeline = argv[++i];
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--repetitions N] [--engine NAME] [--workload NAME] [--quick] [--trace FILE] [--memory] [--timeline FILE]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void writeTimeline(const Options& options) {
+    if (options.timeline.empty()) {
+        return;
+    }
+    Timeline::Stop();
+    if (!Timeline::WriteChromeTrace(options.timeline)) {
+        std::cerr << "cannot write " << options.timeline << "\n";
+        return;
+    }
+    std::cout << options.timeline << ": " << Timeline::SpanCount() << " spans";
+    if (Timeline::DroppedCount() != 0) {
+        std::cout << ", " << Timeline::DroppedCount() << " dropped (buffers full)";
+    }
+    std::cout << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    const size_t scale = options.quick ? 10 : 1;
+    if (!options.timeline.empty()) {
+        if (!Timeline::Enabled) {
+            std::cerr << "--timeline: built without LAYERED_ATTRIBUTES_TIMELINE, the trace will be empty\n";
+        }
+        Timeline::Start();
+    }
+
+    // v2 comes first: it is the reference every other checksum is compared against
+    const Engine engines[] = {
+        { "LayeredAttributes_v2", measure<LayeredAttributes_v2>, replay<LayeredAttributes_v2>, false },
+        { "LayeredAttributes_v1", measure<LayeredAttributes_v1>, replay<LayeredAttributes_v1>, false },
+        { "LayeredAttributes_v7", measure<LayeredAttributes_v7>, replay<LayeredAttributes_v7>, false },
+        { "LayeredAttributes_v8", measure<LayeredAttributes_v8>, replay<LayeredAttributes_v8>, false },
+        { "LayeredAttributes_v9", measure<LayeredAttributes_v9>, replay<LayeredAttributes_v9>, false },
+        { "LayeredAttributes_v3", measure<LayeredAttributes_v3>, replay<LayeredAttributes_v3>, true },
+        { "LayeredAttributes_v5", measure<LayeredAttributes_v5>, replay<LayeredAttributes_v5>, true },
+        { "LayeredAttributes_v6", measure<LayeredAttributes_v6>, replay<LayeredAttributes_v6>, true },
+        { "LA_v3_Extension_Removals", measure<LA_v3_Extension_Removals>, replay<LA_v3_Extension_Removals>, true },
+        { "LA_v3_Extension_Removals_v2", measure<LA_v3_Extension_Removals_v2>, replay<LA_v3_Extension_Removals_v2>, true },
+    };
+
+    if (options.memory) {
+        compareMemory(options);
+        writeTimeline(options);
+        return 0;
+    }
+
+    if (!options.trace.empty()) {
+        AttributeTrace trace = AttributeTrace::Load(options.trace);
+        Workload workload{ "trace " + options.trace, {}, {}, trace.Calls().size() };
+        std::cout << options.trace << ": " << trace.Calls().size() << " calls on " << trace.ObjectCount() << " objects\n";
+        std::cout << "workload\tengine\tmean +/- 95% CI\tthroughput\trepetitions\tchecksum\n";
+        for (const auto& engine : engines) {
+            if (contains(engine.name, options.engineFilter)) {
+                report(workload, engine, engine.replay(trace, options.repetitions), nullptr);
+            }
+        }
+        writeTimeline(options);
+        return 0;
+    }
+
+    std::vector<Workload> workloads;
+    workloads.push_back(makeMix("read-heavy (90% reads)", 1000000 / scale, 90, 2025));
+    workloads.push_back(makeMix("write-heavy (10% reads)", 1000000 / scale, 10, 2026));
+    workloads.push_back(makeDescendingInserts(1000, 100 / scale));
+    workloads.push_back(makeSameLayerMerges(1000000 / scale));
+    workloads.push_back(makePerTurnClear(100000 / scale));
+    for (size_t stackSize : { 1, 10, 100, 1000, 10000, 100000 }) {
+        if (options.quick && stackSize > 10000) {
+            continue;
+        }
+        // roughly the same amount of work at every size
+        size_t operations = std::clamp<size_t>(20000000 / scale / stackSize, 20, 1000000 / scale);
+        workloads.push_back(makeStack(stackSize, operations));
+    }
+
+    std::cout << "workload\tengine\tmean +/- 95% CI\tthroughput\trepetitions\tchecksum\n";
+    for (const auto& workload : workloads) {
+        if (!contains(workload.name, options.workloadFilter)) {
+            continue;
+        }
+        bool haveReference = false;
+        int64_t referenceChecksum = 0;
+        for (const auto& engine : engines) {
+            if (!contains(engine.name, options.engineFilter) && !(engine.name == "LayeredAttributes_v2")) {
+                continue;
+            }
+            Measurement measurement = engine.measure(workload, options.repetitions);
+            if (!haveReference) {
+                haveReference = true;
+                referenceChecksum = measurement.checksum;
+                if (!contains(engine.name, options.engineFilter)) {
+                    // measured only for its checksum
+                    continue;
+                }
+                report(workload, engine, measurement, nullptr);
+                continue;
+            }
+            report(workload, engine, measurement, &referenceChecksum);
+        }
+    }
+    writeTimeline(options);
+    return 0;
+}
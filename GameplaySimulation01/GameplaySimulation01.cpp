@@ -3,25 +3,37 @@
 //
 // This simulation highlights how the LayeredAttributes_v2 class correctly applies and resolves game mechanics.
 // It tracks power and toughness modifications using a sequence of turns where effects from different layers are added and then processed.
+//
+// Usage: GameplaySimulation01 [trace file]
+// With a trace file, every call made on the creature is recorded to it (see AttributeTrace.hpp) for replay in Benchmark02.
 
 #include <iostream>
+#include <memory>
+#include "../src/AttributeTrace.hpp"
 #include "../src/LayeredAttributes_v2.hpp"
 
 // Simulated MTG game state
 struct Card {
     std::string name;
-    LayeredAttributes_v2 attributes;
-    Card(const std::string& cardName, int basePower, int baseToughness)
-        : name(cardName), attributes(false, 10) // Disable error logging, reserve space for 10 effects
+    LayeredAttributes_v2 engine;
+    RecordingLayeredAttributes attributes; // forwards to engine, recording when given a trace writer
+    Card(const std::string& cardName, int basePower, int baseToughness, AttributeTrace::Writer* trace)
+        : name(cardName), engine(false, 10), // Disable error logging, reserve space for 10 effects
+          attributes(engine, trace)
     {
         attributes.SetBaseAttribute(AttributeKey_Power, basePower);
         attributes.SetBaseAttribute(AttributeKey_Toughness, baseToughness);
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
+    std::unique_ptr<AttributeTrace::Writer> trace;
+    if (argc > 1) {
+        trace = std::make_unique<AttributeTrace::Writer>(argv[1]);
+    }
+
     // Initialize a creature with base stats
-    Card test_creature("Test Creature", 2, 2); // 2/2 creature
+    Card test_creature("Test Creature", 2, 2, trace.get()); // 2/2 creature
 
     std::cout << "--- Turn 1: Base stats ---\n";
     std::cout << test_creature.name << " starts as " << test_creature.attributes.GetCurrentAttribute(AttributeKey_Power) << "/"
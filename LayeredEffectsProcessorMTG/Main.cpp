@@ -1,10 +1,42 @@
+#include "../tests/AttributeTraceUnitTests.hpp"
+#include "../tests/AttributeWorldUnitTests.hpp"
+#include "../tests/DerivedAttributesUnitTests.hpp"
+#include "../tests/LayeredAttributesUnitTests_v1.hpp"
 #include "../tests/LayeredAttributesUnitTests_v2.hpp"
+#include "../tests/LayeredAttributesUnitTests_v7.hpp"
+#include "../tests/LayeredAttributesUnitTests_v8.hpp"
+#include "../tests/LayeredAttributesUnitTests_v9.hpp"
+#include "../tests/TimelineUnitTests.hpp"
 
 int main()
 {
+	LayeredAttributesUnitTests_v1 tests_v1;
+	tests_v1.runOperationalTests();
+	tests_v1.runCrashTests();
 	LayeredAttributesUnitTests_v2 tests;
 	tests.runOperationalTests();
 	tests.runCrashTests(); 
+	LayeredAttributesUnitTests_v7 tests_v7;
+	tests_v7.runOperationalTests();
+	tests_v7.runCrashTests();
+	LayeredAttributesUnitTests_v8 tests_v8;
+	tests_v8.runOperationalTests();
+	tests_v8.runCrashTests();
+	LayeredAttributesUnitTests_v9 tests_v9;
+	tests_v9.runOperationalTests();
+	tests_v9.runCrashTests();
+	AttributeWorldUnitTests tests_world;
+	tests_world.runOperationalTests();
+	tests_world.runCrashTests();
+	AttributeTraceUnitTests tests_trace;
+	tests_trace.runOperationalTests();
+	tests_trace.runCrashTests();
+	DerivedAttributesUnitTests tests_derived;
+	tests_derived.runOperationalTests();
+	tests_derived.runCrashTests();
+	TimelineUnitTests tests_timeline;
+	tests_timeline.runOperationalTests();
+	tests_timeline.runCrashTests();
 	return 0;
 }
 
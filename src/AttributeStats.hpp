@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Hot-path statistics for the engines that support GetStats() (v2 and v7).
+// The counters are only compiled in when LAYERED_ATTRIBUTES_STATS is defined;
+// otherwise every ATTRIBUTE_STATS(...) statement and the counters themselves
+// compile to nothing and GetStats() returns all zeros.
+#if defined(LAYERED_ATTRIBUTES_STATS)
+#define ATTRIBUTE_STATS(statement) statement
+#else
+#define ATTRIBUTE_STATS(statement) ((void)0)
+#endif
+
+struct AttributeStats
+{
+#if defined(LAYERED_ATTRIBUTES_STATS)
+	static constexpr bool Enabled = true;
+#else
+	static constexpr bool Enabled = false;
+#endif
+
+	// Bucket 0 counts zeros and bucket b counts values in [2^(b-1), 2^b);
+	// the last bucket also takes everything larger.
+	static const size_t HistogramBuckets = 24;
+	using Histogram = std::array<uint64_t, HistogramBuckets>;
+
+	static size_t Bucket(uint64_t value)
+	{
+		size_t bucket = 0;
+		while (value != 0 && bucket + 1 < HistogramBuckets)
+		{
+			value >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	uint64_t reads = 0;
+	uint64_t cacheHits = 0;     // reads answered without recalculating
+	uint64_t recomputes = 0;    // calls to calculateAttribute
+	uint64_t programRuns = 0;   // recomputes answered by a compiled program (v7)
+	uint64_t adds = 0;
+	uint64_t merges = 0;        // folded into the last effect of the same layer and operation
+	uint64_t appends = 0;       // stored at the end of the stack
+	uint64_t inserts = 0;       // updateIncrementally bailed out, sorted into the stack
+	uint64_t batchedAdds = 0;   // merged by a bulk add or write-combining flush (v7)
+	Histogram recomputeLength{}; // effects replayed by one recompute
+	Histogram stackDepth{};      // stack depth of the attribute after an add
+};
+
+// The live counters behind GetStats(). Increments are relaxed atomics, so
+// v7's concurrent readers can count without a lock; a snapshot taken while
+// other threads count is not a consistent cut. Copies of an engine copy its
+// counters.
+class AttributeStatsCounters
+{
+public:
+	enum Counter
+	{
+		Counter_Reads,
+		Counter_CacheHits,
+		Counter_Recomputes,
+		Counter_ProgramRuns,
+		Counter_Adds,
+		Counter_Merges,
+		Counter_Appends,
+		Counter_Inserts,
+		Counter_BatchedAdds,
+		CounterCount
+	};
+
+	AttributeStatsCounters() = default;
+	AttributeStatsCounters(const AttributeStatsCounters& other) { *this = other; }
+	AttributeStatsCounters& operator=(const AttributeStatsCounters& other)
+	{
+		copy(counters, other.counters);
+		copy(recomputeLength, other.recomputeLength);
+		copy(stackDepth, other.stackDepth);
+		return *this;
+	}
+
+	void count(Counter counter, uint64_t amount = 1) { counters[counter].fetch_add(amount, std::memory_order_relaxed); }
+	void recomputed(size_t length)
+	{
+		count(Counter_Recomputes);
+		recomputeLength[AttributeStats::Bucket(length)].fetch_add(1, std::memory_order_relaxed);
+	}
+	void added(size_t depth) { stackDepth[AttributeStats::Bucket(depth)].fetch_add(1, std::memory_order_relaxed); }
+
+	AttributeStats snapshot() const
+	{
+		AttributeStats stats;
+		stats.reads = load(Counter_Reads);
+		stats.cacheHits = load(Counter_CacheHits);
+		stats.recomputes = load(Counter_Recomputes);
+		stats.programRuns = load(Counter_ProgramRuns);
+		stats.adds = load(Counter_Adds);
+		stats.merges = load(Counter_Merges);
+		stats.appends = load(Counter_Appends);
+		stats.inserts = load(Counter_Inserts);
+		stats.batchedAdds = load(Counter_BatchedAdds);
+		for (size_t b = 0; b < AttributeStats::HistogramBuckets; ++b)
+		{
+			stats.recomputeLength[b] = recomputeLength[b].load(std::memory_order_relaxed);
+			stats.stackDepth[b] = stackDepth[b].load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	void reset() { *this = AttributeStatsCounters(); }
+
+private:
+	std::array<std::atomic<uint64_t>, CounterCount> counters{};
+	std::array<std::atomic<uint64_t>, AttributeStats::HistogramBuckets> recomputeLength{};
+	std::array<std::atomic<uint64_t>, AttributeStats::HistogramBuckets> stackDepth{};
+
+	uint64_t load(Counter counter) const { return counters[counter].load(std::memory_order_relaxed); }
+
+	template <size_t N>
+	static void copy(std::array<std::atomic<uint64_t>, N>& to, const std::array<std::atomic<uint64_t>, N>& from)
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			to[i].store(from[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+	}
+};
@@ -0,0 +1,349 @@
+#include "AttributeTrace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char Magic[4] = { 'L', 'A', 'T', 'R' };
+	const uint32_t Version = 1;
+	const uint8_t AttributeEscape = 15;
+	const size_t FlushSize = 1 << 16;
+
+	// Read-only view of a whole file, unmapped on destruction.
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& path)
+		{
+#if defined(_WIN32)
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				throw std::runtime_error("Cannot open trace " + path);
+			}
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file, &fileSize);
+			size = static_cast<size_t>(fileSize.QuadPart);
+			if (size > 0)
+			{
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				data = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+				if (data == nullptr)
+				{
+					release();
+					throw std::runtime_error("Cannot map trace " + path);
+				}
+			}
+#else
+			descriptor = open(path.c_str(), O_RDONLY);
+			struct stat status;
+			if (descriptor < 0 || fstat(descriptor, &status) != 0)
+			{
+				release();
+				throw std::runtime_error("Cannot open trace " + path);
+			}
+			size = static_cast<size_t>(status.st_size);
+			if (size > 0)
+			{
+				void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+				if (view == MAP_FAILED)
+				{
+					release();
+					throw std::runtime_error("Cannot map trace " + path);
+				}
+				data = static_cast<const uint8_t*>(view);
+				// decoded front to back exactly once
+				madvise(view, size, MADV_SEQUENTIAL);
+			}
+#endif
+		}
+
+		~MappedFile() { release(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* begin() const { return data; }
+		const uint8_t* end() const { return data + size; }
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+
+		void release()
+		{
+			if (data != nullptr)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mapping != nullptr)
+			{
+				CloseHandle(mapping);
+			}
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+			}
+			data = nullptr;
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+		}
+#else
+		int descriptor = -1;
+
+		void release()
+		{
+			if (data != nullptr)
+			{
+				munmap(const_cast<uint8_t*>(data), size);
+			}
+			if (descriptor >= 0)
+			{
+				close(descriptor);
+			}
+			data = nullptr;
+			descriptor = -1;
+		}
+#endif
+	};
+
+	// Bounds-checked reader over the mapped bytes.
+	class Decoder
+	{
+	public:
+		Decoder(const uint8_t* position, const uint8_t* end) : position(position), end(end) {}
+
+		bool done() const { return position == end; }
+
+		uint8_t byte()
+		{
+			if (position == end)
+			{
+				throw std::runtime_error("Truncated trace");
+			}
+			return *position++;
+		}
+
+		uint64_t varint()
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				uint8_t next = byte();
+				value |= static_cast<uint64_t>(next & 0x7f) << shift;
+				if ((next & 0x80) == 0)
+				{
+					return value;
+				}
+			}
+			throw std::runtime_error("Corrupt trace");
+		}
+
+		int signedVarint()
+		{
+			uint32_t zigzag = static_cast<uint32_t>(varint());
+			return static_cast<int>((zigzag >> 1) ^ (0u - (zigzag & 1)));
+		}
+
+	private:
+		const uint8_t* position;
+		const uint8_t* end;
+	};
+}
+
+AttributeTrace::Writer::Writer(const std::string& path)
+{
+	file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+	{
+		throw std::runtime_error("Cannot create trace " + path);
+	}
+	buffer.reserve(FlushSize + 32);
+	buffer.insert(buffer.end(), Magic, Magic + sizeof(Magic));
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		buffer.push_back(static_cast<uint8_t>(Version >> shift));
+	}
+}
+
+AttributeTrace::Writer::~Writer()
+{
+	Flush();
+	std::fclose(file);
+}
+
+void AttributeTrace::Writer::Record(uint32_t object, CallType type, const LayeredEffectDefinition& effect)
+{
+	bool escaped = effect.Attribute < 0 || effect.Attribute >= AttributeEscape;
+	uint8_t attribute = escaped ? AttributeEscape : static_cast<uint8_t>(effect.Attribute);
+	buffer.push_back(static_cast<uint8_t>(type | (attribute << 2)));
+	if (escaped)
+	{
+		putSigned(effect.Attribute);
+	}
+	putVarint(object);
+	switch (type)
+	{
+	case CallType_AddEffect:
+		putSigned(effect.Operation);
+		putSigned(effect.Modification);
+		putSigned(effect.Layer);
+		break;
+	case CallType_SetBase:
+	case CallType_Read:
+		putSigned(effect.Modification);
+		break;
+	case CallType_Clear:
+		break;
+	}
+	if (buffer.size() >= FlushSize)
+	{
+		Flush();
+	}
+}
+
+void AttributeTrace::Writer::Flush()
+{
+	if (!buffer.empty())
+	{
+		std::fwrite(buffer.data(), 1, buffer.size(), file);
+		buffer.clear();
+	}
+	std::fflush(file);
+}
+
+void AttributeTrace::Writer::putVarint(uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void AttributeTrace::Writer::putSigned(int value)
+{
+	// zigzag, so small negative numbers stay short too
+	uint32_t bits = static_cast<uint32_t>(value);
+	putVarint((bits << 1) ^ (0u - (bits >> 31)));
+}
+
+AttributeTrace AttributeTrace::Load(const std::string& path)
+{
+	MappedFile mapped(path);
+	if (mapped.end() - mapped.begin() < 8 || std::memcmp(mapped.begin(), Magic, sizeof(Magic)) != 0)
+	{
+		throw std::runtime_error("Not a trace: " + path);
+	}
+	Decoder decoder(mapped.begin() + 4, mapped.end());
+	uint32_t version = 0;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		version |= static_cast<uint32_t>(decoder.byte()) << shift;
+	}
+	if (version != Version)
+	{
+		throw std::runtime_error("Unsupported trace version in " + path);
+	}
+
+	AttributeTrace trace;
+	// a typical record is 3 to 5 bytes
+	trace.calls.reserve(static_cast<size_t>(mapped.end() - mapped.begin()) / 3);
+	while (!decoder.done())
+	{
+		uint8_t header = decoder.byte();
+		if (header >> 6)
+		{
+			throw std::runtime_error("Corrupt trace");
+		}
+		Call call{};
+		call.type = static_cast<CallType>(header & 3);
+		uint8_t attribute = header >> 2;
+		call.effect.Attribute = static_cast<AttributeKey>(attribute == AttributeEscape ? decoder.signedVarint() : attribute);
+		uint64_t object = decoder.varint();
+		if (object >= MaxObjects || object > trace.objectCount + MaxObjectGap)
+		{
+			throw std::runtime_error("Corrupt trace");
+		}
+		call.object = static_cast<uint32_t>(object);
+		switch (call.type)
+		{
+		case CallType_AddEffect:
+			call.effect.Operation = static_cast<EffectOperation>(decoder.signedVarint());
+			call.effect.Modification = decoder.signedVarint();
+			call.effect.Layer = decoder.signedVarint();
+			break;
+		case CallType_SetBase:
+		case CallType_Read:
+			call.effect.Modification = decoder.signedVarint();
+			break;
+		case CallType_Clear:
+			break;
+		}
+		trace.objectCount = std::max<size_t>(trace.objectCount, static_cast<size_t>(call.object) + 1);
+		trace.calls.push_back(call);
+	}
+	trace.calls.shrink_to_fit();
+	return trace;
+}
+
+RecordingLayeredAttributes::RecordingLayeredAttributes(ILayeredAttributes& attributes, AttributeTrace::Writer* writer)
+	: attributes(attributes), writer(writer)
+{
+	if (writer != nullptr)
+	{
+		object = writer->NextObject();
+	}
+}
+
+void RecordingLayeredAttributes::SetBaseAttribute(AttributeKey attribute, int value)
+{
+	attributes.SetBaseAttribute(attribute, value);
+	if (writer != nullptr)
+	{
+		writer->Record(object, AttributeTrace::CallType_SetBase, { attribute, EffectOperation_Invalid, value, 0 });
+	}
+}
+
+int RecordingLayeredAttributes::GetCurrentAttribute(AttributeKey attribute) const
+{
+	int value = attributes.GetCurrentAttribute(attribute);
+	if (writer != nullptr)
+	{
+		writer->Record(object, AttributeTrace::CallType_Read, { attribute, EffectOperation_Invalid, value, 0 });
+	}
+	return value;
+}
+
+void RecordingLayeredAttributes::AddLayeredEffect(LayeredEffectDefinition effect)
+{
+	attributes.AddLayeredEffect(effect);
+	if (writer != nullptr)
+	{
+		writer->Record(object, AttributeTrace::CallType_AddEffect, effect);
+	}
+}
+
+void RecordingLayeredAttributes::ClearLayeredEffects()
+{
+	attributes.ClearLayeredEffects();
+	if (writer != nullptr)
+	{
+		writer->Record(object, AttributeTrace::CallType_Clear, { AttributeKey_NotAssessed, EffectOperation_Invalid, 0, 0 });
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Recorded ILayeredAttributes call traces.
+// A trace covers any number of objects (one per card) and stores every
+// SetBaseAttribute, AddLayeredEffect, GetCurrentAttribute and
+// ClearLayeredEffects call in the order it was made, together with the value
+// each read returned. Replaying a trace drives a fresh object of any engine
+// per recorded object through the same calls and checks every read against
+// the recording, so captured games double as regression benchmarks.
+//
+// File format: the magic "LATR", a little-endian uint32 version, then one
+// record per call:
+//   header byte  call type in bits 0-1, attribute in bits 2-5 (15 escapes to
+//                a zigzag varint that follows)
+//   varint       object id
+//   SetBase      zigzag varint value
+//   AddEffect    zigzag varints operation, modification, layer
+//   Read         zigzag varint value returned
+//   Clear        nothing
+// A typical record is 3 to 5 bytes. Object ids are below MaxObjects, and
+// none is more than MaxObjectGap past the highest id recorded before it.
+class AttributeTrace
+{
+public:
+	// Load rejects ids outside these bounds as corrupt, so a damaged id
+	// cannot make Replay allocate billions of objects.
+	static constexpr uint32_t MaxObjects = 1u << 20;
+	static constexpr uint32_t MaxObjectGap = 1u << 16;
+
+	enum CallType : uint8_t
+	{
+		CallType_SetBase,
+		CallType_AddEffect,
+		CallType_Read,
+		CallType_Clear
+	};
+
+	struct Call
+	{
+		uint32_t object;
+		CallType type;
+		// Attribute is used by every call but Clear; Operation, Modification
+		// and Layer only by AddEffect. SetBase keeps its value and Read the
+		// value it returned in Modification.
+		LayeredEffectDefinition effect;
+	};
+
+	// Buffers records in memory and writes them out in large blocks.
+	// Throws std::runtime_error when the file cannot be created.
+	class Writer
+	{
+	public:
+		explicit Writer(const std::string& path);
+		~Writer();
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		// id for the next recorded object
+		uint32_t NextObject() { return objectCount++; }
+		void Record(uint32_t object, CallType type, const LayeredEffectDefinition& effect);
+		void Flush();
+
+	private:
+		std::FILE* file = nullptr;
+		std::vector<uint8_t> buffer;
+		uint32_t objectCount = 0;
+		void putVarint(uint64_t value);
+		void putSigned(int value);
+	};
+
+	struct ReplayResult
+	{
+		size_t calls = 0;
+		double seconds = 0.0;
+		// reads that returned something other than the recorded value
+		size_t mismatches = 0;
+		size_t firstMismatch = 0; // index of the first mismatching call
+		int64_t checksum = 0;     // sum of every value read
+	};
+
+	// Memory-maps the trace at path and decodes it.
+	// Throws std::runtime_error when the file cannot be read or is not a trace.
+	static AttributeTrace Load(const std::string& path);
+
+	const std::vector<Call>& Calls() const { return calls; }
+	size_t ObjectCount() const { return objectCount; }
+
+	// Runs the whole trace against fresh Implementation objects at full speed.
+	// Calls bypass virtual dispatch, so the timing is the engine's own.
+	template <typename Implementation>
+	ReplayResult Replay() const;
+
+private:
+	std::vector<Call> calls;
+	size_t objectCount = 0;
+};
+
+// Decorator that forwards every call to another ILayeredAttributes and
+// records it. Without a writer it only forwards. Calls that throw are not
+// recorded.
+class RecordingLayeredAttributes : public ILayeredAttributes
+{
+public:
+	RecordingLayeredAttributes(ILayeredAttributes& attributes, AttributeTrace::Writer* writer);
+
+	void SetBaseAttribute(AttributeKey attribute, int value) override;
+	int GetCurrentAttribute(AttributeKey attribute) const override;
+	void AddLayeredEffect(LayeredEffectDefinition effect) override;
+	void ClearLayeredEffects() override;
+
+private:
+	ILayeredAttributes& attributes;
+	AttributeTrace::Writer* writer;
+	uint32_t object = 0;
+};
+
+template <typename Implementation>
+AttributeTrace::ReplayResult AttributeTrace::Replay() const
+{
+	ReplayResult result;
+	std::unique_ptr<Implementation[]> objects(new Implementation[objectCount]);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < calls.size(); ++i)
+	{
+		const Call& call = calls[i];
+		Implementation& target = objects[call.object];
+		switch (call.type)
+		{
+		case CallType_SetBase:
+			target.Implementation::SetBaseAttribute(call.effect.Attribute, call.effect.Modification);
+			break;
+		case CallType_AddEffect:
+			target.Implementation::AddLayeredEffect(call.effect);
+			break;
+		case CallType_Read:
+		{
+			int value = target.Implementation::GetCurrentAttribute(call.effect.Attribute);
+			result.checksum += value;
+			if (value != call.effect.Modification && result.mismatches++ == 0)
+			{
+				result.firstMismatch = i;
+			}
+			break;
+		}
+		case CallType_Clear:
+			target.Implementation::ClearLayeredEffects();
+			break;
+		}
+	}
+	auto stop = std::chrono::steady_clock::now();
+	result.calls = calls.size();
+	result.seconds = std::chrono::duration<double>(stop - start).count();
+	return result;
+}
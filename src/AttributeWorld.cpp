@@ -0,0 +1,1051 @@
+#include "AttributeWorld.hpp"
+#include "ColumnKernels.hpp"
+#include "Timeline.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+	// Builds every element with make(); a pmr container only keeps its
+	// resource when constructed with it, assigning one does not carry it over.
+	template <size_t N, typename Make, size_t... I>
+	auto makeArray(Make make, std::index_sequence<I...>) -> std::array<decltype(make()), N>
+	{
+		return { { ((void)I, make())... } };
+	}
+
+	template <size_t N, typename Make>
+	auto makeArray(Make make)
+	{
+		return makeArray<N>(make, std::make_index_sequence<N>());
+	}
+}
+
+AttributeWorld::AttributeWorld(bool errorLoggingEnabled, bool errorHandlingEnabled, std::pmr::memory_resource* resource)
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled),
+	baseColumns(makeArray<NumAttributes>([resource] { return std::pmr::vector<int>(resource); })),
+	currentColumns(makeArray<NumAttributes>([resource] { return std::pmr::vector<int>(resource); })),
+	dirtyColumns(makeArray<NumAttributes>([resource] { return std::pmr::vector<uint8_t>(resource); })),
+	generations(resource), live(resource), effects(resource), clearEpochs(resource), freeSlots(resource), entityGroups(resource), entityGroupPositions(resource),
+	groups(resource), freeGroups(resource),
+	wheel(makeArray<WheelLevels>([resource] { return makeArray<WheelSize>([resource] { return std::pmr::vector<Timer>(resource); }); })),
+	distantTimers(resource), dueTimers(resource),
+	sources(resource), freeSources(resource), kernelSlots(resource), kernelMask(resource)
+{
+}
+
+// Reuses the most recently freed slot, so recently touched column entries are reused first.
+AttributeWorld::Entity AttributeWorld::CreateEntity()
+{
+	uint32_t slot;
+	if (freeSlots.empty())
+	{
+		slot = static_cast<uint32_t>(generations.size());
+		generations.push_back(0);
+		live.push_back(0);
+		effects.emplace_back();
+		clearEpochs.push_back(clearEpoch);
+		entityGroups.emplace_back();
+		entityGroupPositions.emplace_back();
+		for (size_t attribute = 0; attribute < NumAttributes; ++attribute)
+		{
+			baseColumns[attribute].push_back(0);
+			currentColumns[attribute].push_back(0);
+			dirtyColumns[attribute].push_back(0);
+		}
+	}
+	else
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	live[slot] = 1;
+	// a reused slot may have missed a ClearAllLayeredEffects, but it is empty and at its base values
+	clearEpochs[slot] = clearEpoch;
+	++liveEntityCount;
+	return { slot, generations[slot] };
+}
+
+// Returns false if the handle is stale or was never valid.
+bool AttributeWorld::DestroyEntity(Entity entity)
+{
+	if (!IsAlive(entity))
+	{
+		return false;
+	}
+	uint32_t slot = entity.index;
+	live[slot] = 0;
+	++generations[slot];
+	// clear() keeps the capacity for the next entity in this slot
+	effects[slot].clear();
+	while (!entityGroups[slot].empty())
+	{
+		leaveGroup(entityGroups[slot].back(), slot);
+	}
+	for (size_t attribute = 0; attribute < NumAttributes; ++attribute)
+	{
+		baseColumns[attribute][slot] = 0;
+		currentColumns[attribute][slot] = 0;
+		dirtyColumns[attribute][slot] = 0;
+	}
+	freeSlots.push_back(slot);
+	--liveEntityCount;
+	return true;
+}
+
+bool AttributeWorld::IsAlive(Entity entity) const
+{
+	return entity.index < generations.size() && live[entity.index] && generations[entity.index] == entity.generation;
+}
+
+void AttributeWorld::SetBaseAttribute(Entity entity, AttributeKey attribute, int value)
+{
+	if (entityIsValid(entity) == false || attributeInBounds(attribute) == false)
+	{
+		return;
+	}
+	catchUp(entity.index);
+	baseColumns[attribute][entity.index] = value;
+	if (effects[entity.index].empty() && entityGroups[entity.index].empty())
+	{
+		currentColumns[attribute][entity.index] = value;
+		dirtyColumns[attribute][entity.index] = 0;
+	}
+	else
+	{
+		dirtyColumns[attribute][entity.index] = 1;
+	}
+}
+
+int AttributeWorld::GetCurrentAttribute(Entity entity, AttributeKey attribute) const
+{
+	if (entityIsValid(entity) == false || attributeInBounds(attribute) == false)
+	{
+		return std::numeric_limits<int>::min();
+	}
+	return currentValue(entity.index, attribute);
+}
+
+void AttributeWorld::AddLayeredEffect(Entity entity, LayeredEffectDefinition effectDef)
+{
+	if (entityIsValid(entity) == false || attributeInBounds(effectDef.Attribute) == false)
+	{
+		return;
+	}
+	uint32_t slot = entity.index;
+	AttributeKey attribute = effectDef.Attribute;
+	TIMELINE_SPAN("AttributeWorld::AddLayeredEffect", slot, attribute);
+	Effect effect{ static_cast<uint8_t>(attribute), narrowOperation(effectDef.Operation), effectDef.Modification, effectDef.Layer, getNextTimestamp() };
+	catchUp(slot);
+	// group effects may sort after the new one, so only ungrouped entities take the shortcut
+	if (insertEffect(effects[slot], effect) && !dirtyColumns[attribute][slot] && entityGroups[slot].empty())
+	{
+		// applied on top of everything else, so the cached value can be updated in place
+		updateAttribute(effect, currentColumns[attribute][slot]);
+	}
+	else
+	{
+		dirtyColumns[attribute][slot] = 1;
+	}
+}
+
+void AttributeWorld::ClearLayeredEffects(Entity entity)
+{
+	if (entityIsValid(entity) == false)
+	{
+		return;
+	}
+	uint32_t slot = entity.index;
+	TIMELINE_SPAN("AttributeWorld::ClearLayeredEffects", slot);
+	clearSlot(slot);
+}
+
+void AttributeWorld::ClearAllLayeredEffects()
+{
+	TIMELINE_SPAN("AttributeWorld::ClearAllLayeredEffects");
+	++clearEpoch;
+}
+
+AttributeWorld::Group AttributeWorld::CreateGroup()
+{
+	uint32_t index;
+	if (freeGroups.empty())
+	{
+		index = static_cast<uint32_t>(groups.size());
+		groups.emplace_back(groups.get_allocator().resource());
+	}
+	else
+	{
+		index = freeGroups.back();
+		freeGroups.pop_back();
+	}
+	groups[index].live = true;
+	return { index, groups[index].generation };
+}
+
+bool AttributeWorld::DestroyGroup(Group group)
+{
+	if (!groupIsValid(group))
+	{
+		return false;
+	}
+	// every member leaves at once, so nothing in members needs to move
+	GroupData& data = groups[group.index];
+	for (uint32_t slot : data.members)
+	{
+		size_t index = membership(group.index, slot);
+		entityGroups[slot].erase(entityGroups[slot].begin() + index);
+		entityGroupPositions[slot].erase(entityGroupPositions[slot].begin() + index);
+		markGroupEffectsDirty(group.index, slot);
+	}
+	data.members.clear();
+	data.effects.clear();
+	data.live = false;
+	++data.generation;
+	freeGroups.push_back(group.index);
+	return true;
+}
+
+// Returns false if either handle is stale or the entity is already a member.
+bool AttributeWorld::AddToGroup(Group group, Entity entity)
+{
+	if (!groupIsValid(group) || entityIsValid(entity) == false)
+	{
+		return false;
+	}
+	auto& memberOf = entityGroups[entity.index];
+	if (std::find(memberOf.begin(), memberOf.end(), group.index) != memberOf.end())
+	{
+		return false;
+	}
+	memberOf.push_back(group.index);
+	entityGroupPositions[entity.index].push_back(static_cast<uint32_t>(groups[group.index].members.size()));
+	groups[group.index].members.push_back(entity.index);
+	markGroupEffectsDirty(group.index, entity.index);
+	return true;
+}
+
+// Returns false if either handle is stale or the entity is not a member.
+bool AttributeWorld::RemoveFromGroup(Group group, Entity entity)
+{
+	if (!groupIsValid(group) || entityIsValid(entity) == false)
+	{
+		return false;
+	}
+	const auto& memberOf = entityGroups[entity.index];
+	if (std::find(memberOf.begin(), memberOf.end(), group.index) == memberOf.end())
+	{
+		return false;
+	}
+	leaveGroup(group.index, entity.index);
+	return true;
+}
+
+// Returns a default GroupEffect if the group is stale or the attribute is out of range.
+AttributeWorld::GroupEffect AttributeWorld::AddGroupEffect(Group group, LayeredEffectDefinition effectDef)
+{
+	if (!groupIsValid(group) || attributeInBounds(effectDef.Attribute) == false)
+	{
+		return GroupEffect();
+	}
+	AttributeKey attribute = effectDef.Attribute;
+	Effect effect{ static_cast<uint8_t>(attribute), narrowOperation(effectDef.Operation), effectDef.Modification, effectDef.Layer, getNextTimestamp() };
+	GroupData& data = groups[group.index];
+	insertEffect(data.effects, effect);
+	auto& dirty = dirtyColumns[attribute];
+	for (uint32_t slot : data.members)
+	{
+		dirty[slot] = 1;
+	}
+	return { group, effect.timestamp, effect.layer, attribute };
+}
+
+// Returns false if the group is stale or the effect was already removed.
+bool AttributeWorld::RemoveGroupEffect(GroupEffect groupEffect)
+{
+	if (groupEffect.attribute < 0 || groupEffect.attribute >= static_cast<int>(NumAttributes))
+	{
+		return false;
+	}
+	const Group& group = groupEffect.group;
+	return removeEffect({ groupEffect.timestamp, group.index, group.generation, groupEffect.layer, static_cast<uint8_t>(groupEffect.attribute), true });
+}
+
+void AttributeWorld::AddLayeredEffect(Entity entity, LayeredEffectDefinition effectDef, uint64_t expiresAt)
+{
+	if (expiresAt <= currentTime)
+	{
+		return;
+	}
+	size_t timestamp = nextTimestamp;
+	AddLayeredEffect(entity, effectDef);
+	// the timestamp is only taken if the effect was stored
+	if (nextTimestamp != timestamp)
+	{
+		scheduleTimer({ expiresAt, { timestamp, entity.index, entity.generation, effectDef.Layer, static_cast<uint8_t>(effectDef.Attribute), false } });
+	}
+}
+
+void AttributeWorld::AddLayeredEffect(const Entity* entities, size_t count, LayeredEffectDefinition effectDef, uint64_t expiresAt)
+{
+	if (expiresAt <= currentTime)
+	{
+		return;
+	}
+	size_t timestamp = nextTimestamp;
+	AddLayeredEffect(entities, count, effectDef);
+	if (nextTimestamp == timestamp)
+	{
+		return;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (IsAlive(entities[i]))
+		{
+			scheduleTimer({ expiresAt, { timestamp, entities[i].index, entities[i].generation, effectDef.Layer, static_cast<uint8_t>(effectDef.Attribute), false } });
+		}
+	}
+}
+
+AttributeWorld::GroupEffect AttributeWorld::AddGroupEffect(Group group, LayeredEffectDefinition effectDef, uint64_t expiresAt)
+{
+	if (expiresAt <= currentTime)
+	{
+		return GroupEffect();
+	}
+	GroupEffect groupEffect = AddGroupEffect(group, effectDef);
+	if (groupIsValid(groupEffect.group))
+	{
+		scheduleTimer({ expiresAt, { groupEffect.timestamp, group.index, group.generation, effectDef.Layer, static_cast<uint8_t>(effectDef.Attribute), true } });
+	}
+	return groupEffect;
+}
+
+// Steps through every tick on which a bucket has work: first the buckets of
+// higher levels whose range starts at this tick are redistributed, then the
+// level 0 bucket of the tick is expired. Ticks in between would find only
+// empty buckets, so time jumps over them.
+void AttributeWorld::AdvanceTime(uint64_t tick)
+{
+	TIMELINE_SPAN("AttributeWorld::AdvanceTime");
+	while (currentTime < tick)
+	{
+		uint64_t next = timerCount == 0 ? Permanent : nextTimerTick();
+		if (next > tick)
+		{
+			currentTime = tick;
+			return;
+		}
+		currentTime = next;
+		for (size_t level = 1; level < WheelLevels; ++level)
+		{
+			size_t shift = WheelBits * level;
+			if ((currentTime & ((uint64_t(1) << shift) - 1)) != 0)
+			{
+				break;
+			}
+			cascade(wheel[level][(currentTime >> shift) & (WheelSize - 1)]);
+		}
+		if ((currentTime & ((uint64_t(1) << (WheelBits * WheelLevels)) - 1)) == 0)
+		{
+			cascade(distantTimers);
+		}
+		auto& bucket = wheel[0][currentTime & (WheelSize - 1)];
+		if (bucket.empty())
+		{
+			continue;
+		}
+		// swapped out, expiring never schedules but keeps the bucket's capacity
+		dueTimers.swap(bucket);
+		timerCount -= dueTimers.size();
+		for (const auto& timer : dueTimers)
+		{
+			removeEffect(timer.location);
+		}
+		dueTimers.clear();
+	}
+}
+
+AttributeWorld::Source AttributeWorld::CreateSource()
+{
+	uint32_t index;
+	if (freeSources.empty())
+	{
+		index = static_cast<uint32_t>(sources.size());
+		sources.emplace_back(sources.get_allocator().resource());
+	}
+	else
+	{
+		index = freeSources.back();
+		freeSources.pop_back();
+	}
+	sources[index].live = true;
+	return { index, sources[index].generation };
+}
+
+// Removes every effect the source still has in place; returns false if the handle is stale.
+bool AttributeWorld::DestroySource(Source source)
+{
+	if (!sourceIsValid(source))
+	{
+		return false;
+	}
+	RemoveEffectsFromSource(source);
+	SourceData& data = sources[source.index];
+	data.live = false;
+	++data.generation;
+	data.compactAt = 16;
+	freeSources.push_back(source.index);
+	return true;
+}
+
+void AttributeWorld::AddLayeredEffect(Entity entity, LayeredEffectDefinition effectDef, Source source, uint64_t expiresAt)
+{
+	if (!sourceIsValid(source))
+	{
+		return;
+	}
+	size_t timestamp = nextTimestamp;
+	AddLayeredEffect(entity, effectDef, expiresAt);
+	if (nextTimestamp != timestamp)
+	{
+		recordSourceEffect(source.index, { timestamp, entity.index, entity.generation, effectDef.Layer, static_cast<uint8_t>(effectDef.Attribute), false });
+	}
+}
+
+void AttributeWorld::AddLayeredEffect(const Entity* entities, size_t count, LayeredEffectDefinition effectDef, Source source, uint64_t expiresAt)
+{
+	if (!sourceIsValid(source))
+	{
+		return;
+	}
+	size_t timestamp = nextTimestamp;
+	AddLayeredEffect(entities, count, effectDef, expiresAt);
+	if (nextTimestamp == timestamp)
+	{
+		return;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (IsAlive(entities[i]))
+		{
+			recordSourceEffect(source.index, { timestamp, entities[i].index, entities[i].generation, effectDef.Layer, static_cast<uint8_t>(effectDef.Attribute), false });
+		}
+	}
+}
+
+AttributeWorld::GroupEffect AttributeWorld::AddGroupEffect(Group group, LayeredEffectDefinition effectDef, Source source, uint64_t expiresAt)
+{
+	if (!sourceIsValid(source))
+	{
+		return GroupEffect();
+	}
+	GroupEffect groupEffect = AddGroupEffect(group, effectDef, expiresAt);
+	if (groupIsValid(groupEffect.group))
+	{
+		recordSourceEffect(source.index, { groupEffect.timestamp, group.index, group.generation, effectDef.Layer, static_cast<uint8_t>(effectDef.Attribute), true });
+	}
+	return groupEffect;
+}
+
+// Returns 0 if the handle is stale. The index is emptied, so calling it
+// again only covers effects added after this call.
+size_t AttributeWorld::RemoveEffectsFromSource(Source source)
+{
+	if (!sourceIsValid(source))
+	{
+		return 0;
+	}
+	TIMELINE_SPAN("AttributeWorld::RemoveEffectsFromSource");
+	SourceData& data = sources[source.index];
+	size_t removed = 0;
+	for (const auto& location : data.effects)
+	{
+		removed += removeEffect(location) ? 1 : 0;
+	}
+	// clear() keeps the capacity for the source's next effects
+	data.effects.clear();
+	data.compactAt = 16;
+	return removed;
+}
+
+void AttributeWorld::AddLayeredEffect(const Entity* entities, size_t count, LayeredEffectDefinition effectDef)
+{
+	if (attributeInBounds(effectDef.Attribute) == false)
+	{
+		return;
+	}
+	AttributeKey attribute = effectDef.Attribute;
+	TIMELINE_SPAN("AttributeWorld::AddLayeredEffect (batched)", Timeline::None, attribute);
+	// one timestamp is enough, it only orders effects within each entity
+	Effect effect{ static_cast<uint8_t>(attribute), narrowOperation(effectDef.Operation), effectDef.Modification, effectDef.Layer, getNextTimestamp() };
+	auto& dirty = dirtyColumns[attribute];
+	kernelSlots.clear();
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (entityIsValid(entities[i]) == false)
+		{
+			continue;
+		}
+		uint32_t slot = entities[i].index;
+		catchUp(slot);
+		if (insertEffect(effects[slot], effect) && !dirty[slot] && entityGroups[slot].empty())
+		{
+			kernelSlots.push_back(slot);
+		}
+		else
+		{
+			dirty[slot] = 1;
+		}
+	}
+	if (kernelSlots.empty())
+	{
+		return;
+	}
+
+	auto bounds = std::minmax_element(kernelSlots.begin(), kernelSlots.end());
+	uint32_t first = *bounds.first;
+	size_t span = static_cast<size_t>(*bounds.second - first) + 1;
+	auto& current = currentColumns[attribute];
+	if (span > kernelSlots.size() * 4)
+	{
+		// too sparse for a pass over the column to pay off
+		for (uint32_t slot : kernelSlots)
+		{
+			updateAttribute(effect, current[slot]);
+		}
+		return;
+	}
+	kernelMask.assign(span, 0);
+	for (uint32_t slot : kernelSlots)
+	{
+		if (kernelMask[slot - first])
+		{
+			// listed twice, so it got two copies of the effect; leave it to a recalculation
+			dirty[slot] = 1;
+		}
+		kernelMask[slot - first] = 1;
+	}
+	ColumnKernels::ApplyMasked(effect.operation, effect.modification, current.data() + first, kernelMask.data(), span);
+}
+
+void AttributeWorld::GetCurrentAttribute(AttributeKey attribute, const Entity* entities, size_t count, int* values) const
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		std::fill(values, values + count, std::numeric_limits<int>::min());
+		return;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		values[i] = entityIsValid(entities[i]) ? currentValue(entities[i].index, attribute) : std::numeric_limits<int>::min();
+	}
+}
+
+std::vector<int> AttributeWorld::GetCurrentAttribute(AttributeKey attribute, const std::vector<Entity>& entities) const
+{
+	std::vector<int> values(entities.size());
+	GetCurrentAttribute(attribute, entities.data(), entities.size(), values.data());
+	return values;
+}
+
+const std::pmr::vector<int>& AttributeWorld::GetCurrentColumn(AttributeKey attribute) const
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		static const std::pmr::vector<int> empty;
+		return empty;
+	}
+	const auto& dirty = dirtyColumns[attribute];
+	for (uint32_t slot = 0; slot < dirty.size(); ++slot)
+	{
+		catchUp(slot);
+		if (dirty[slot])
+		{
+			currentValue(slot, attribute);
+		}
+	}
+	return currentColumns[attribute];
+}
+
+void AttributeWorld::RecomputeDirty()
+{
+	TIMELINE_SPAN("AttributeWorld::RecomputeDirty");
+	size_t chunkCount = (SlotCount() + RecomputeChunkSize - 1) / RecomputeChunkSize;
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		recomputeChunk(chunk);
+	}
+}
+
+void AttributeWorld::RecomputeDirty(WorkStealingPool& pool)
+{
+	TIMELINE_SPAN("AttributeWorld::RecomputeDirty");
+	size_t chunkCount = (SlotCount() + RecomputeChunkSize - 1) / RecomputeChunkSize;
+	pool.ParallelFor(chunkCount, [this](size_t chunk) { recomputeChunk(chunk); });
+}
+
+// Walks one column at a time, so each chunk streams through contiguous memory.
+void AttributeWorld::recomputeChunk(size_t chunk)
+{
+	// one span per chunk, on whichever thread ran it
+	TIMELINE_SPAN("AttributeWorld::recomputeChunk");
+	uint32_t first = static_cast<uint32_t>(chunk * RecomputeChunkSize);
+	uint32_t last = static_cast<uint32_t>(std::min<size_t>(first + RecomputeChunkSize, SlotCount()));
+	for (uint32_t slot = first; slot < last; ++slot)
+	{
+		catchUp(slot);
+	}
+	for (size_t a = 0; a < NumAttributes; ++a)
+	{
+		AttributeKey attribute = AttributeKey(a);
+		auto& dirty = dirtyColumns[attribute];
+		auto& current = currentColumns[attribute];
+		for (uint32_t slot = first; slot < last; ++slot)
+		{
+			if (dirty[slot])
+			{
+				current[slot] = calculateAttribute(slot, attribute);
+				dirty[slot] = 0;
+			}
+		}
+	}
+}
+
+// Applies a ClearAllLayeredEffects the slot has not seen yet. Touches only
+// the slot's own entries and never allocates, so RecomputeDirty can run it
+// on any thread.
+void AttributeWorld::catchUp(uint32_t slot) const
+{
+	if (clearEpochs[slot] != clearEpoch)
+	{
+		clearSlot(slot);
+	}
+}
+
+// clear() keeps the stack's capacity for the entity's next effects.
+void AttributeWorld::clearSlot(uint32_t slot) const
+{
+	clearEpochs[slot] = clearEpoch;
+	effects[slot].clear();
+	for (size_t attribute = 0; attribute < NumAttributes; ++attribute)
+	{
+		currentColumns[attribute][slot] = baseColumns[attribute][slot];
+		dirtyColumns[attribute][slot] = 0;
+	}
+	for (uint32_t group : entityGroups[slot])
+	{
+		markGroupEffectsDirty(group, slot);
+	}
+}
+
+int AttributeWorld::currentValue(uint32_t slot, AttributeKey attribute) const
+{
+	catchUp(slot);
+	if (dirtyColumns[attribute][slot])
+	{
+		TIMELINE_SPAN("AttributeWorld::calculateAttribute", slot, attribute);
+		currentColumns[attribute][slot] = calculateAttribute(slot, attribute);
+		dirtyColumns[attribute][slot] = 0;
+	}
+	return currentColumns[attribute][slot];
+}
+
+// Returns true if the effect was stored after every other effect of its attribute.
+bool AttributeWorld::insertEffect(std::pmr::vector<Effect>& stack, const Effect& effect)
+{
+	// the new effect has the newest timestamp, so it goes after every effect in the same layer
+	auto it = std::upper_bound(stack.begin(), stack.end(), effect,
+		[](const Effect& a, const Effect& b)
+		{
+			if (a.attribute != b.attribute)
+			{
+				return a.attribute < b.attribute;
+			}
+			return a.layer < b.layer;
+		});
+	bool lastInRun = it == stack.end() || it->attribute != effect.attribute;
+	stack.insert(it, effect);
+	return lastInRun;
+}
+
+bool AttributeWorld::groupIsValid(Group group) const
+{
+	return group.index < groups.size() && groups[group.index].live && groups[group.index].generation == group.generation;
+}
+
+// The first tick after currentTime on which AdvanceTime has a non-empty
+// bucket to expire or cascade, or Permanent if there is none. Every level is
+// looked at for one rotation at most, so this is O(WheelSize * WheelLevels).
+uint64_t AttributeWorld::nextTimerTick() const
+{
+	uint64_t next = Permanent;
+	// ticks past the end of time wrap around below currentTime and are never taken
+	for (uint64_t t = currentTime + 1; t > currentTime && t - currentTime <= WheelSize; ++t)
+	{
+		if (!wheel[0][t & (WheelSize - 1)].empty())
+		{
+			next = t;
+			break;
+		}
+	}
+	for (size_t level = 1; level < WheelLevels; ++level)
+	{
+		size_t shift = WheelBits * level;
+		uint64_t boundary = ((currentTime >> shift) + 1) << shift;
+		for (size_t i = 0; i < WheelSize && boundary > currentTime && boundary < next; ++i, boundary += uint64_t(1) << shift)
+		{
+			if (!wheel[level][(boundary >> shift) & (WheelSize - 1)].empty())
+			{
+				next = boundary;
+				break;
+			}
+		}
+	}
+	if (!distantTimers.empty())
+	{
+		size_t shift = WheelBits * WheelLevels;
+		uint64_t boundary = ((currentTime >> shift) + 1) << shift;
+		if (boundary > currentTime)
+		{
+			next = std::min(next, boundary);
+		}
+	}
+	return next;
+}
+
+// Puts the timer on the lowest level whose range covers its expiry.
+void AttributeWorld::scheduleTimer(const Timer& timer)
+{
+	if (timer.expiresAt == Permanent)
+	{
+		return;
+	}
+	++timerCount;
+	uint64_t delay = timer.expiresAt - currentTime;
+	for (size_t level = 0; level < WheelLevels; ++level)
+	{
+		size_t shift = WheelBits * level;
+		if (delay < (uint64_t(1) << (shift + WheelBits)))
+		{
+			auto& bucket = wheel[level][(timer.expiresAt >> shift) & (WheelSize - 1)];
+			if (bucket.capacity() == 0)
+			{
+				// reuse the buffer of the last expired bucket instead of growing a cold one
+				bucket.swap(dueTimers);
+			}
+			bucket.push_back(timer);
+			return;
+		}
+	}
+	distantTimers.push_back(timer);
+}
+
+// Reschedules every timer of a bucket whose range time has just entered;
+// each one lands on a lower level (or back among the distant timers).
+void AttributeWorld::cascade(std::pmr::vector<Timer>& bucket)
+{
+	// swapping needs both vectors on the same resource
+	std::pmr::vector<Timer> timers(bucket.get_allocator());
+	timers.swap(bucket);
+	timerCount -= timers.size();
+	for (const auto& timer : timers)
+	{
+		scheduleTimer(timer);
+	}
+}
+
+bool AttributeWorld::sourceIsValid(Source source) const
+{
+	return source.index < sources.size() && sources[source.index].live && sources[source.index].generation == source.generation;
+}
+
+// Once the index has doubled since it was last compacted, the locations of
+// effects that are already gone are dropped, so sources that live for the
+// whole game do not accumulate the effects that were cleared or expired.
+void AttributeWorld::recordSourceEffect(uint32_t source, const EffectLocation& location)
+{
+	SourceData& data = sources[source];
+	data.effects.push_back(location);
+	if (data.effects.size() < data.compactAt)
+	{
+		return;
+	}
+	data.effects.erase(std::remove_if(data.effects.begin(), data.effects.end(),
+		[this](const EffectLocation& stored)
+		{
+			auto* stack = findStack(stored);
+			return stack == nullptr || findEffect(*stack, stored) == stack->end();
+		}), data.effects.end());
+	data.compactAt = std::max<size_t>(16, data.effects.size() * 2);
+}
+
+// The stack the effect was stored in, or nullptr if its entity or group is gone.
+std::pmr::vector<AttributeWorld::Effect>* AttributeWorld::findStack(const EffectLocation& location)
+{
+	if (location.group)
+	{
+		return groupIsValid({ location.target, location.generation }) ? &groups[location.target].effects : nullptr;
+	}
+	uint32_t slot = location.target;
+	if (slot >= generations.size() || !live[slot] || generations[slot] != location.generation)
+	{
+		return nullptr;
+	}
+	catchUp(slot);
+	return &effects[slot];
+}
+
+// Returns stack.end() if the effect has been removed since.
+std::pmr::vector<AttributeWorld::Effect>::iterator AttributeWorld::findEffect(std::pmr::vector<Effect>& stack, const EffectLocation& location) const
+{
+	auto it = std::lower_bound(stack.begin(), stack.end(), location,
+		[](const Effect& effect, const EffectLocation& target)
+		{
+			if (effect.attribute != target.attribute)
+			{
+				return effect.attribute < target.attribute;
+			}
+			if (effect.layer != target.layer)
+			{
+				return effect.layer < target.layer;
+			}
+			return effect.timestamp < target.timestamp;
+		});
+	if (it == stack.end() || it->attribute != location.attribute || it->timestamp != location.timestamp)
+	{
+		return stack.end();
+	}
+	return it;
+}
+
+// Removes one stored effect; does nothing if it is already gone.
+bool AttributeWorld::removeEffect(const EffectLocation& location)
+{
+	auto* stack = findStack(location);
+	if (stack == nullptr)
+	{
+		return false;
+	}
+	auto it = findEffect(*stack, location);
+	if (it == stack->end())
+	{
+		return false;
+	}
+	if (location.group)
+	{
+		auto& dirty = dirtyColumns[location.attribute];
+		for (uint32_t slot : groups[location.target].members)
+		{
+			dirty[slot] = 1;
+		}
+		stack->erase(it);
+		return true;
+	}
+	uint32_t slot = location.target;
+	auto& dirty = dirtyColumns[location.attribute][slot];
+	bool onTop = it + 1 == stack->end() || (it + 1)->attribute != location.attribute;
+	int& current = currentColumns[location.attribute][slot];
+	if (onTop && !dirty && entityGroups[slot].empty() && it->operation == EffectOperation_Add)
+	{
+		// the last effect applied, and an invertible one, so it can be taken back in place
+		current -= it->modification;
+	}
+	else if (onTop && !dirty && entityGroups[slot].empty() && it->operation == EffectOperation_Subtract)
+	{
+		current += it->modification;
+	}
+	else if (onTop && !dirty && entityGroups[slot].empty() && it->operation == EffectOperation_BitwiseXor)
+	{
+		current ^= it->modification;
+	}
+	else
+	{
+		dirty = 1;
+	}
+	stack->erase(it);
+	return true;
+}
+
+// Marks every attribute the group has effects for as dirty on one member.
+void AttributeWorld::markGroupEffectsDirty(uint32_t group, uint32_t slot) const
+{
+	for (const auto& effect : groups[group].effects)
+	{
+		dirtyColumns[effect.attribute][slot] = 1;
+	}
+}
+
+// Index of group in entityGroups[slot]; the entity must be a member. Entities
+// belong to few groups, so this is cheap where searching members would not be.
+size_t AttributeWorld::membership(uint32_t group, uint32_t slot) const
+{
+	const auto& memberOf = entityGroups[slot];
+	return static_cast<size_t>(std::find(memberOf.begin(), memberOf.end(), group) - memberOf.begin());
+}
+
+void AttributeWorld::leaveGroup(uint32_t group, uint32_t slot)
+{
+	size_t index = membership(group, slot);
+	uint32_t position = entityGroupPositions[slot][index];
+	entityGroups[slot].erase(entityGroups[slot].begin() + index);
+	entityGroupPositions[slot].erase(entityGroupPositions[slot].begin() + index);
+	// swap-pop, then tell the member that moved where it now sits
+	auto& members = groups[group].members;
+	uint32_t moved = members.back();
+	members[position] = moved;
+	members.pop_back();
+	if (moved != slot)
+	{
+		entityGroupPositions[moved][membership(group, moved)] = position;
+	}
+	markGroupEffectsDirty(group, slot);
+}
+
+int AttributeWorld::calculateAttribute(uint32_t slot, AttributeKey attribute) const
+{
+	int result = baseColumns[attribute][slot];
+	auto attributeRange = [attribute](const std::pmr::vector<Effect>& stack)
+	{
+		auto first = std::lower_bound(stack.begin(), stack.end(), attribute,
+			[](const Effect& effect, AttributeKey key) { return effect.attribute < key; });
+		auto last = first;
+		while (last != stack.end() && last->attribute == attribute)
+		{
+			++last;
+		}
+		return std::make_pair(first, last);
+	};
+	auto own = attributeRange(effects[slot]);
+	if (entityGroups[slot].empty())
+	{
+		for (auto it = own.first; it != own.second; ++it)
+		{
+			updateAttribute(*it, result);
+		}
+		return result;
+	}
+
+	// k-way merge of the entity's own effects and the effects of every group it belongs to;
+	// entities rarely belong to many groups, so the cursors normally live on the stack
+	using Cursor = std::pair<std::pmr::vector<Effect>::const_iterator, std::pmr::vector<Effect>::const_iterator>;
+	std::array<Cursor, 8> inlineCursors;
+	// not on the world's resource: RecomputeDirty runs this on every pool thread
+	std::vector<Cursor> spilledCursors;
+	Cursor* cursors = inlineCursors.data();
+	if (entityGroups[slot].size() + 1 > inlineCursors.size())
+	{
+		spilledCursors.resize(entityGroups[slot].size() + 1);
+		cursors = spilledCursors.data();
+	}
+	size_t cursorCount = 0;
+	cursors[cursorCount++] = own;
+	for (uint32_t group : entityGroups[slot])
+	{
+		auto range = attributeRange(groups[group].effects);
+		if (range.first != range.second)
+		{
+			cursors[cursorCount++] = range;
+		}
+	}
+	while (true)
+	{
+		const Effect* next = nullptr;
+		size_t nextCursor = 0;
+		for (size_t i = 0; i < cursorCount; ++i)
+		{
+			if (cursors[i].first == cursors[i].second)
+			{
+				continue;
+			}
+			const Effect& candidate = *cursors[i].first;
+			if (next == nullptr || candidate.layer < next->layer || (candidate.layer == next->layer && candidate.timestamp < next->timestamp))
+			{
+				next = &candidate;
+				nextCursor = i;
+			}
+		}
+		if (next == nullptr)
+		{
+			return result;
+		}
+		updateAttribute(*next, result);
+		++cursors[nextCursor].first;
+	}
+}
+
+void AttributeWorld::updateAttribute(const Effect& effect, int& result) const
+{
+	if (effect.operation == EffectOperation_Set)
+	{
+		result = effect.modification;
+	}
+	else if (effect.operation == EffectOperation_Add)
+	{
+		result += effect.modification;
+	}
+	else if (effect.operation == EffectOperation_Subtract)
+	{
+		result -= effect.modification;
+	}
+	else if (effect.operation == EffectOperation_Multiply)
+	{
+		result *= effect.modification;
+	}
+	else if (effect.operation == EffectOperation_BitwiseOr)
+	{
+		result |= effect.modification;
+	}
+	else if (effect.operation == EffectOperation_BitwiseAnd)
+	{
+		result &= effect.modification;
+	}
+	else if (effect.operation == EffectOperation_BitwiseXor)
+	{
+		result ^= effect.modification;
+	}
+	else
+	{
+		// do nothing
+	}
+}
+
+bool AttributeWorld::entityIsValid(Entity entity) const
+{
+	bool stale = !IsAlive(entity);
+	if (stale && errorLoggingEnabled)
+	{
+		logError(entity);
+	}
+	if (stale && errorHandlingEnabled)
+	{
+		throw std::invalid_argument("Stale entity handle");
+	}
+	return !stale;
+}
+
+bool AttributeWorld::attributeInBounds(AttributeKey attribute) const
+{
+	bool outOfBounds = attribute < 0 || attribute >= static_cast<int>(NumAttributes);
+	if (outOfBounds && errorLoggingEnabled)
+	{
+		logError(attribute);
+	}
+	if (outOfBounds && errorHandlingEnabled)
+	{
+		throw std::out_of_range("Attribute out of range");
+	}
+	return !outOfBounds;
+}
+
+void AttributeWorld::logError([[maybe_unused]] AttributeKey attribute) const
+{
+	// Imagine that this method writes something useful to glog or similar logging service
+}
+
+void AttributeWorld::logError([[maybe_unused]] Entity entity) const
+{
+	// Imagine that this method writes something useful to glog or similar logging service
+}
@@ -0,0 +1,285 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+
+class WorkStealingPool;
+
+// Multi-entity attribute store.
+// Instead of one LayeredAttributes object per card, a world holds every
+// entity's base and current values in structure-of-arrays columns, one column
+// per AttributeKey, indexed by entity slot. Scanning "all Power values" is a
+// linear walk over one contiguous column. Entities are addressed by
+// generational handles, so a slot can be reused without reviving old handles.
+class AttributeWorld
+{
+public:
+	// Identifies one entity. A handle goes stale once its entity is destroyed,
+	// even if the slot it refers to is reused later.
+	struct Entity
+	{
+		uint32_t index = std::numeric_limits<uint32_t>::max();
+		uint32_t generation = 0;
+	};
+
+	// Identifies one group of entities that share effects.
+	struct Group
+	{
+		uint32_t index = std::numeric_limits<uint32_t>::max();
+		uint32_t generation = 0;
+	};
+
+	// Identifies one effect added through AddGroupEffect. The attribute and
+	// layer say where the effect sorts, so removal is a binary search.
+	struct GroupEffect
+	{
+		Group group;
+		size_t timestamp = 0;
+		int layer = 0;
+		AttributeKey attribute = AttributeKey_NotAssessed;
+	};
+
+	// Identifies whatever generated a set of effects, usually a permanent.
+	struct Source
+	{
+		uint32_t index = std::numeric_limits<uint32_t>::max();
+		uint32_t generation = 0;
+	};
+
+	// expiry of an effect that never expires
+	static constexpr uint64_t Permanent = std::numeric_limits<uint64_t>::max();
+
+	// Every column, effect stack, group, source and timer allocates from
+	// resource, which must outlive the world. With a per-game
+	// std::pmr::monotonic_buffer_resource, destroying the world frees nothing
+	// piece by piece and one release() returns the whole game's memory.
+	// RecomputeDirty never allocates, so the resource does not need to be
+	// thread-safe. Copies allocate from the default resource.
+	AttributeWorld(bool errorLoggingEnabled = false, bool errorHandlingEnabled = false, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	Entity CreateEntity();
+	bool DestroyEntity(Entity entity);
+	bool IsAlive(Entity entity) const;
+	size_t EntityCount() const { return liveEntityCount; }
+	// number of slots in every column, live or not
+	size_t SlotCount() const { return generations.size(); }
+
+	// Same semantics as ILayeredAttributes, per entity.
+	void SetBaseAttribute(Entity entity, AttributeKey attribute, int value);
+	int GetCurrentAttribute(Entity entity, AttributeKey attribute) const;
+	void AddLayeredEffect(Entity entity, LayeredEffectDefinition effect);
+	void ClearLayeredEffects(Entity entity);
+	// ClearLayeredEffects on every entity at once (end of turn) in O(1): it
+	// bumps the clear epoch, and each entity catches up the next time it is
+	// used, emptying its stack in place. Group effects stay, as they do for
+	// ClearLayeredEffects.
+	void ClearAllLayeredEffects();
+
+	// Applies one effect to many entities (anthems, "all creatures get -2/-2").
+	// Every entity gets its own copy of the effect; where it lands on top of a
+	// clean stack, the cached values are updated by one vectorized pass over
+	// the column (see ColumnKernels) instead of one scalar update per entity.
+	void AddLayeredEffect(const Entity* entities, size_t count, LayeredEffectDefinition effect);
+	void AddLayeredEffect(const std::vector<Entity>& entities, LayeredEffectDefinition effect) { AddLayeredEffect(entities.data(), entities.size(), effect); }
+
+	// Group effects (anthems, "creatures you control get +1/+1").
+	// A group effect is stored once and applies to every member of the group,
+	// ordered against the members' own effects by {layer, timestamp} as usual.
+	// Adding or removing it, or changing membership, only marks the affected
+	// members dirty. Group effects belong to the group, so ClearLayeredEffects
+	// on a member leaves them in place. Stale group handles are ignored and
+	// reported by a false / default return value.
+	Group CreateGroup();
+	bool DestroyGroup(Group group);
+	bool AddToGroup(Group group, Entity entity);
+	bool RemoveFromGroup(Group group, Entity entity);
+	GroupEffect AddGroupEffect(Group group, LayeredEffectDefinition effect);
+	bool RemoveGroupEffect(GroupEffect effect);
+
+	// Effects that expire ("until end of turn", "for N turns"). An effect
+	// added with an expiry tick is active while CurrentTime() < expiresAt and
+	// is removed by the AdvanceTime call that reaches expiresAt; one whose
+	// expiry has already been reached is never added, and one that expires
+	// at Permanent never expires. Expiry is tracked by a hierarchical timing
+	// wheel, so AdvanceTime costs amortized O(1) per effect; ticks on which
+	// no bucket expires or cascades are skipped, not visited, and only the
+	// attributes of expired effects are invalidated. Permanent effects are untouched, and expiring an effect
+	// that was cleared or whose entity was destroyed does nothing.
+	void AddLayeredEffect(Entity entity, LayeredEffectDefinition effect, uint64_t expiresAt);
+	void AddLayeredEffect(const Entity* entities, size_t count, LayeredEffectDefinition effect, uint64_t expiresAt);
+	void AddLayeredEffect(const std::vector<Entity>& entities, LayeredEffectDefinition effect, uint64_t expiresAt) { AddLayeredEffect(entities.data(), entities.size(), effect, expiresAt); }
+	GroupEffect AddGroupEffect(Group group, LayeredEffectDefinition effect, uint64_t expiresAt);
+	// Moves time forward to tick; earlier ticks are ignored.
+	void AdvanceTime(uint64_t tick);
+	uint64_t CurrentTime() const { return currentTime; }
+
+	// Effects tagged with their source. When a permanent leaves play, every
+	// effect it generated has to go at once, on whatever entities and
+	// attributes it landed. Each source keeps an index of where its effects
+	// are stored, so RemoveEffectsFromSource costs O(k) in the number of
+	// effects the source created instead of a scan of every stack. Effects
+	// that were cleared, expired or lost with their entity in the meantime
+	// are skipped. DestroySource removes the remaining effects as well.
+	// Stale source handles are ignored and nothing is added.
+	Source CreateSource();
+	bool DestroySource(Source source);
+	void AddLayeredEffect(Entity entity, LayeredEffectDefinition effect, Source source, uint64_t expiresAt = Permanent);
+	void AddLayeredEffect(const Entity* entities, size_t count, LayeredEffectDefinition effect, Source source, uint64_t expiresAt = Permanent);
+	void AddLayeredEffect(const std::vector<Entity>& entities, LayeredEffectDefinition effect, Source source, uint64_t expiresAt = Permanent) { AddLayeredEffect(entities.data(), entities.size(), effect, source, expiresAt); }
+	GroupEffect AddGroupEffect(Group group, LayeredEffectDefinition effect, Source source, uint64_t expiresAt = Permanent);
+	// Returns the number of effects removed.
+	size_t RemoveEffectsFromSource(Source source);
+
+	// Batched read of one attribute for many entities. values must have room
+	// for count entries; stale handles read as std::numeric_limits<int>::min().
+	void GetCurrentAttribute(AttributeKey attribute, const Entity* entities, size_t count, int* values) const;
+	std::vector<int> GetCurrentAttribute(AttributeKey attribute, const std::vector<Entity>& entities) const;
+
+	// Brings the whole column up to date and returns it, indexed by
+	// Entity::index. Slots without a live entity hold 0.
+	const std::pmr::vector<int>& GetCurrentColumn(AttributeKey attribute) const;
+
+	// Recomputes every dirty value of every entity in one pass, so that the
+	// reads that follow are all cache hits. The slots are cut into chunks of
+	// consecutive entities, and the pool spreads the chunks over its threads.
+	// Every value depends only on its own entity's effects and groups, and
+	// every chunk writes only its own slots, so the result is the same for
+	// any number of threads. No other call may run on the world meanwhile.
+	void RecomputeDirty();
+	void RecomputeDirty(WorkStealingPool& pool);
+
+private:
+	bool errorLoggingEnabled;
+	bool errorHandlingEnabled;
+
+	static const size_t NumAttributes = AttributeKey::AttributeKey_Controller + 1;
+
+	size_t nextTimestamp = 0;
+	size_t getNextTimestamp() { return nextTimestamp++; }
+
+	// Effects of one entity are kept in one vector sorted by
+	// {attribute, layer, timestamp}, so each attribute is a contiguous range.
+	struct Effect
+	{
+		uint8_t attribute;
+		uint8_t operation;
+		int modification;
+		int layer;
+		size_t timestamp;
+	};
+	// operations outside the enum do nothing, just like EffectOperation_Invalid,
+	// so they are stored as that rather than wrapping into a real operation
+	static uint8_t narrowOperation(int operation)
+	{
+		bool known = operation >= EffectOperation_Invalid && operation <= EffectOperation_BitwiseXor;
+		return static_cast<uint8_t>(known ? operation : EffectOperation_Invalid);
+	}
+
+	// columns, indexed by entity slot
+	std::array<std::pmr::vector<int>, NumAttributes> baseColumns;
+	mutable std::array<std::pmr::vector<int>, NumAttributes> currentColumns;
+	mutable std::array<std::pmr::vector<uint8_t>, NumAttributes> dirtyColumns;
+
+	// per slot; nested vectors get the outer vector's resource when emplaced
+	std::pmr::vector<uint32_t> generations;
+	std::pmr::vector<uint8_t> live;
+	mutable std::pmr::vector<std::pmr::vector<Effect>> effects; // mutable for catchUp()
+	// the last ClearAllLayeredEffects each slot has caught up with
+	uint64_t clearEpoch = 0;
+	mutable std::pmr::vector<uint64_t> clearEpochs;
+	std::pmr::vector<uint32_t> freeSlots;
+	size_t liveEntityCount = 0;
+	// groups each entity belongs to
+	std::pmr::vector<std::pmr::vector<uint32_t>> entityGroups;
+	// where the entity sits in each of those groups' members, index for index,
+	// so leaving a group is a swap-pop instead of a search
+	std::pmr::vector<std::pmr::vector<uint32_t>> entityGroupPositions;
+
+	struct GroupData
+	{
+		explicit GroupData(std::pmr::memory_resource* resource) : effects(resource), members(resource) {}
+		uint32_t generation = 0;
+		bool live = false;
+		std::pmr::vector<Effect> effects; // sorted like an entity's effects
+		std::pmr::vector<uint32_t> members;
+	};
+	std::pmr::vector<GroupData> groups;
+	std::pmr::vector<uint32_t> freeGroups;
+
+	// Where one stored effect lives, found again by {attribute, layer, timestamp}.
+	struct EffectLocation
+	{
+		size_t timestamp;
+		uint32_t target; // entity slot, or group index for a group effect
+		uint32_t generation;
+		int layer;
+		uint8_t attribute;
+		bool group;
+	};
+
+	// An expiring effect.
+	struct Timer
+	{
+		uint64_t expiresAt;
+		EffectLocation location;
+	};
+	// Level l holds timers due within 64^(l + 1) ticks, bucketed by bits
+	// [6l, 6l + 6) of their expiry; a bucket is redistributed to the levels
+	// below when time enters its range. Timers further out wait in
+	// distantTimers until the top level wraps.
+	static const size_t WheelBits = 6;
+	static const size_t WheelSize = size_t(1) << WheelBits;
+	static const size_t WheelLevels = 4;
+	std::array<std::array<std::pmr::vector<Timer>, WheelSize>, WheelLevels> wheel;
+	std::pmr::vector<Timer> distantTimers;
+	std::pmr::vector<Timer> dueTimers;
+	size_t timerCount = 0;
+	uint64_t currentTime = 0;
+
+	struct SourceData
+	{
+		explicit SourceData(std::pmr::memory_resource* resource) : effects(resource) {}
+		uint32_t generation = 0;
+		bool live = false;
+		std::pmr::vector<EffectLocation> effects;
+		// size at which effects that are already gone get dropped from the index
+		size_t compactAt = 16;
+	};
+	std::pmr::vector<SourceData> sources;
+	std::pmr::vector<uint32_t> freeSources;
+
+	// scratch space for the batched AddLayeredEffect, kept to avoid reallocating
+	std::pmr::vector<uint32_t> kernelSlots;
+	std::pmr::vector<uint8_t> kernelMask;
+
+	bool insertEffect(std::pmr::vector<Effect>& stack, const Effect& effect);
+	bool groupIsValid(Group group) const;
+	void markGroupEffectsDirty(uint32_t group, uint32_t slot) const;
+	size_t membership(uint32_t group, uint32_t slot) const;
+	void leaveGroup(uint32_t group, uint32_t slot);
+	void scheduleTimer(const Timer& timer);
+	void cascade(std::pmr::vector<Timer>& bucket);
+	uint64_t nextTimerTick() const;
+	bool sourceIsValid(Source source) const;
+	void recordSourceEffect(uint32_t source, const EffectLocation& location);
+	std::pmr::vector<Effect>* findStack(const EffectLocation& location);
+	std::pmr::vector<Effect>::iterator findEffect(std::pmr::vector<Effect>& stack, const EffectLocation& location) const;
+	bool removeEffect(const EffectLocation& location);
+	// slots per RecomputeDirty chunk, a few KB of every column
+	static const uint32_t RecomputeChunkSize = 1024;
+	void recomputeChunk(size_t chunk);
+	void catchUp(uint32_t slot) const;
+	void clearSlot(uint32_t slot) const;
+	int calculateAttribute(uint32_t slot, AttributeKey attribute) const;
+	int currentValue(uint32_t slot, AttributeKey attribute) const;
+	void updateAttribute(const Effect& effect, int& result) const;
+
+	bool entityIsValid(Entity entity) const;
+	bool attributeInBounds(AttributeKey attribute) const;
+	void logError(AttributeKey attribute) const;
+	void logError(Entity entity) const;
+};
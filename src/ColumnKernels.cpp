@@ -0,0 +1,213 @@
+#include "ColumnKernels.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COLUMN_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC accepts any intrinsic without a per-function target
+#define COLUMN_KERNELS_TARGET(isa)
+#else
+#define COLUMN_KERNELS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace
+{
+	void applyMaskedScalar(int operation, int modification, int* values, const uint8_t* mask, size_t count)
+	{
+		uint32_t m = static_cast<uint32_t>(modification);
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!mask[i])
+			{
+				continue;
+			}
+			uint32_t x = static_cast<uint32_t>(values[i]);
+			if (operation == EffectOperation_Set)
+			{
+				x = m;
+			}
+			else if (operation == EffectOperation_Add)
+			{
+				x += m;
+			}
+			else if (operation == EffectOperation_Subtract)
+			{
+				x -= m;
+			}
+			else if (operation == EffectOperation_Multiply)
+			{
+				x *= m;
+			}
+			else if (operation == EffectOperation_BitwiseOr)
+			{
+				x |= m;
+			}
+			else if (operation == EffectOperation_BitwiseAnd)
+			{
+				x &= m;
+			}
+			else if (operation == EffectOperation_BitwiseXor)
+			{
+				x ^= m;
+			}
+			else
+			{
+				// do nothing
+			}
+			values[i] = static_cast<int>(x);
+		}
+	}
+
+#ifdef COLUMN_KERNELS_X86
+	COLUMN_KERNELS_TARGET("sse4.1")
+	__m128i applySSE41(int operation, __m128i x, __m128i m)
+	{
+		switch (operation)
+		{
+		case EffectOperation_Set: return m;
+		case EffectOperation_Add: return _mm_add_epi32(x, m);
+		case EffectOperation_Subtract: return _mm_sub_epi32(x, m);
+		case EffectOperation_Multiply: return _mm_mullo_epi32(x, m);
+		case EffectOperation_BitwiseOr: return _mm_or_si128(x, m);
+		case EffectOperation_BitwiseAnd: return _mm_and_si128(x, m);
+		case EffectOperation_BitwiseXor: return _mm_xor_si128(x, m);
+		default: return x;
+		}
+	}
+
+	COLUMN_KERNELS_TARGET("sse4.1")
+	void applyMaskedSSE41(int operation, int modification, int* values, const uint8_t* mask, size_t count)
+	{
+		const __m128i m = _mm_set1_epi32(modification);
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			int32_t maskBytes;
+			std::memcpy(&maskBytes, mask + i, sizeof(maskBytes));
+			if (maskBytes == 0)
+			{
+				continue;
+			}
+			// widen the four mask bytes to four all-ones / all-zeros lanes
+			__m128i laneMask = _mm_cmpeq_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(maskBytes)), zero);
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+			__m128i result = _mm_blendv_epi8(applySSE41(operation, x, m), x, laneMask);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), result);
+		}
+		applyMaskedScalar(operation, modification, values + i, mask + i, count - i);
+	}
+
+	COLUMN_KERNELS_TARGET("avx2")
+	__m256i applyAVX2(int operation, __m256i x, __m256i m)
+	{
+		switch (operation)
+		{
+		case EffectOperation_Set: return m;
+		case EffectOperation_Add: return _mm256_add_epi32(x, m);
+		case EffectOperation_Subtract: return _mm256_sub_epi32(x, m);
+		case EffectOperation_Multiply: return _mm256_mullo_epi32(x, m);
+		case EffectOperation_BitwiseOr: return _mm256_or_si256(x, m);
+		case EffectOperation_BitwiseAnd: return _mm256_and_si256(x, m);
+		case EffectOperation_BitwiseXor: return _mm256_xor_si256(x, m);
+		default: return x;
+		}
+	}
+
+	COLUMN_KERNELS_TARGET("avx2")
+	void applyMaskedAVX2(int operation, int modification, int* values, const uint8_t* mask, size_t count)
+	{
+		const __m256i m = _mm256_set1_epi32(modification);
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			uint64_t maskBytes;
+			std::memcpy(&maskBytes, mask + i, sizeof(maskBytes));
+			if (maskBytes == 0)
+			{
+				continue;
+			}
+			__m128i packedMask = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask + i));
+			__m256i laneMask = _mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(packedMask), zero);
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+			__m256i result = _mm256_blendv_epi8(applyAVX2(operation, x, m), x, laneMask);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), result);
+		}
+		applyMaskedScalar(operation, modification, values + i, mask + i, count - i);
+	}
+
+	ColumnKernels::Level detectLevel()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int highestLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if (highestLeaf >= 7 && osSavesAvx)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (avx2)
+		{
+			return ColumnKernels::Level_AVX2;
+		}
+		return sse41 ? ColumnKernels::Level_SSE41 : ColumnKernels::Level_Scalar;
+	}
+#else
+	ColumnKernels::Level detectLevel()
+	{
+		return ColumnKernels::Level_Scalar;
+	}
+#endif
+}
+
+ColumnKernels::Level ColumnKernels::DetectedLevel()
+{
+	static const Level level = detectLevel();
+	return level;
+}
+
+const char* ColumnKernels::LevelName(Level level)
+{
+	switch (level)
+	{
+	case Level_AVX2: return "AVX2";
+	case Level_SSE41: return "SSE4.1";
+	default: return "scalar";
+	}
+}
+
+void ColumnKernels::ApplyMasked(int operation, int modification, int* values, const uint8_t* mask, size_t count)
+{
+	ApplyMasked(DetectedLevel(), operation, modification, values, mask, count);
+}
+
+void ColumnKernels::ApplyMasked(Level level, int operation, int modification, int* values, const uint8_t* mask, size_t count)
+{
+#ifdef COLUMN_KERNELS_X86
+	if (level == Level_AVX2)
+	{
+		applyMaskedAVX2(operation, modification, values, mask, count);
+		return;
+	}
+	if (level == Level_SSE41)
+	{
+		applyMaskedSSE41(operation, modification, values, mask, count);
+		return;
+	}
+#endif
+	applyMaskedScalar(operation, modification, values, mask, count);
+}
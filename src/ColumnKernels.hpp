@@ -0,0 +1,29 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized kernels over attribute columns.
+// ApplyMasked applies one operation/modification pair to every value whose
+// mask byte is non-zero, eight (AVX2) or four (SSE4.1) values at a time.
+// The instruction set is picked once at runtime; the scalar kernel is used
+// on CPUs (or compilers) without either. Arithmetic wraps like uint32_t in
+// every kernel, so all levels produce identical columns.
+class ColumnKernels
+{
+public:
+	enum Level
+	{
+		Level_Scalar,
+		Level_SSE41,
+		Level_AVX2
+	};
+
+	// best level supported by this CPU and build
+	static Level DetectedLevel();
+	static const char* LevelName(Level level);
+
+	static void ApplyMasked(int operation, int modification, int* values, const uint8_t* mask, size_t count);
+	// Runs a specific kernel; level must not exceed DetectedLevel().
+	static void ApplyMasked(Level level, int operation, int modification, int* values, const uint8_t* mask, size_t count);
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// A std::pmr::memory_resource that forwards to another resource and counts
+// what passes through it, to measure how much an engine allocates and
+// whether everything it allocated has been given back. Counting is not
+// synchronized, so only one thread may allocate through it at a time.
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+	explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+		: upstream(upstream) {
+	}
+
+	uint64_t Allocations() const { return allocations; }
+	uint64_t Deallocations() const { return deallocations; }
+	// bytes allocated and not yet deallocated, and the most there ever were
+	size_t BytesInUse() const { return bytesInUse; }
+	size_t PeakBytes() const { return peakBytes; }
+
+private:
+	std::pmr::memory_resource* upstream;
+	uint64_t allocations = 0;
+	uint64_t deallocations = 0;
+	size_t bytesInUse = 0;
+	size_t peakBytes = 0;
+
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		void* p = upstream->allocate(bytes, alignment);
+		++allocations;
+		bytesInUse += bytes;
+		peakBytes = bytesInUse > peakBytes ? bytesInUse : peakBytes;
+		return p;
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		upstream->deallocate(p, bytes, alignment);
+		++deallocations;
+		bytesInUse -= bytes;
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
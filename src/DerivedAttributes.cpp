@@ -0,0 +1,170 @@
+#include "DerivedAttributes.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+DerivedAttributes::DerivedAttributes(ILayeredAttributes& attributes)
+	: attributes(attributes), nodes(NumAttributes)
+{
+}
+
+void DerivedAttributes::SetBaseAttribute(AttributeKey attribute, int value)
+{
+	attributes.SetBaseAttribute(attribute, value);
+	if (attribute >= 0 && attribute < static_cast<int>(NumAttributes))
+	{
+		invalidate(static_cast<uint32_t>(attribute));
+	}
+}
+
+int DerivedAttributes::GetCurrentAttribute(AttributeKey attribute) const
+{
+	return attributes.GetCurrentAttribute(attribute);
+}
+
+void DerivedAttributes::AddLayeredEffect(LayeredEffectDefinition effect)
+{
+	attributes.AddLayeredEffect(effect);
+	if (effect.Attribute >= 0 && effect.Attribute < static_cast<int>(NumAttributes))
+	{
+		invalidate(static_cast<uint32_t>(effect.Attribute));
+	}
+}
+
+void DerivedAttributes::ClearLayeredEffects()
+{
+	attributes.ClearLayeredEffects();
+	for (uint32_t attribute = 0; attribute < NumAttributes; ++attribute)
+	{
+		invalidate(attribute);
+	}
+}
+
+DerivedAttributes::DerivedAttribute DerivedAttributes::AddDerivedAttribute(const std::vector<DerivedInput>& inputs, DerivedFunction function)
+{
+	uint32_t added = static_cast<uint32_t>(nodes.size());
+	Node node;
+	for (const DerivedInput& input : inputs)
+	{
+		if (input.derived)
+		{
+			node.inputs.push_back(derivedNode(DerivedAttribute{ input.index }));
+		}
+		else if (input.index < NumAttributes)
+		{
+			node.inputs.push_back(input.index);
+		}
+		else
+		{
+			throw std::invalid_argument("Attribute out of range");
+		}
+	}
+	node.function = std::move(function);
+	node.inputValues.resize(inputs.size());
+	node.pending = true;
+	for (uint32_t input : node.inputs)
+	{
+		nodes[input].dependents.push_back(added);
+	}
+	nodes.push_back(std::move(node));
+	pendingNodes.push_back(added);
+	return DerivedAttribute{ added - static_cast<uint32_t>(NumAttributes) };
+}
+
+int DerivedAttributes::GetDerivedAttribute(DerivedAttribute derived) const
+{
+	return refresh(derivedNode(derived));
+}
+
+void DerivedAttributes::CollectChangedDerivedAttributes(std::vector<DerivedAttribute>& changed)
+{
+	// node order is a topological order, so every input is refreshed before
+	// the nodes that read it and each node is evaluated at most once
+	std::sort(pendingNodes.begin(), pendingNodes.end());
+	for (uint32_t pending : pendingNodes)
+	{
+		int value = refresh(pending);
+		Node& node = nodes[pending];
+		node.pending = false;
+		if (!node.collected || node.collectedValue != value)
+		{
+			node.collected = true;
+			node.collectedValue = value;
+			changed.push_back(DerivedAttribute{ pending - static_cast<uint32_t>(NumAttributes) });
+		}
+	}
+	pendingNodes.clear();
+}
+
+// Marks node and everything downstream of it stale. A node that is already
+// stale has stale dependents, so the walk stops there.
+void DerivedAttributes::invalidate(uint32_t node)
+{
+	if (nodes[node].stale)
+	{
+		return;
+	}
+	std::vector<uint32_t> work{ node };
+	nodes[node].stale = true;
+	while (!work.empty())
+	{
+		uint32_t current = work.back();
+		work.pop_back();
+		if (current >= NumAttributes && !nodes[current].pending)
+		{
+			nodes[current].pending = true;
+			pendingNodes.push_back(current);
+		}
+		for (uint32_t dependent : nodes[current].dependents)
+		{
+			if (!nodes[dependent].stale)
+			{
+				nodes[dependent].stale = true;
+				work.push_back(dependent);
+			}
+		}
+	}
+}
+
+int DerivedAttributes::refresh(uint32_t index) const
+{
+	Node& node = nodes[index];
+	if (!node.stale)
+	{
+		return node.value;
+	}
+	if (index < NumAttributes)
+	{
+		node.value = attributes.GetCurrentAttribute(static_cast<AttributeKey>(index));
+		node.stale = false;
+		return node.value;
+	}
+	bool changed = !node.evaluated;
+	for (size_t i = 0; i < node.inputs.size(); ++i)
+	{
+		int value = refresh(node.inputs[i]);
+		if (value != node.inputValues[i])
+		{
+			node.inputValues[i] = value;
+			changed = true;
+		}
+	}
+	if (changed)
+	{
+		node.value = node.function(node.inputValues);
+		node.evaluated = true;
+		++evaluations;
+	}
+	node.stale = false;
+	return node.value;
+}
+
+uint32_t DerivedAttributes::derivedNode(DerivedAttribute derived) const
+{
+	size_t node = static_cast<size_t>(derived.index) + NumAttributes;
+	if (derived.index == std::numeric_limits<uint32_t>::max() || node >= nodes.size())
+	{
+		throw std::invalid_argument("Unknown derived attribute");
+	}
+	return static_cast<uint32_t>(node);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Decorator that adds derived attributes to another ILayeredAttributes:
+// values computed by a pure function from attributes of the same object (or
+// from other derived attributes), such as a damage threshold derived from
+// Toughness. Every call is forwarded; writes also invalidate what depends on
+// the written attribute.
+//
+// The inputs of a derived attribute must already exist when it is added, so
+// the dependencies form a DAG by construction. A write marks its attribute
+// and everything downstream of it stale, stopping at what is already stale.
+// A stale derived attribute re-reads its inputs when it is next needed and
+// only calls its function if one of their values actually changed, so a
+// write that leaves a value as it was stops propagating there.
+class DerivedAttributes : public ILayeredAttributes
+{
+public:
+	// Identifies one derived attribute of this object.
+	struct DerivedAttribute
+	{
+		uint32_t index = std::numeric_limits<uint32_t>::max();
+	};
+
+	// An input of a derived attribute: an attribute or an earlier derived attribute.
+	struct DerivedInput
+	{
+		DerivedInput(AttributeKey attribute) : derived(false), index(static_cast<uint32_t>(attribute)) {}
+		DerivedInput(DerivedAttribute derived) : derived(true), index(derived.index) {}
+		bool derived;
+		uint32_t index;
+	};
+
+	// Called with the current values of the inputs, in the order they were given.
+	using DerivedFunction = std::function<int(const std::vector<int>& inputs)>;
+
+	explicit DerivedAttributes(ILayeredAttributes& attributes);
+
+	void SetBaseAttribute(AttributeKey attribute, int value) override;
+	int GetCurrentAttribute(AttributeKey attribute) const override;
+	void AddLayeredEffect(LayeredEffectDefinition effect) override;
+	void ClearLayeredEffects() override;
+
+	// Throws std::invalid_argument for an input that is neither an attribute
+	// nor a derived attribute of this object.
+	DerivedAttribute AddDerivedAttribute(const std::vector<DerivedInput>& inputs, DerivedFunction function);
+	// Throws std::invalid_argument for a handle this object did not return.
+	int GetDerivedAttribute(DerivedAttribute derived) const;
+
+	// Brings every stale derived attribute up to date and appends the ones
+	// whose value differs from when they were last collected (or that were
+	// never collected) to changed. A state-based-action check can act on
+	// exactly these instead of re-reading every derived value.
+	void CollectChangedDerivedAttributes(std::vector<DerivedAttribute>& changed);
+
+	// how many times a derived function has been called
+	uint64_t EvaluationCount() const { return evaluations; }
+
+private:
+	ILayeredAttributes& attributes;
+
+	static constexpr size_t NumAttributes = AttributeKey::AttributeKey_Controller + 1;
+
+	// Nodes [0, NumAttributes) are the attributes; every derived attribute
+	// is a node after its inputs, so node order is a topological order.
+	struct Node
+	{
+		std::vector<uint32_t> inputs;
+		std::vector<uint32_t> dependents;
+		DerivedFunction function;
+		// input values the current value was computed from
+		std::vector<int> inputValues;
+		int value = 0;
+		// an input may have changed since value was computed; a stale node's
+		// dependents are always stale too
+		bool stale = true;
+		bool evaluated = false;
+		// waiting for the next CollectChangedDerivedAttributes
+		bool pending = false;
+		bool collected = false;
+		int collectedValue = 0;
+	};
+
+	mutable std::vector<Node> nodes;
+	// derived nodes made stale (or added) since the last collect
+	std::vector<uint32_t> pendingNodes;
+	mutable uint64_t evaluations = 0;
+
+	void invalidate(uint32_t node);
+	int refresh(uint32_t node) const;
+	uint32_t derivedNode(DerivedAttribute derived) const;
+};
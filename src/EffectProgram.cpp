@@ -0,0 +1,181 @@
+#include "EffectProgram.hpp"
+
+void EffectProgram::Builder::append(int operation, int modification)
+{
+	EffectTransfer transfer = EffectTransfer::fromEffect(operation, modification);
+	if (transfer.isConstant())
+	{
+		// nothing in front of a constant can be observed
+		code.clear();
+		pending = transfer;
+		hasPending = true;
+	}
+	else if (transfer.isIdentity())
+	{
+		// removed effects and unknown operations end up here
+	}
+	else if (hasPending && pending.isConstant())
+	{
+		// a constant followed by anything is a constant, whatever the class
+		pending = { EffectTransfer::Kind_Affine, 0u, static_cast<uint32_t>(transfer.apply(static_cast<int>(pending.q))) };
+	}
+	else if (hasPending && pending.kind == transfer.kind)
+	{
+		pending = pending.then(transfer);
+		if (pending.isConstant())
+		{
+			code.clear();
+		}
+	}
+	else
+	{
+		lowerPending();
+		pending = transfer;
+		hasPending = true;
+	}
+}
+
+void EffectProgram::Builder::finish()
+{
+	lowerPending();
+	code.push_back({ Opcode_End, 0u, 0u });
+}
+
+void EffectProgram::Builder::lowerPending()
+{
+	if (!hasPending)
+	{
+		return;
+	}
+	hasPending = false;
+	uint32_t p = pending.p;
+	uint32_t q = pending.q;
+	if (pending.isIdentity())
+	{
+		// a stretch that cancelled itself out, e.g. +2 then -2
+	}
+	else if (pending.kind == EffectTransfer::Kind_Affine)
+	{
+		if (p == 0)
+		{
+			code.push_back({ Opcode_Const, q, 0u });
+		}
+		else if (p == 1)
+		{
+			code.push_back({ Opcode_Add, q, 0u });
+		}
+		else if (q == 0)
+		{
+			code.push_back({ Opcode_Multiply, p, 0u });
+		}
+		else
+		{
+			code.push_back({ Opcode_Affine, p, q });
+		}
+	}
+	else
+	{
+		if (q == 0)
+		{
+			code.push_back({ Opcode_And, p, 0u });
+		}
+		else if (p == ~0u)
+		{
+			code.push_back({ Opcode_Xor, q, 0u });
+		}
+		else if (p == ~q)
+		{
+			code.push_back({ Opcode_Or, q, 0u });
+		}
+		else
+		{
+			code.push_back({ Opcode_Mask, p, q });
+		}
+	}
+}
+
+int EffectProgram::Run(const Instruction* code, int value)
+{
+	uint32_t x = static_cast<uint32_t>(value);
+#if defined(__GNUC__)
+	// every handler ends in its own indirect jump, which predicts far better
+	// than the single shared jump of a switch
+	static const void* const dispatch[] = {
+		&&end, &&constant, &&add, &&multiply, &&affine, &&bitwiseAnd, &&bitwiseOr, &&bitwiseXor, &&mask };
+#define EFFECT_PROGRAM_NEXT() goto *dispatch[(++code)->opcode]
+	goto *dispatch[code->opcode];
+constant:
+	x = code->a;
+	EFFECT_PROGRAM_NEXT();
+add:
+	x += code->a;
+	EFFECT_PROGRAM_NEXT();
+multiply:
+	x *= code->a;
+	EFFECT_PROGRAM_NEXT();
+affine:
+	x = code->a * x + code->b;
+	EFFECT_PROGRAM_NEXT();
+bitwiseAnd:
+	x &= code->a;
+	EFFECT_PROGRAM_NEXT();
+bitwiseOr:
+	x |= code->a;
+	EFFECT_PROGRAM_NEXT();
+bitwiseXor:
+	x ^= code->a;
+	EFFECT_PROGRAM_NEXT();
+mask:
+	x = (x & code->a) ^ code->b;
+	EFFECT_PROGRAM_NEXT();
+#undef EFFECT_PROGRAM_NEXT
+end:
+	return static_cast<int>(x);
+#else
+	// the opcodes are dense, so this compiles to a jump table
+	for (;; ++code)
+	{
+		switch (code->opcode)
+		{
+		case Opcode_End:
+			return static_cast<int>(x);
+		case Opcode_Const:
+			x = code->a;
+			break;
+		case Opcode_Add:
+			x += code->a;
+			break;
+		case Opcode_Multiply:
+			x *= code->a;
+			break;
+		case Opcode_Affine:
+			x = code->a * x + code->b;
+			break;
+		case Opcode_And:
+			x &= code->a;
+			break;
+		case Opcode_Or:
+			x |= code->a;
+			break;
+		case Opcode_Xor:
+			x ^= code->a;
+			break;
+		case Opcode_Mask:
+			x = (x & code->a) ^ code->b;
+			break;
+		default:
+			break;
+		}
+	}
+#endif
+}
+
+size_t EffectProgram::Length(const Instruction* code)
+{
+	size_t length = 0;
+	while (code[length].opcode != Opcode_End)
+	{
+		++length;
+	}
+	return length;
+}
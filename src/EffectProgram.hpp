@@ -0,0 +1,61 @@
+#pragma once
+#include "EffectTransfer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compiled form of one attribute's sorted effect run.
+// Compiling folds every stretch of same-class effects into one transfer (see
+// EffectTransfer), drops identities, and discards everything in front of the
+// last constant, then lowers each remaining transfer to the cheapest
+// instruction that implements it. Folding is not limited to neighbouring
+// effects: a whole stretch of Add/Subtract/Multiply/Set collapses to one
+// instruction, as does a whole stretch of And/Or/Xor, so a stack only needs
+// as many instructions as it alternates between the two classes. Run
+// interprets a program with one indirect jump per instruction (computed goto
+// where the compiler has it, a dense switch elsewhere).
+class EffectProgram
+{
+public:
+	enum Opcode : uint8_t
+	{
+		Opcode_End,
+		Opcode_Const,    // x = a
+		Opcode_Add,      // x += a
+		Opcode_Multiply, // x *= a
+		Opcode_Affine,   // x = a * x + b
+		Opcode_And,      // x &= a
+		Opcode_Or,       // x |= a
+		Opcode_Xor,      // x ^= a
+		Opcode_Mask      // x = (x & a) ^ b
+	};
+
+	struct Instruction
+	{
+		Opcode opcode;
+		uint32_t a;
+		uint32_t b;
+	};
+
+	// Compiles effects handed to it in application order straight into code,
+	// reusing its capacity. The program is only complete after finish().
+	class Builder
+	{
+	public:
+		explicit Builder(std::vector<Instruction>& code) : code(code) { code.clear(); }
+		void append(int operation, int modification);
+		void finish();
+
+	private:
+		std::vector<Instruction>& code;
+		// the stretch of same-class effects folded so far, not yet lowered
+		EffectTransfer pending;
+		bool hasPending = false;
+		void lowerPending();
+	};
+
+	// Applies a finished program to value. Arithmetic wraps like uint32_t.
+	static int Run(const Instruction* code, int value);
+	// number of instructions before Opcode_End
+	static size_t Length(const Instruction* code);
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Transfer functions used to fold runs of layered effects into one step.
+//
+// Set/Add/Subtract/Multiply are closed under composition as affine maps
+//     x -> multiplier * x + addend
+// and And/Or/Xor are closed under composition as bit masks
+//     x -> (x & keep) ^ flip
+// (every bit is either kept, flipped, forced to 0 or forced to 1).
+// The arithmetic is done on uint32_t so that a folded transfer wraps exactly
+// like applying the effects one at a time.
+struct EffectTransfer
+{
+	enum Kind : uint8_t
+	{
+		Kind_Affine,
+		Kind_Mask
+	};
+
+	Kind kind = Kind_Affine;
+	uint32_t p = 1; // affine: multiplier, mask: keep
+	uint32_t q = 0; // affine: addend,     mask: flip
+
+	static EffectTransfer fromEffect(int operation, int modification)
+	{
+		uint32_t m = static_cast<uint32_t>(modification);
+		EffectTransfer transfer;
+		if (operation == EffectOperation_Set)
+		{
+			transfer = { Kind_Affine, 0u, m };
+		}
+		else if (operation == EffectOperation_Add)
+		{
+			transfer = { Kind_Affine, 1u, m };
+		}
+		else if (operation == EffectOperation_Subtract)
+		{
+			transfer = { Kind_Affine, 1u, 0u - m };
+		}
+		else if (operation == EffectOperation_Multiply)
+		{
+			transfer = { Kind_Affine, m, 0u };
+		}
+		else if (operation == EffectOperation_BitwiseOr)
+		{
+			transfer = { Kind_Mask, ~m, m };
+		}
+		else if (operation == EffectOperation_BitwiseAnd)
+		{
+			transfer = { Kind_Mask, m, 0u };
+		}
+		else if (operation == EffectOperation_BitwiseXor)
+		{
+			transfer = { Kind_Mask, ~0u, m };
+		}
+		else
+		{
+			// unknown operations leave the value untouched
+		}
+		return transfer.normalized();
+	}
+
+	// A constant transfer discards its input, whatever its kind.
+	bool isConstant() const { return p == 0; }
+
+	bool isIdentity() const
+	{
+		return kind == Kind_Affine ? (p == 1 && q == 0) : (p == ~0u && q == 0);
+	}
+
+	int apply(int value) const
+	{
+		uint32_t x = static_cast<uint32_t>(value);
+		return static_cast<int>(kind == Kind_Affine ? p * x + q : (x & p) ^ q);
+	}
+
+	// Returns "this, then next". Both transfers must be of the same kind.
+	EffectTransfer then(const EffectTransfer& next) const
+	{
+		EffectTransfer composed;
+		if (kind == Kind_Affine)
+		{
+			composed = { Kind_Affine, next.p * p, next.p * q + next.q };
+		}
+		else
+		{
+			composed = { Kind_Mask, p & next.p, (q & next.p) ^ next.q };
+		}
+		return composed.normalized();
+	}
+
+private:
+	// Constant masks are stored as constant affine maps, so that a constant
+	// absorbs whatever precedes it regardless of the operation class.
+	EffectTransfer normalized() const
+	{
+		if (kind == Kind_Mask && p == 0)
+		{
+			return { Kind_Affine, 0u, q };
+		}
+		return *this;
+	}
+};
+
+// A chain of transfers, kept as alternating affine and mask segments.
+// Adjacent segments of the same kind are fused and a constant segment drops
+// everything before it, so most chains collapse to one or two segments.
+// Chains that alternate more than MaxSegments times are flagged as overflowed
+// and must be evaluated from their parts instead.
+class ComposedTransfer
+{
+public:
+	static const size_t MaxSegments = 4;
+
+	ComposedTransfer() = default;
+	explicit ComposedTransfer(const EffectTransfer& transfer) { append(transfer); }
+
+	bool isOverflowed() const { return overflowed; }
+
+	// this, then next
+	void append(const EffectTransfer& next)
+	{
+		if (next.isConstant())
+		{
+			segments[0] = next;
+			count = 1;
+			overflowed = false;
+		}
+		else if (overflowed || next.isIdentity())
+		{
+			// nothing to record
+		}
+		else if (count > 0 && segments[count - 1].kind == next.kind)
+		{
+			EffectTransfer fused = segments[count - 1].then(next);
+			if (fused.isConstant())
+			{
+				segments[0] = fused;
+				count = 1;
+			}
+			else
+			{
+				segments[count - 1] = fused;
+			}
+		}
+		else if (count == MaxSegments)
+		{
+			overflowed = true;
+		}
+		else
+		{
+			segments[count++] = next;
+		}
+	}
+
+	// this, then next
+	void append(const ComposedTransfer& next)
+	{
+		if (next.overflowed)
+		{
+			overflowed = true;
+			return;
+		}
+		for (uint8_t i = 0; i < next.count; ++i)
+		{
+			append(next.segments[i]);
+		}
+	}
+
+	// Only meaningful when the chain is not overflowed.
+	int apply(int value) const
+	{
+		for (uint8_t i = 0; i < count; ++i)
+		{
+			value = segments[i].apply(value);
+		}
+		return value;
+	}
+
+private:
+	std::array<EffectTransfer, MaxSegments> segments;
+	uint8_t count = 0;
+	bool overflowed = false;
+};
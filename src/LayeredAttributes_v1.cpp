@@ -1,13 +1,16 @@
 #include "LayeredAttributes_v1.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 LayeredAttributes_v1::LayeredAttributes_v1(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
-	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max(1ULL, reservationSize))
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
 {
 	baseAttributes.fill(0);
 	currentAttributes.fill(0);
 	attributeDirty.fill(false);
 	highestLayers.fill(std::numeric_limits<int>::min());
+	modifierEpochs.fill(0);
 }
 
 //Set the base value for an attribute on this object. All base values
@@ -50,14 +53,15 @@ void LayeredAttributes_v1::AddLayeredEffect(LayeredEffectDefinition effect)
 	{
 		return;
 	}
-	if (attributeModifiers[effect.Attribute].count(effect.Layer) == 0)
+	auto& layerMods = currentModifiers(effect.Attribute);
+	if (layerMods.count(effect.Layer) == 0)
 	{
-		attributeModifiers[effect.Attribute].insert({ effect.Layer, std::vector<Mod>() });
+		layerMods.insert({ effect.Layer, std::vector<Mod>() });
 	}
-	auto& vecMods = attributeModifiers[effect.Attribute][effect.Layer];
+	auto& vecMods = layerMods[effect.Layer];
 	if (vecMods.capacity() < vecMods.size() + 1)
 	{
-		vecMods.reserve(attributeModifiers[effect.Attribute][effect.Layer].size() + reservationSize);
+		vecMods.reserve(vecMods.size() + reservationSize);
 	}
 	Mod mod = { effect.Operation, effect.Modification };
 	if (!vecMods.empty() && vecMods.back().operation == effect.Operation)
@@ -115,7 +119,8 @@ void LayeredAttributes_v1::AddLayeredEffect(LayeredEffectDefinition effect)
 //all current attributes will be equal to the base attributes.
 void LayeredAttributes_v1::ClearLayeredEffects()
 {
-	attributeModifiers = {};
+	// the layers are emptied lazily by currentModifiers(), keeping their vectors
+	++clearEpoch;
 	currentAttributes = baseAttributes;
 	highestLayers.fill(std::numeric_limits<int>::min());
 	for (int attribute = 0; attribute < NumAttributes; attribute++)
@@ -148,74 +153,69 @@ bool LayeredAttributes_v1::attributeInBounds(AttributeKey attribute) const
 	return !outOfBounds;
 }
 
+// The layers of attribute, emptied first if ClearLayeredEffects ran since they
+// were last used. Emptied layers stay in the map with their capacity.
+LayeredAttributes_v1::LayerModsMap& LayeredAttributes_v1::currentModifiers(AttributeKey attribute) const
+{
+	auto& layerMods = attributeModifiers[attribute];
+	if (modifierEpochs[attribute] != clearEpoch)
+	{
+		for (auto& [layer, mods] : layerMods)
+		{
+			mods.clear();
+		}
+		modifierEpochs[attribute] = clearEpoch;
+	}
+	return layerMods;
+}
+
 void LayeredAttributes_v1::calculateAndCache(AttributeKey attribute) const
 {
 	int result = baseAttributes[attribute];
-	for (const auto& [layer, mods] : attributeModifiers[attribute])
+	for (const auto& [layer, mods] : currentModifiers(attribute))
 	{
 		for (const auto& mod : mods)
 		{
-			if (mod.operation == EffectOperation::EffectOperation_Set)
-			{
-				result = mod.modifier;
-			}
-			else if (mod.operation == EffectOperation::EffectOperation_Add)
-			{
-				result += mod.modifier;
-			}
-			else if (mod.operation == EffectOperation::EffectOperation_Subtract)
-			{
-				result -= mod.modifier;
-			}
-			else if (mod.operation == EffectOperation::EffectOperation_Multiply)
-			{
-				result *= mod.modifier;
-			}
-			else if (mod.operation == EffectOperation::EffectOperation_BitwiseOr)
-			{
-				result |= mod.modifier;
-			}
-			else if (mod.operation == EffectOperation::EffectOperation_BitwiseAnd)
-			{
-				result &= mod.modifier;
-			}
-			else if (mod.operation == EffectOperation::EffectOperation_BitwiseXor)
-			{
-				result ^= mod.modifier;
-			}
+			applyMod(mod, result);
 		}
 	}
 	currentAttributes[attribute] = result;
 }
 
 void LayeredAttributes_v1::updateCache(AttributeKey attribute, const Mod& mod) const
+{
+	applyMod(mod, currentAttributes[attribute]);
+}
+
+// the one place an operation is dispatched, for both full and incremental updates
+void LayeredAttributes_v1::applyMod(const Mod& mod, int& result)
 {
 	if (mod.operation == EffectOperation::EffectOperation_Set)
 	{
-		currentAttributes[attribute] = mod.modifier;
+		result = mod.modifier;
 	}
 	else if (mod.operation == EffectOperation::EffectOperation_Add)
 	{
-		currentAttributes[attribute] += mod.modifier;
+		result += mod.modifier;
 	}
 	else if (mod.operation == EffectOperation::EffectOperation_Subtract)
 	{
-		currentAttributes[attribute] -= mod.modifier;
+		result -= mod.modifier;
 	}
 	else if (mod.operation == EffectOperation::EffectOperation_Multiply)
 	{
-		currentAttributes[attribute] *= mod.modifier;
+		result *= mod.modifier;
 	}
 	else if (mod.operation == EffectOperation::EffectOperation_BitwiseOr)
 	{
-		currentAttributes[attribute] |= mod.modifier;
+		result |= mod.modifier;
 	}
 	else if (mod.operation == EffectOperation::EffectOperation_BitwiseAnd)
 	{
-		currentAttributes[attribute] &= mod.modifier;
+		result &= mod.modifier;
 	}
 	else if (mod.operation == EffectOperation::EffectOperation_BitwiseXor)
 	{
-		currentAttributes[attribute] ^= mod.modifier;
+		result ^= mod.modifier;
 	}
 }
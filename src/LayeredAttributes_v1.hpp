@@ -1,5 +1,6 @@
 #pragma once
 #include "ILayeredAttributes.hpp"
+#include <cstddef>
 #include <vector>
 #include <map>
 #include <array>
@@ -30,10 +31,16 @@ private:
 	using LayerModsMap = std::map</*layer*/int, std::vector<Mod>>;
 	mutable std::array<LayerModsMap, NumAttributes> attributeModifiers;
 	mutable std::array<bool, NumAttributes> attributeDirty;
+	// ClearLayeredEffects only bumps clearEpoch; an attribute whose epoch is
+	// behind has its layers emptied in place the next time it is used
+	size_t clearEpoch = 0;
+	mutable std::array<size_t, NumAttributes> modifierEpochs;
 
 	void logError(LayeredEffectDefinition effect);
 	void logError(AttributeKey attribute) const;
 	bool attributeInBounds(AttributeKey attribute) const;
+	LayerModsMap& currentModifiers(AttributeKey attribute) const;
 	void calculateAndCache(AttributeKey attribute) const;
 	void updateCache(AttributeKey attribute, const Mod& mod) const;
+	static void applyMod(const Mod& mod, int& result);
 };
@@ -1,8 +1,13 @@
 #include "LayeredAttributes_v2.hpp"
+#include "Timeline.hpp"
 #include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
 
-LayeredAttributes_v2::LayeredAttributes_v2(bool errorLoggingEnabled, size_t reservationSize)
-	: errorLoggingEnabled(errorLoggingEnabled), reservationSize(std::max(1ULL, reservationSize))
+LayeredAttributes_v2::LayeredAttributes_v2(bool errorLoggingEnabled, size_t reservationSize, std::pmr::memory_resource* resource)
+	: errorLoggingEnabled(errorLoggingEnabled), reservationSize(std::max<size_t>(1, reservationSize)),
+	baseAttributes(resource), effects(resource), attributeDirty(resource), cache(resource)
 {
 	baseAttributes.reserve(reservationSize);
 	cache.reserve(reservationSize);
@@ -30,21 +35,23 @@ int LayeredAttributes_v2::GetCurrentAttribute(AttributeKey attribute) const
 	{
 		logError(attribute);
 	}
+	ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Reads));
 	auto it = cache.find(attribute);
 	if (it == cache.end())
 	{
-		it = cache.insert({ attribute, calculateAttribute(attribute) }).first;
+		it = cache.insert({ attribute, { calculateAttribute(attribute), clearEpoch } }).first;
+		attributeDirty[attribute] = false;
 	}
-	else if (attributeDirty[attribute])
+	else if (it->second.epoch != clearEpoch || attributeDirty[attribute])
 	{
-		it->second = calculateAttribute(attribute);
+		it->second = { calculateAttribute(attribute), clearEpoch };
 		attributeDirty[attribute] = false;
 	}
 	else
 	{
-		// do nothing
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_CacheHits));
 	}
-	return it->second;
+	return it->second.value;
 }
 
 //Applies a new layered effect to this object's attributes. See
@@ -58,32 +65,89 @@ void LayeredAttributes_v2::AddLayeredEffect(LayeredEffectDefinition effectDef)
 	{
 		logError(effectDef.Attribute);
 	}
-	size_t timestamp = getNextTimestamp();
-	auto effect = Effect(effectDef, timestamp);
-	AttributeKey attribute = effect.getAttribute();
-	if (updateIncrementally(effect))
+	ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Adds));
+	TIMELINE_SPAN("LayeredAttributes_v2::AddLayeredEffect", reinterpret_cast<uintptr_t>(this), effectDef.Attribute);
+	if (nextTimestamp > MaxTimestamp)
+	{
+		RenumberTimestamps();
+	}
+	uint64_t key = packEffect(effectDef.Layer, getNextTimestamp(), effectDef.Operation);
+	AttributeKey attribute = effectDef.Attribute;
+	auto& stack = currentEffects(attribute);
+	if (updateIncrementally(stack, key, effectDef.Modification))
 	{
-		updateAttribute(effect, cache[attribute]);
+		updateAttribute(keyOperation(key), effectDef.Modification, cache[attribute].value);
 	}
 	else
 	{
-		if (effects[attribute].size() + 1 > reservationSize)
+		if (stack.size() + 1 > stack.keys.capacity())
 		{
-			effects[attribute].reserve(effects.size() + reservationSize);
+			// grow geometrically; reserving a fixed step (or the map size) made loading n effects O(n^2)
+			size_t capacity = stack.size() + std::max(reservationSize, stack.size());
+			stack.keys.reserve(capacity);
+			stack.modifications.reserve(capacity);
 		}
-		auto it = std::lower_bound(effects[attribute].begin(), effects[attribute].end(), effect, EffectComparator());
-		effects[attribute].insert(it, effect);
+		// the new timestamp is the largest yet, so this lands after its layer's effects
+		auto it = std::lower_bound(stack.keys.begin(), stack.keys.end(), key);
+		size_t position = static_cast<size_t>(it - stack.keys.begin());
+		stack.keys.insert(it, key);
+		stack.modifications.insert(stack.modifications.begin() + position, effectDef.Modification);
 		attributeDirty[attribute] = true;
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Inserts));
 	}
+	ATTRIBUTE_STATS(stats.added(stack.size()));
 }
 
 //Removes all layered effects from this object. After this call,
 //all current attributes will be equal to the base attributes.
 void LayeredAttributes_v2::ClearLayeredEffects()
 {
-	effects = {};
-	cache = {};
-	attributeDirty = {};
+	TIMELINE_SPAN("LayeredAttributes_v2::ClearLayeredEffects", reinterpret_cast<uintptr_t>(this));
+	// nothing is freed: stale stacks are emptied in place by currentEffects(),
+	// stale cached values are recalculated by the next read
+	++clearEpoch;
+}
+
+void LayeredAttributes_v2::RenumberTimestamps()
+{
+	// Timestamps only order effects within a stack, so ranking every current
+	// timestamp across all stacks keeps each stack's order, and its keys sorted.
+	std::vector<size_t> timestamps;
+	for (auto& entry : effects)
+	{
+		for (uint64_t key : currentEffects(entry.first).keys)
+		{
+			timestamps.push_back(keyTimestamp(key));
+		}
+	}
+	if (timestamps.size() > MaxTimestamp)
+	{
+		throw std::length_error("Too many layered effects to renumber");
+	}
+	std::sort(timestamps.begin(), timestamps.end());
+	for (auto& entry : effects)
+	{
+		for (uint64_t& key : entry.second.keys)
+		{
+			auto rank = std::lower_bound(timestamps.begin(), timestamps.end(), keyTimestamp(key)) - timestamps.begin();
+			key = withTimestamp(key, static_cast<size_t>(rank));
+		}
+	}
+	nextTimestamp = timestamps.size();
+}
+
+AttributeStats LayeredAttributes_v2::GetStats() const
+{
+#if defined(LAYERED_ATTRIBUTES_STATS)
+	return stats.snapshot();
+#else
+	return AttributeStats();
+#endif
+}
+
+void LayeredAttributes_v2::ResetStats()
+{
+	ATTRIBUTE_STATS(stats.reset());
 }
 
 bool LayeredAttributes_v2::isValidAttributeKey(AttributeKey attribute) const
@@ -117,48 +181,67 @@ void LayeredAttributes_v2::logError([[maybe_unused]] AttributeKey attribute) con
 	// Imagine that this method writes something useful to glog or similar logging service
 }
 
+// The effects of attribute, emptied first if they were cleared since they
+// were last used. clear() keeps the arrays' capacity for the next effects.
+LayeredAttributes_v2::EffectStack& LayeredAttributes_v2::currentEffects(AttributeKey attribute) const
+{
+	auto& stack = effects[attribute];
+	if (stack.epoch != clearEpoch)
+	{
+		stack.clear();
+		stack.epoch = clearEpoch;
+		attributeDirty[attribute] = true;
+	}
+	return stack;
+}
+
 int LayeredAttributes_v2::calculateAttribute(AttributeKey attribute) const
 {
 	// the map defaults to zero if no key is present
 	int result = baseAttributes[attribute];
+	const auto& stack = currentEffects(attribute);
+	ATTRIBUTE_STATS(stats.recomputed(stack.size()));
+	TIMELINE_SPAN("LayeredAttributes_v2::calculateAttribute", reinterpret_cast<uintptr_t>(this), attribute);
 
-	for (auto& effect : effects[attribute])
+	const uint64_t* keys = stack.keys.data();
+	const int* modifications = stack.modifications.data();
+	for (size_t i = 0, count = stack.size(); i < count; ++i)
 	{
-		updateAttribute(effect, result);
+		updateAttribute(keyOperation(keys[i]), modifications[i], result);
 	}
 
 	return result;
 }
 
-void LayeredAttributes_v2::updateAttribute(const Effect& effect, int& result) const
+void LayeredAttributes_v2::updateAttribute(int operation, int modification, int& result) const
 {
-	if (effect.getOperation() == EffectOperation_Set)
+	if (operation == EffectOperation_Set)
 	{
-		result = effect.getModification();
+		result = modification;
 	}
-	else if (effect.getOperation() == EffectOperation_Add)
+	else if (operation == EffectOperation_Add)
 	{
-		result += effect.getModification();
+		result += modification;
 	}
-	else if (effect.getOperation() == EffectOperation_Subtract)
+	else if (operation == EffectOperation_Subtract)
 	{
-		result -= effect.getModification();
+		result -= modification;
 	}
-	else if (effect.getOperation() == EffectOperation_Multiply)
+	else if (operation == EffectOperation_Multiply)
 	{
-		result *= effect.getModification();
+		result *= modification;
 	}
-	else if (effect.getOperation() == EffectOperation_BitwiseOr)
+	else if (operation == EffectOperation_BitwiseOr)
 	{
-		result |= effect.getModification();
+		result |= modification;
 	}
-	else if (effect.getOperation() == EffectOperation_BitwiseAnd)
+	else if (operation == EffectOperation_BitwiseAnd)
 	{
-		result &= effect.getModification();
+		result &= modification;
 	}
-	else if (effect.getOperation() == EffectOperation_BitwiseXor)
+	else if (operation == EffectOperation_BitwiseXor)
 	{
-		result ^= effect.getModification();
+		result ^= modification;
 	}
 	else
 	{
@@ -166,57 +249,56 @@ void LayeredAttributes_v2::updateAttribute(const Effect& effect, int& result) co
 	}
 }
 
-bool LayeredAttributes_v2::updateIncrementally(const Effect& effect)
+bool LayeredAttributes_v2::updateIncrementally(EffectStack& stack, uint64_t key, int modification)
 {
-	AttributeKey attribute = effect.getAttribute();
-	if (effects[attribute].empty())
+	if (stack.empty())
 	{
 		return false;
 	}
-	auto& oldEffect = effects[attribute].back();
-	if (oldEffect.getLayer() != effect.getLayer())
+	uint64_t oldKey = stack.keys.back();
+	if (keyLayer(oldKey) != keyLayer(key))
 	{
 		return false;
 	}
-	auto oldOperation = oldEffect.getOperation();
+	auto oldOperation = keyOperation(oldKey);
 	if (oldOperation == EffectOperation::EffectOperation_BitwiseXor)
 	{
 		return false;
 	}
-	auto operation = effect.getOperation();
+	auto operation = keyOperation(key);
 	if (operation == oldOperation)
 	{
-		int updatedModification = oldEffect.getModification();
+		int& updatedModification = stack.modifications.back();
 		if (operation == EffectOperation_Set)
 		{
-			updatedModification = effect.getModification();
+			updatedModification = modification;
 		}
 		else if (operation == EffectOperation_Add || operation == EffectOperation_Subtract)
 		{
-			updatedModification += effect.getModification();
+			updatedModification += modification;
 		}
 		else if (operation == EffectOperation_Multiply)
 		{
-			updatedModification *= effect.getModification();
+			updatedModification *= modification;
 		}
 		else if (operation == EffectOperation_BitwiseOr)
 		{
-			updatedModification |= effect.getModification();
+			updatedModification |= modification;
 		}
 		else if (operation == EffectOperation_BitwiseAnd)
 		{
-			updatedModification &= effect.getModification();
+			updatedModification &= modification;
 		}
 		else
 		{
 		}
-		oldEffect.updateModification(updatedModification);
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Merges));
 	}
 	else
 	{
-		effects[attribute].push_back(effect);
+		stack.keys.push_back(key);
+		stack.modifications.push_back(modification);
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Appends));
 	}
 	return true;
 }
-
-
@@ -1,63 +1,129 @@
 #pragma once
 #include "ILayeredAttributes.hpp"
+#include "AttributeStats.hpp"
+#include "SmallVector.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <vector>
 #include <unordered_map>
 
+// Effects an attribute's stack holds inline before it allocates. In recorded
+// games every attribute read had 0-3 effects (90% had 0-2), so by default a
+// stack only allocates on its fourth effect. 0 allocates every stack.
+#if !defined(LAYERED_ATTRIBUTES_INLINE_EFFECTS)
+#define LAYERED_ATTRIBUTES_INLINE_EFFECTS 3
+#endif
+
 class LayeredAttributes_v2 : public ILayeredAttributes
 {
 public:
-	LayeredAttributes_v2(bool errorLoggingEnabled = false, size_t rereservationSize = 10ULL);
+	// Every map and effect vector allocates from resource, which must outlive
+	// the object. Backing many objects with one std::pmr::monotonic_buffer_resource
+	// makes each deallocation a no-op and frees all of them with one release().
+	// Copies allocate from the default resource.
+	LayeredAttributes_v2(bool errorLoggingEnabled = false, size_t rereservationSize = 10ULL, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 	virtual ~LayeredAttributes_v2() = default;
 	void SetBaseAttribute(AttributeKey attribute, int value) override;
 	int GetCurrentAttribute(AttributeKey attribute) const override;
 	void AddLayeredEffect(LayeredEffectDefinition effect) override;
+	// O(1): bumps the clear epoch. Every stack cleared this way is emptied the
+	// next time its attribute is used, keeping its capacity for the next turn.
 	void ClearLayeredEffects() override;
 
+	// Hot-path counters since construction or the last ResetStats(); all
+	// zeros unless built with LAYERED_ATTRIBUTES_STATS (see AttributeStats.hpp).
+	AttributeStats GetStats() const;
+	void ResetStats();
+
+	static constexpr size_t InlineEffects = LAYERED_ATTRIBUTES_INLINE_EFFECTS;
+
+	// Renumbers the timestamps of the current effects 0, 1, 2, ... keeping
+	// their order, so new timestamps fit in their field again. AddLayeredEffect
+	// calls it when the counter would overflow; calling it early changes no value.
+	void RenumberTimestamps();
+
 private:
 	bool errorLoggingEnabled;
 	size_t reservationSize;
 
 	size_t nextTimestamp = 0;
 	size_t getNextTimestamp() { return nextTimestamp++; }
+	// stacks and cached values from an earlier epoch were cleared since
+	size_t clearEpoch = 0;
+
+	// An effect is packed into one 64-bit key that sorts like {layer, timestamp}:
+	// the layer (biased to unsigned) in the high 32 bits, then the timestamp,
+	// then the operation. Timestamps are unique, so the operation never decides
+	// the order, and it never changes once the effect is stored. The attribute
+	// is implied by the stack and the modification lives in a parallel array,
+	// so an effect takes 12 bytes where a LayeredEffectDefinition plus a
+	// timestamp took 24.
+	static constexpr unsigned OperationBits = 3;
+	static constexpr unsigned TimestampBits = 29;
+	static constexpr uint64_t OperationMask = (uint64_t(1) << OperationBits) - 1;
+	static constexpr size_t MaxTimestamp = (size_t(1) << TimestampBits) - 1;
+	static_assert(EffectOperation_BitwiseXor <= OperationMask, "every operation must fit in its field");
 
-	class Effect
+	static uint64_t packEffect(int layer, size_t timestamp, int operation)
 	{
-	public:
-		Effect(LayeredEffectDefinition effectDef, size_t timestamp)
-			: effectDef(std::move(effectDef)), timestamp(timestamp) {
+		// operations outside the enum do nothing, just like EffectOperation_Invalid
+		if (operation < EffectOperation_Invalid || operation > EffectOperation_BitwiseXor)
+		{
+			operation = EffectOperation_Invalid;
 		}
-		void updateModification(int modification) { effectDef.Modification = modification; }
-		AttributeKey getAttribute() const { return effectDef.Attribute; }
-		int getOperation() const { return effectDef.Operation; }
-		int getModification() const { return effectDef.Modification; }
-		int getLayer() const { return effectDef.Layer; }
-		size_t getTimestamp() const { return timestamp; }
-
-	private:
-		LayeredEffectDefinition effectDef;
-		size_t timestamp;
-	};
+		uint64_t biasedLayer = static_cast<uint32_t>(layer) ^ 0x80000000u;
+		return (biasedLayer << 32) | (uint64_t(timestamp) << OperationBits) | uint64_t(operation);
+	}
+	static int keyLayer(uint64_t key) { return static_cast<int>(static_cast<uint32_t>(key >> 32) ^ 0x80000000u); }
+	static size_t keyTimestamp(uint64_t key) { return static_cast<size_t>((key >> OperationBits) & MaxTimestamp); }
+	static int keyOperation(uint64_t key) { return static_cast<int>(key & OperationMask); }
+	static uint64_t withTimestamp(uint64_t key, size_t timestamp)
+	{
+		return (key & ~(uint64_t(MaxTimestamp) << OperationBits)) | (uint64_t(timestamp) << OperationBits);
+	}
 
-	struct EffectComparator
+	// One attribute's effects in key order: the keys and, in a parallel array,
+	// their modifications. Allocator-aware, so both arrays get the map's
+	// resource when operator[] creates a stack and spill into it.
+	struct EffectStack
 	{
-		bool operator()(const Effect& a, const Effect& b) const
+		using allocator_type = std::pmr::polymorphic_allocator<uint64_t>;
+		explicit EffectStack(const allocator_type& allocator) : keys(allocator), modifications(allocator) {}
+		EffectStack(const EffectStack& other, const allocator_type& allocator)
+			: keys(other.keys, allocator), modifications(other.modifications, allocator), epoch(other.epoch) {}
+		EffectStack(EffectStack&& other, const allocator_type& allocator)
+			: keys(std::move(other.keys), allocator), modifications(std::move(other.modifications), allocator), epoch(other.epoch) {}
+		size_t size() const { return keys.size(); }
+		bool empty() const { return keys.empty(); }
+		void clear()
 		{
-			if (a.getLayer() != b.getLayer())
-			{
-				return a.getLayer() < b.getLayer();
-			}
-			return a.getTimestamp() < b.getTimestamp();
+			keys.clear();
+			modifications.clear();
 		}
+		SmallVector<uint64_t, InlineEffects> keys;
+		SmallVector<int, InlineEffects> modifications;
+		size_t epoch = 0;
+	};
+
+	struct CachedValue
+	{
+		int value = 0;
+		size_t epoch = 0;
 	};
 
-	mutable std::unordered_map<AttributeKey, int> baseAttributes;
-	mutable std::unordered_map<AttributeKey, std::vector<Effect>> effects;
-	mutable std::unordered_map<AttributeKey, bool> attributeDirty;
-	mutable std::unordered_map<AttributeKey, int> cache;
+	mutable std::pmr::unordered_map<AttributeKey, int> baseAttributes;
+	mutable std::pmr::unordered_map<AttributeKey, EffectStack> effects;
+	mutable std::pmr::unordered_map<AttributeKey, bool> attributeDirty;
+	mutable std::pmr::unordered_map<AttributeKey, CachedValue> cache;
+#if defined(LAYERED_ATTRIBUTES_STATS)
+	mutable AttributeStatsCounters stats;
+#endif
 
+	EffectStack& currentEffects(AttributeKey attribute) const;
 	int calculateAttribute(AttributeKey attribute) const;
-	void updateAttribute(const Effect& effect, int& result) const;
-	bool updateIncrementally(const Effect& effect);
+	void updateAttribute(int operation, int modification, int& result) const;
+	bool updateIncrementally(EffectStack& stack, uint64_t key, int modification);
 
 	bool isValidAttributeKey(AttributeKey attribute) const;
 	void logError(AttributeKey attribute) const;
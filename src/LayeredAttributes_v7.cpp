@@ -0,0 +1,814 @@
+#include "LayeredAttributes_v7.hpp"
+#include "Timeline.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+LayeredAttributes_v7::LayeredAttributes_v7(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
+{
+	baseAttributes.fill(0);
+	cache.fill(0);
+	attributeDirty.reset();
+	recalculateFrom.fill(0);
+	store = std::make_shared<EffectStore>();
+	store->effects.reserve(this->reservationSize);
+}
+
+//Set the base value for an attribute on this object. All base values
+//default to 0 until set. Note that resetting a base attribute does not
+//alter any existing layered effects.
+void LayeredAttributes_v7::SetBaseAttribute(AttributeKey attribute, int value)
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		return;
+	}
+	record(JournalEntry::BaseChanged, attribute, 0, baseAttributes[attribute]);
+	baseAttributes[attribute] = value;
+	if (store->runOffsets[attribute] == store->runOffsets[attribute + 1])
+	{
+		// no effects, so the current value is the base value
+		cache[attribute] = value;
+		attributeDirty[attribute] = false;
+	}
+	else
+	{
+		markBaseChanged(attribute);
+	}
+	publishChanges();
+}
+
+//Return the current value for an attribute on this object. Will
+//be equal to the base value, modified by any applicable layered
+//effects.
+int LayeredAttributes_v7::GetCurrentAttribute(AttributeKey attribute) const
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		return std::numeric_limits<int>::min();
+	}
+	ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Reads));
+	if (concurrentReads)
+	{
+		// the writer keeps the published values up to date
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_CacheHits));
+		return published[attribute].value.load(std::memory_order_acquire);
+	}
+	if (!pendingEffects.empty())
+	{
+		// merging buffered effects changes no observable value, and an object
+		// with buffered effects cannot have been declared const
+		const_cast<LayeredAttributes_v7*>(this)->flushPendingEffects();
+	}
+	if (attributeDirty[attribute])
+	{
+		cache[attribute] = calculateAttribute(attribute);
+		attributeDirty[attribute] = false;
+	}
+	else
+	{
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_CacheHits));
+	}
+	return cache[attribute];
+}
+
+//Applies a new layered effect to this object's attributes. See
+//LayeredEffectDefinition for details on how layered effects are
+//applied. Note that any number of layered effects may be applied
+//at any given time. Also note that layered effects are not necessarily
+//applied in the same order they were added. (see LayeredEffectDefinition.Layer)
+void LayeredAttributes_v7::AddLayeredEffect(LayeredEffectDefinition effectDef)
+{
+	if (attributeInBounds(effectDef.Attribute) == false)
+	{
+		return;
+	}
+	ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Adds));
+	TIMELINE_SPAN("LayeredAttributes_v7::AddLayeredEffect", reinterpret_cast<uintptr_t>(this), effectDef.Attribute);
+	if (writeCombining && !concurrentReads && !journaling)
+	{
+		pendingEffects.push_back({ effectDef.Attribute, Effect(effectDef, getNextTimestamp()) });
+		return;
+	}
+	flushPendingEffects();
+	addEffect(effectDef.Attribute, Effect(effectDef, getNextTimestamp()));
+	publishChanges();
+}
+
+//Removes all layered effects from this object. After this call,
+//all current attributes will be equal to the base attributes.
+void LayeredAttributes_v7::ClearLayeredEffects()
+{
+	TIMELINE_SPAN("LayeredAttributes_v7::ClearLayeredEffects", reinterpret_cast<uintptr_t>(this));
+	if (journaling)
+	{
+		record(JournalEntry::EffectsCleared, AttributeKey_NotAssessed, static_cast<uint32_t>(clearedStates.size()));
+		clearedStates.push_back({ store, cache, attributeDirty, recalculateFrom });
+	}
+	if (store.use_count() > 1)
+	{
+		// leave the shared buffer to the forks, but keep the handle generations
+		// so that handles taken before the fork stay stale here
+		auto fresh = std::make_shared<EffectStore>();
+		fresh->effects.reserve(reservationSize);
+		fresh->handleSlots = store->handleSlots;
+		fresh->freeHandleSlots = store->freeHandleSlots;
+		store = std::move(fresh);
+	}
+	// clear() keeps the capacity for the next turn
+	store->effects.clear();
+	pendingEffects.clear();
+	store->runOffsets.fill(0);
+	store->tombstoneCount = 0;
+	for (auto& program : store->programs)
+	{
+		program.clear();
+	}
+	for (uint32_t slot = 0; slot < store->handleSlots.size(); ++slot)
+	{
+		if (store->handleSlots[slot].live)
+		{
+			releaseHandleSlot(slot);
+		}
+	}
+	cache = baseAttributes;
+	attributeDirty.reset();
+	recalculateFrom.fill(0);
+	publishChanges();
+}
+
+// Same as AddLayeredEffect, but the effect is kept separate from its
+// neighbours so that it can later be removed through the returned handle.
+// Returns a default (invalid) handle if the attribute is out of range.
+LayeredAttributes_v7::EffectHandle LayeredAttributes_v7::AddLayeredEffectWithHandle(LayeredEffectDefinition effectDef)
+{
+	if (attributeInBounds(effectDef.Attribute) == false)
+	{
+		return EffectHandle();
+	}
+	ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Adds));
+	flushPendingEffects();
+	auto effect = Effect(effectDef, getNextTimestamp(), /*tracked*/true);
+	addEffect(effectDef.Attribute, effect);
+	publishChanges();
+	return acquireHandleSlot(effectDef.Attribute, effect);
+}
+
+// Removes a single effect in O(log n): the effect is found by binary search
+// and left behind as a tombstone, and tombstones are compacted once they make
+// up half of the buffer. Only the affected attribute is invalidated.
+// Returns false if the handle is stale or was never valid.
+bool LayeredAttributes_v7::RemoveLayeredEffect(EffectHandle handle)
+{
+	if (handle.slot >= store->handleSlots.size())
+	{
+		return false;
+	}
+	// copied, ownStore() may replace the buffer it lives in
+	const HandleSlot slot = store->handleSlots[handle.slot];
+	if (!slot.live || slot.generation != handle.generation)
+	{
+		return false;
+	}
+	EffectStore& s = ownStore();
+	auto& effects = s.effects;
+	auto& runOffsets = s.runOffsets;
+	AttributeKey attribute = slot.attribute;
+	auto first = effects.begin() + runOffsets[attribute];
+	auto last = effects.begin() + runOffsets[attribute + 1];
+	auto it = std::lower_bound(first, last, slot,
+		[](const Effect& effect, const HandleSlot& target)
+		{
+			if (effect.getLayer() != target.layer)
+			{
+				return effect.getLayer() < target.layer;
+			}
+			return effect.getTimestamp() < target.timestamp;
+		});
+	// an effect defined with EffectOperation_Invalid may already have been compacted away
+	if (it != last && it->getTimestamp() == slot.timestamp && !it->isRemoved())
+	{
+		record(JournalEntry::EffectRemoved, attribute, static_cast<uint32_t>(it - effects.begin()), it->getOperation());
+		it->markRemoved();
+		++s.tombstoneCount;
+		markDirty(attribute, static_cast<uint32_t>(it - first));
+	}
+	record(JournalEntry::HandleReleased, attribute, handle.slot);
+	releaseHandleSlot(handle.slot);
+	// compaction would move journaled positions
+	if (s.tombstoneCount * 2 > effects.size() && !journaling)
+	{
+		compactEffects();
+	}
+	publishChanges();
+	return true;
+}
+
+void LayeredAttributes_v7::AddLayeredEffects(const LayeredEffectDefinition* effectDefs, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (attributeInBounds(effectDefs[i].Attribute))
+		{
+			ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Adds));
+			pendingEffects.push_back({ effectDefs[i].Attribute, Effect(effectDefs[i], getNextTimestamp()) });
+		}
+	}
+	if (!writeCombining || concurrentReads || journaling)
+	{
+		flushPendingEffects();
+	}
+	publishChanges();
+}
+
+void LayeredAttributes_v7::SetWriteCombining(bool enabled)
+{
+	writeCombining = enabled;
+	if (!writeCombining)
+	{
+		flushPendingEffects();
+	}
+}
+
+void LayeredAttributes_v7::SetConcurrentReads(bool enabled)
+{
+	concurrentReads = enabled;
+	publishChanges();
+}
+
+LayeredAttributes_v7::UndoMarker LayeredAttributes_v7::Checkpoint()
+{
+	// buffered effects belong to the state being marked
+	flushPendingEffects();
+	journaling = true;
+	return { journal.size(), nextTimestamp };
+}
+
+bool LayeredAttributes_v7::RollbackTo(UndoMarker marker)
+{
+	if (!journaling || marker.journalSize > journal.size())
+	{
+		return false;
+	}
+	while (journal.size() > marker.journalSize)
+	{
+		undo(journal.back());
+		journal.pop_back();
+	}
+	nextTimestamp = marker.timestamp;
+	publishChanges();
+	return true;
+}
+
+AttributeStats LayeredAttributes_v7::GetStats() const
+{
+#if defined(LAYERED_ATTRIBUTES_STATS)
+	return stats.snapshot();
+#else
+	return AttributeStats();
+#endif
+}
+
+void LayeredAttributes_v7::ResetStats()
+{
+	ATTRIBUTE_STATS(stats.reset());
+}
+
+void LayeredAttributes_v7::ReleaseCheckpoints()
+{
+	journaling = false;
+	journal.clear();
+	clearedStates.clear();
+	if (store->tombstoneCount * 2 > store->effects.size())
+	{
+		ownStore();
+		compactEffects();
+	}
+}
+
+// In concurrent-read mode, brings every attribute up to date and publishes it.
+// Release stores pair with the acquire loads in GetCurrentAttribute.
+void LayeredAttributes_v7::publishChanges()
+{
+	if (!concurrentReads)
+	{
+		return;
+	}
+	flushPendingEffects();
+	for (size_t a = 0; a < NumAttributes; ++a)
+	{
+		AttributeKey attribute = AttributeKey(a);
+		if (attributeDirty[attribute])
+		{
+			cache[attribute] = calculateAttribute(attribute);
+			attributeDirty[attribute] = false;
+		}
+		published[attribute].value.store(cache[attribute], std::memory_order_release);
+	}
+}
+
+bool LayeredAttributes_v7::attributeInBounds(AttributeKey attribute) const
+{
+	bool outOfBounds = attribute < 0 || attribute >= static_cast<int>(NumAttributes);
+	if (outOfBounds && errorLoggingEnabled)
+	{
+		logError(attribute);
+	}
+	if (outOfBounds && errorHandlingEnabled)
+	{
+		throw std::out_of_range("Attribute out of range");
+	}
+	return !outOfBounds;
+}
+
+void LayeredAttributes_v7::logError([[maybe_unused]] AttributeKey attribute) const
+{
+	// Imagine that this method writes something useful to glog or similar logging service
+}
+
+// Copies the effect buffer if a fork still shares it. Everything that changes
+// the buffer calls this first; the private helpers below assume it was called.
+LayeredAttributes_v7::EffectStore& LayeredAttributes_v7::ownStore()
+{
+	if (store.use_count() > 1)
+	{
+		TIMELINE_SPAN("LayeredAttributes_v7::ownStore copy", reinterpret_cast<uintptr_t>(this));
+		auto copy = std::make_shared<EffectStore>();
+		// room for the change that caused the copy, so it does not reallocate again
+		copy->effects.reserve(store->effects.size() + reservationSize);
+		copy->effects.assign(store->effects.begin(), store->effects.end());
+		copy->runOffsets = store->runOffsets;
+		copy->handleSlots = store->handleSlots;
+		copy->freeHandleSlots = store->freeHandleSlots;
+		copy->tombstoneCount = store->tombstoneCount;
+		store = std::move(copy);
+	}
+	return *store;
+}
+
+// Resumes from the value cached in front of the first stale effect, so a change
+// in a late layer never replays the layers below it. When the whole run would
+// be replayed, its compiled program is run instead, if there is one.
+int LayeredAttributes_v7::calculateAttribute(AttributeKey attribute) const
+{
+	TIMELINE_SPAN("LayeredAttributes_v7::calculateAttribute", reinterpret_cast<uintptr_t>(this), attribute);
+	const auto& effects = store->effects;
+	uint32_t runBegin = store->runOffsets[attribute];
+	uint32_t runEnd = store->runOffsets[attribute + 1];
+	auto& program = store->programs[attribute];
+	if (recalculateFrom[attribute] == 0 && !program.empty())
+	{
+		// the cached prefix values stay stale, recalculateFrom still says so
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_ProgramRuns));
+		ATTRIBUTE_STATS(stats.recomputed(EffectProgram::Length(program.data())));
+		return EffectProgram::Run(program.data(), baseAttributes[attribute]);
+	}
+	uint32_t position = runBegin + recalculateFrom[attribute];
+	int result = position == runBegin ? baseAttributes[attribute] : effects[position - 1].getValueAfter();
+	ATTRIBUTE_STATS(stats.recomputed(runEnd - position));
+	// the cached values in a shared buffer belong to every fork, so they are
+	// only written while this object is the sole owner
+	if (store.use_count() > 1)
+	{
+		for (; position < runEnd; ++position)
+		{
+			updateAttribute(effects[position], result);
+		}
+		return result;
+	}
+	if (position == runBegin && compileOnReplay[attribute])
+	{
+		compileOnReplay[attribute] = false;
+		EffectProgram::Builder builder(program);
+		for (; position < runEnd; ++position)
+		{
+			updateAttribute(effects[position], result);
+			effects[position].setValueAfter(result);
+			builder.append(effects[position].getOperation(), effects[position].getModification());
+		}
+		builder.finish();
+	}
+	for (; position < runEnd; ++position)
+	{
+		updateAttribute(effects[position], result);
+		effects[position].setValueAfter(result);
+	}
+	recalculateFrom[attribute] = runEnd - runBegin;
+	return result;
+}
+
+void LayeredAttributes_v7::updateAttribute(const Effect& effect, int& result) const
+{
+	if (effect.getOperation() == EffectOperation_Set)
+	{
+		result = effect.getModification();
+	}
+	else if (effect.getOperation() == EffectOperation_Add)
+	{
+		result += effect.getModification();
+	}
+	else if (effect.getOperation() == EffectOperation_Subtract)
+	{
+		result -= effect.getModification();
+	}
+	else if (effect.getOperation() == EffectOperation_Multiply)
+	{
+		result *= effect.getModification();
+	}
+	else if (effect.getOperation() == EffectOperation_BitwiseOr)
+	{
+		result |= effect.getModification();
+	}
+	else if (effect.getOperation() == EffectOperation_BitwiseAnd)
+	{
+		result &= effect.getModification();
+	}
+	else if (effect.getOperation() == EffectOperation_BitwiseXor)
+	{
+		result ^= effect.getModification();
+	}
+	else
+	{
+		// do nothing
+	}
+}
+
+// Positions are relative to the start of the attribute's run. The run has
+// changed, so its compiled program is dropped as well.
+void LayeredAttributes_v7::markDirty(AttributeKey attribute, uint32_t position) const
+{
+	recalculateFrom[attribute] = std::min(recalculateFrom[attribute], position);
+	attributeDirty[attribute] = true;
+	store->programs[attribute].clear();
+}
+
+// Every cached prefix value depends on the base value, but the compiled program
+// does not. Base values that change once tend to change again, so the next full
+// replay compiles the run.
+void LayeredAttributes_v7::markBaseChanged(AttributeKey attribute) const
+{
+	recalculateFrom[attribute] = 0;
+	attributeDirty[attribute] = true;
+	compileOnReplay[attribute] = true;
+}
+
+// Merges the effect into the last effect of the attribute's run or appends
+// it to the end of the run. Returns false if the effect belongs somewhere
+// before the end of the run, in which case nothing was stored.
+bool LayeredAttributes_v7::updateIncrementally(AttributeKey attribute, const Effect& effect)
+{
+	auto& effects = store->effects;
+	const auto& runOffsets = store->runOffsets;
+	uint32_t runEnd = runOffsets[attribute + 1];
+	if (runOffsets[attribute] == runEnd)
+	{
+		insertEffect(attribute, effect);
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Appends));
+		return true;
+	}
+	auto& oldEffect = effects[runEnd - 1];
+	if (oldEffect.getLayer() > effect.getLayer())
+	{
+		return false;
+	}
+	auto operation = effect.getOperation();
+	bool isMergeable = !oldEffect.isTracked() && !effect.isTracked() && operation != EffectOperation_BitwiseXor;
+	if (isMergeable && oldEffect.getLayer() == effect.getLayer() && oldEffect.getOperation() == operation)
+	{
+		record(JournalEntry::EffectMerged, attribute, runEnd - 1, oldEffect.getModification());
+		int updatedModification = oldEffect.getModification();
+		if (operation == EffectOperation_Set)
+		{
+			updatedModification = effect.getModification();
+		}
+		else if (operation == EffectOperation_Add || operation == EffectOperation_Subtract)
+		{
+			updatedModification += effect.getModification();
+		}
+		else if (operation == EffectOperation_Multiply)
+		{
+			updatedModification *= effect.getModification();
+		}
+		else if (operation == EffectOperation_BitwiseOr)
+		{
+			updatedModification |= effect.getModification();
+		}
+		else if (operation == EffectOperation_BitwiseAnd)
+		{
+			updatedModification &= effect.getModification();
+		}
+		else
+		{
+		}
+		oldEffect.updateModification(updatedModification);
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Merges));
+	}
+	else
+	{
+		insertEffect(attribute, effect);
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Appends));
+	}
+	return true;
+}
+
+// Returns the position of the new effect within the attribute's run.
+uint32_t LayeredAttributes_v7::insertEffect(AttributeKey attribute, const Effect& effect)
+{
+	auto& effects = store->effects;
+	auto& runOffsets = store->runOffsets;
+	if (effects.size() + 1 > effects.capacity())
+	{
+		// grow geometrically so long stacks stay amortized O(1) per append
+		effects.reserve(effects.size() + std::max(reservationSize, effects.size()));
+	}
+	auto first = effects.begin() + runOffsets[attribute];
+	auto last = effects.begin() + runOffsets[attribute + 1];
+	// the new effect has the newest timestamp, so it goes after every effect in the same layer
+	auto it = std::upper_bound(first, last, effect.getLayer(),
+		[](int layer, const Effect& other) { return layer < other.getLayer(); });
+	uint32_t position = static_cast<uint32_t>(it - first);
+	record(JournalEntry::EffectInserted, attribute, static_cast<uint32_t>(it - effects.begin()));
+	effects.insert(it, effect);
+	for (size_t a = attribute + 1; a <= NumAttributes; ++a)
+	{
+		++runOffsets[a];
+	}
+	return position;
+}
+
+void LayeredAttributes_v7::addEffect(AttributeKey attribute, const Effect& effect)
+{
+	EffectStore& s = ownStore();
+	s.programs[attribute].clear();
+	if (updateIncrementally(attribute, effect))
+	{
+		// the effect was appended to or merged into the last effect of the run
+		uint32_t last = s.runOffsets[attribute + 1] - 1 - s.runOffsets[attribute];
+		if (attributeDirty[attribute])
+		{
+			markDirty(attribute, last);
+		}
+		else
+		{
+			updateAttribute(effect, cache[attribute]);
+			s.effects[s.runOffsets[attribute] + last].setValueAfter(cache[attribute]);
+			if (recalculateFrom[attribute] >= last)
+			{
+				recalculateFrom[attribute] = last + 1;
+			}
+		}
+	}
+	else
+	{
+		markDirty(attribute, insertEffect(attribute, effect));
+		ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_Inserts));
+	}
+	ATTRIBUTE_STATS(stats.added(s.runOffsets[attribute + 1] - s.runOffsets[attribute]));
+}
+
+// Sorts the pending effects once and merges them into every run, walking the
+// buffer from the back so each existing effect moves at most once and no
+// scratch buffer is needed. Pending effects are newer than every stored
+// effect, so they go after stored effects of the same layer.
+void LayeredAttributes_v7::flushPendingEffects()
+{
+	if (pendingEffects.empty())
+	{
+		return;
+	}
+	if (journaling)
+	{
+		// one journaled insert or merge per effect; pending effects are kept in
+		// timestamp order, so adding them one by one gives the same result
+		for (const auto& pending : pendingEffects)
+		{
+			addEffect(pending.attribute, pending.effect);
+		}
+		pendingEffects.clear();
+		return;
+	}
+	ATTRIBUTE_STATS(stats.count(AttributeStatsCounters::Counter_BatchedAdds, pendingEffects.size()));
+	TIMELINE_SPAN("LayeredAttributes_v7::flushPendingEffects", reinterpret_cast<uintptr_t>(this));
+	EffectStore& s = ownStore();
+	auto& effects = s.effects;
+	auto& runOffsets = s.runOffsets;
+	std::sort(pendingEffects.begin(), pendingEffects.end(),
+		[](const PendingEffect& a, const PendingEffect& b)
+		{
+			if (a.attribute != b.attribute)
+			{
+				return a.attribute < b.attribute;
+			}
+			if (a.effect.getLayer() != b.effect.getLayer())
+			{
+				return a.effect.getLayer() < b.effect.getLayer();
+			}
+			return a.effect.getTimestamp() < b.effect.getTimestamp();
+		});
+	// pendingOffsets[a] is the number of pending effects for attributes before a
+	std::array<uint32_t, NumAttributes + 1> pendingOffsets{};
+	for (const auto& pending : pendingEffects)
+	{
+		++pendingOffsets[pending.attribute + 1];
+	}
+	for (size_t a = 0; a < NumAttributes; ++a)
+	{
+		pendingOffsets[a + 1] += pendingOffsets[a];
+	}
+
+	size_t oldSize = effects.size();
+	size_t newSize = oldSize + pendingEffects.size();
+	if (newSize > effects.capacity())
+	{
+		effects.reserve(std::max(newSize, oldSize + std::max(reservationSize, oldSize)));
+	}
+	// placeholders, every one of them is overwritten by the merge below
+	effects.insert(effects.end(), pendingEffects.size(), pendingEffects.front().effect);
+
+	for (size_t a = NumAttributes; a-- > 0;)
+	{
+		uint32_t oldBegin = runOffsets[a];
+		uint32_t read = runOffsets[a + 1];
+		uint32_t pendingBegin = pendingOffsets[a];
+		uint32_t pendingRead = pendingOffsets[a + 1];
+		uint32_t write = read + pendingRead;
+		runOffsets[a + 1] = write;
+		if (pendingRead == pendingBegin)
+		{
+			if (pendingBegin != 0)
+			{
+				std::move_backward(effects.begin() + oldBegin, effects.begin() + read, effects.begin() + write);
+			}
+			continue;
+		}
+		while (pendingRead > pendingBegin)
+		{
+			const Effect& incoming = pendingEffects[pendingRead - 1].effect;
+			if (read > oldBegin && effects[read - 1].getLayer() > incoming.getLayer())
+			{
+				effects[--write] = effects[--read];
+			}
+			else
+			{
+				effects[--write] = incoming;
+				--pendingRead;
+			}
+		}
+		// write now points at the earliest merged effect
+		markDirty(AttributeKey(a), write - (oldBegin + pendingBegin));
+		ATTRIBUTE_STATS(stats.added(runOffsets[a + 1] - (oldBegin + pendingBegin)));
+		if (pendingBegin != 0)
+		{
+			std::move_backward(effects.begin() + oldBegin, effects.begin() + read, effects.begin() + write);
+		}
+	}
+	pendingEffects.clear();
+}
+
+LayeredAttributes_v7::EffectHandle LayeredAttributes_v7::acquireHandleSlot(AttributeKey attribute, const Effect& effect)
+{
+	auto& handleSlots = store->handleSlots;
+	auto& freeHandleSlots = store->freeHandleSlots;
+	uint32_t slot;
+	if (freeHandleSlots.empty())
+	{
+		slot = static_cast<uint32_t>(handleSlots.size());
+		handleSlots.emplace_back();
+		record(JournalEntry::HandleAdded, attribute, slot);
+	}
+	else
+	{
+		slot = freeHandleSlots.back();
+		freeHandleSlots.pop_back();
+		record(JournalEntry::HandleAcquired, attribute, slot, static_cast<int>(handleSlots[slot].generation));
+	}
+	HandleSlot& handleSlot = handleSlots[slot];
+	handleSlot.live = true;
+	handleSlot.generation = nextHandleGeneration++;
+	handleSlot.attribute = attribute;
+	handleSlot.layer = effect.getLayer();
+	handleSlot.timestamp = effect.getTimestamp();
+	return { slot, handleSlot.generation };
+}
+
+void LayeredAttributes_v7::releaseHandleSlot(uint32_t slot)
+{
+	// the next acquire of the slot issues a new generation
+	store->handleSlots[slot].live = false;
+	store->freeHandleSlots.push_back(slot);
+}
+
+void LayeredAttributes_v7::compactEffects()
+{
+	TIMELINE_SPAN("LayeredAttributes_v7::compactEffects", reinterpret_cast<uintptr_t>(this));
+	auto& effects = store->effects;
+	auto& runOffsets = store->runOffsets;
+	uint32_t write = 0;
+	for (size_t attribute = 0; attribute < NumAttributes; ++attribute)
+	{
+		uint32_t runBegin = runOffsets[attribute];
+		uint32_t runEnd = runOffsets[attribute + 1];
+		runOffsets[attribute] = write;
+		// tombstones pass their input through unchanged, so the cached values of
+		// the survivors stay valid and only the stale position has to move
+		uint32_t stale = runBegin + recalculateFrom[attribute];
+		for (uint32_t read = runBegin; read < runEnd; ++read)
+		{
+			if (read == stale)
+			{
+				recalculateFrom[attribute] = write - runOffsets[attribute];
+			}
+			if (!effects[read].isRemoved())
+			{
+				effects[write++] = effects[read];
+			}
+		}
+		if (stale == runEnd)
+		{
+			recalculateFrom[attribute] = write - runOffsets[attribute];
+		}
+	}
+	runOffsets[NumAttributes] = write;
+	effects.erase(effects.begin() + write, effects.end());
+	store->tombstoneCount = 0;
+}
+
+void LayeredAttributes_v7::record(JournalEntry::Kind kind, AttributeKey attribute, uint32_t index, int oldValue)
+{
+	if (journaling)
+	{
+		journal.push_back({ kind, static_cast<uint8_t>(attribute), index, oldValue });
+	}
+}
+
+// Reverses one journal entry. Entries are undone newest first, so the buffer
+// looks exactly as it did right after the change being undone.
+void LayeredAttributes_v7::undo(const JournalEntry& entry)
+{
+	AttributeKey attribute = AttributeKey(entry.attribute);
+	if (entry.kind == JournalEntry::EffectsCleared)
+	{
+		ClearedState& cleared = clearedStates[entry.index];
+		store = std::move(cleared.store);
+		cache = cleared.cache;
+		attributeDirty = cleared.attributeDirty;
+		recalculateFrom = cleared.recalculateFrom;
+		clearedStates.pop_back();
+		return;
+	}
+	EffectStore& s = ownStore();
+	uint32_t runBegin = s.runOffsets[attribute];
+	switch (entry.kind)
+	{
+	case JournalEntry::BaseChanged:
+		baseAttributes[attribute] = entry.oldValue;
+		if (runBegin == s.runOffsets[attribute + 1])
+		{
+			cache[attribute] = entry.oldValue;
+			attributeDirty[attribute] = false;
+		}
+		else
+		{
+			markBaseChanged(attribute);
+		}
+		break;
+	case JournalEntry::EffectInserted:
+		s.effects.erase(s.effects.begin() + entry.index);
+		for (size_t a = attribute + 1; a <= NumAttributes; ++a)
+		{
+			--s.runOffsets[a];
+		}
+		markDirty(attribute, entry.index - runBegin);
+		break;
+	case JournalEntry::EffectMerged:
+		s.effects[entry.index].updateModification(entry.oldValue);
+		markDirty(attribute, entry.index - runBegin);
+		break;
+	case JournalEntry::EffectRemoved:
+		s.effects[entry.index].restoreOperation(entry.oldValue);
+		--s.tombstoneCount;
+		markDirty(attribute, entry.index - runBegin);
+		break;
+	case JournalEntry::HandleAdded:
+		s.handleSlots.pop_back();
+		break;
+	case JournalEntry::HandleAcquired:
+		// the undone handle's generation is never issued again, so it stays
+		// stale; the slot gets back the generation of the handle it held
+		// before, which a removal undone next revives
+		s.handleSlots[entry.index].live = false;
+		s.handleSlots[entry.index].generation = static_cast<uint32_t>(entry.oldValue);
+		s.freeHandleSlots.push_back(entry.index);
+		break;
+	case JournalEntry::HandleReleased:
+		// every later acquire has been undone, so the slot is back on top of the free list
+		s.freeHandleSlots.pop_back();
+		// the slot still holds its generation, so the removed handle works again
+		s.handleSlots[entry.index].live = true;
+		break;
+	default:
+		break;
+	}
+}
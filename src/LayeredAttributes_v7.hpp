@@ -0,0 +1,269 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include "EffectProgram.hpp"
+#include "AttributeStats.hpp"
+#include <vector>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// Dense, hash-free storage engine.
+// AttributeKey is a small dense enum, so every per-attribute container is a
+// fixed array indexed by key, dirty state is a bitset, and all effects for
+// this object live in one contiguous buffer split into one sorted run per
+// attribute. A read is an array index plus a bit test in the common case.
+// The effect buffer is shared copy-on-write between copies of an object, so
+// copying (or Fork()) is O(1) in the number of effects.
+class LayeredAttributes_v7 : public ILayeredAttributes
+{
+public:
+	LayeredAttributes_v7(bool errorLoggingEnabled = false, bool errorHandlingEnabled = false, size_t rereservationSize = 10ULL);
+	virtual ~LayeredAttributes_v7() = default;
+	void SetBaseAttribute(AttributeKey attribute, int value) override;
+	int GetCurrentAttribute(AttributeKey attribute) const override;
+	void AddLayeredEffect(LayeredEffectDefinition effect) override;
+	void ClearLayeredEffects() override;
+
+	// Identifies one effect added through AddLayeredEffectWithHandle.
+	// A handle goes stale once its effect is removed or cleared, even if
+	// the slot it refers to is reused later.
+	struct EffectHandle
+	{
+		uint32_t slot = std::numeric_limits<uint32_t>::max();
+		uint32_t generation = 0;
+	};
+
+	EffectHandle AddLayeredEffectWithHandle(LayeredEffectDefinition effect);
+	bool RemoveLayeredEffect(EffectHandle handle);
+
+	// Adds many effects at once; equivalent to calling AddLayeredEffect for
+	// each definition in order, but the batch is sorted once and merged into
+	// every attribute's run in a single linear pass.
+	void AddLayeredEffects(const LayeredEffectDefinition* effectDefs, size_t count);
+	void AddLayeredEffects(const std::vector<LayeredEffectDefinition>& effectDefs) { AddLayeredEffects(effectDefs.data(), effectDefs.size()); }
+
+	// While enabled, AddLayeredEffect only buffers the effect; buffered effects
+	// are merged as one batch by the next read or by any other call that needs
+	// the effect buffer. Disabling write combining flushes the buffer.
+	void SetWriteCombining(bool enabled);
+
+	// While enabled, every change is recalculated and published by the
+	// writer, and GetCurrentAttribute is a single atomic load that never
+	// touches the cache. Any number of threads may then read while one thread
+	// writes; readers never block each other or the writer. Write combining
+	// is suspended in this mode. Toggle it only while no other thread reads.
+	void SetConcurrentReads(bool enabled);
+
+	// Returns an independent copy that shares the effect buffer with this
+	// object until either of them changes its effects; only then is the buffer
+	// copied. Base values and cached current values are copied outright (a
+	// few hundred bytes). Handles taken before the fork are valid in both.
+	LayeredAttributes_v7 Fork() const { return *this; }
+
+	// Marks a point that RollbackTo can return to.
+	struct UndoMarker
+	{
+		size_t journalSize = 0;
+		size_t timestamp = 0;
+	};
+
+	// Starts (or continues) journaling every change and returns a marker for
+	// the current state. RollbackTo(marker) undoes everything since, in time
+	// proportional to the number of changes, and leaves the marker usable for
+	// the next branch; markers taken after it must not be used again. Handles removed
+	// after the marker work again; handles issued after it are stale once it
+	// is rolled back to, even if their slot is reused. Returns false for a
+	// marker that is no longer valid.
+	UndoMarker Checkpoint();
+	bool RollbackTo(UndoMarker marker);
+	// Stops journaling and invalidates every marker.
+	void ReleaseCheckpoints();
+
+	// Hot-path counters since construction or the last ResetStats(); all
+	// zeros unless built with LAYERED_ATTRIBUTES_STATS (see AttributeStats.hpp).
+	// Reads in concurrent-read mode count as cache hits; the recalculations
+	// behind them are done by the writer and counted as recomputes.
+	AttributeStats GetStats() const;
+	void ResetStats();
+
+private:
+	bool errorLoggingEnabled;
+	bool errorHandlingEnabled;
+	size_t reservationSize;
+
+	static const size_t NumAttributes = AttributeKey::AttributeKey_Controller + 1;
+
+	size_t nextTimestamp = 0;
+	size_t getNextTimestamp() { return nextTimestamp++; }
+
+	// The attribute is implied by the run an effect is stored in,
+	// so it is not stored here.
+	// Removed effects stay in place as tombstones (EffectOperation_Invalid)
+	// until compactEffects() runs, so positions never need to be tracked.
+	// Every effect also caches the attribute value right after it is applied;
+	// the last effect of each layer therefore holds the value entering the next
+	// layer, and a recalculation can resume from any position in the run.
+	class Effect
+	{
+	public:
+		Effect(const LayeredEffectDefinition& effectDef, size_t timestamp, bool tracked = false)
+			: modification(effectDef.Modification), layer(effectDef.Layer), operation(narrowOperation(effectDef.Operation)), tracked(tracked), timestamp(timestamp) {
+		}
+		void updateModification(int updatedModification) { modification = updatedModification; }
+		void markRemoved() { operation = EffectOperation_Invalid; }
+		void restoreOperation(int restoredOperation) { operation = narrowOperation(restoredOperation); }
+		void setValueAfter(int value) const { valueAfter = value; }
+		int getOperation() const { return operation; }
+		int getModification() const { return modification; }
+		int getLayer() const { return layer; }
+		int getValueAfter() const { return valueAfter; }
+		size_t getTimestamp() const { return timestamp; }
+		bool isTracked() const { return tracked; }
+		bool isRemoved() const { return operation == EffectOperation_Invalid; }
+
+	private:
+		// operations outside the enum do nothing, just like EffectOperation_Invalid,
+		// so they are stored as that rather than wrapping into a real operation
+		static uint8_t narrowOperation(int operation)
+		{
+			bool known = operation >= EffectOperation_Invalid && operation <= EffectOperation_BitwiseXor;
+			return static_cast<uint8_t>(known ? operation : EffectOperation_Invalid);
+		}
+
+		int modification;
+		int layer;
+		mutable int valueAfter = 0; // only valid before the attribute's recalculateFrom position
+		uint8_t operation; // narrowed so the cached value fits in the same 24 bytes
+		bool tracked; // tracked effects are never merged so they can be removed individually
+		size_t timestamp;
+	};
+
+	std::array<int, NumAttributes> baseAttributes;
+	mutable std::array<int, NumAttributes> cache;
+	mutable std::bitset<NumAttributes> attributeDirty;
+	// the first position in each run whose cached value (Effect::getValueAfter) may be stale;
+	// equal to the run length once every cached value in the run is valid
+	mutable std::array<uint32_t, NumAttributes> recalculateFrom;
+	// set by a base change, so that the next full replay compiles the run
+	mutable std::bitset<NumAttributes> compileOnReplay;
+
+	// a handle slot remembers where its effect sorts, so lookups are a binary search
+	struct HandleSlot
+	{
+		uint32_t generation = 0;
+		bool live = false;
+		AttributeKey attribute = AttributeKey_NotAssessed;
+		int layer = 0;
+		size_t timestamp = 0;
+	};
+
+	// Everything that grows with the number of effects. Shared between forks
+	// and copied by ownStore() before the first change to it.
+	struct EffectStore
+	{
+		// effects[runOffsets[a], runOffsets[a + 1]) holds the effects of attribute a,
+		// sorted by {layer, timestamp}
+		std::vector<Effect> effects;
+		std::array<uint32_t, NumAttributes + 1> runOffsets{};
+		std::vector<HandleSlot> handleSlots;
+		std::vector<uint32_t> freeHandleSlots;
+		size_t tombstoneCount = 0;
+		// Compiled form of each run (see EffectProgram), built by the first full
+		// recalculation after a base change and emptied whenever the run
+		// changes. A program does not depend on the base value, so after later
+		// base changes the attribute is re-evaluated by running it instead of
+		// replaying the run. Not copied by ownStore(); the copy compiles its
+		// own on demand.
+		std::array<std::vector<EffectProgram::Instruction>, NumAttributes> programs;
+	};
+	std::shared_ptr<EffectStore> store;
+	// generation of the next handle issued. Kept outside the store and the
+	// journal so it only ever increases: a rollback never issues a generation
+	// again, so handles from an abandoned branch stay stale.
+	uint32_t nextHandleGeneration = 0;
+	// effects added but not yet merged into their runs; their timestamps are
+	// already assigned, so everything else that takes a timestamp flushes first
+	struct PendingEffect
+	{
+		AttributeKey attribute;
+		Effect effect;
+	};
+	std::vector<PendingEffect> pendingEffects;
+	bool writeCombining = false;
+
+	// std::atomic is not copyable, this keeps the engine copyable
+	struct PublishedValue
+	{
+		std::atomic<int> value{ 0 };
+		PublishedValue() = default;
+		PublishedValue(const PublishedValue& other) : value(other.value.load(std::memory_order_relaxed)) {}
+		PublishedValue& operator=(const PublishedValue& other)
+		{
+			value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+	};
+	std::array<PublishedValue, NumAttributes> published;
+	bool concurrentReads = false;
+
+	// Undo journal, appended to while any checkpoint is outstanding. Entries
+	// refer to buffer positions, so compaction and the bulk merge are put off
+	// while journaling and every change is a single insert, overwrite or
+	// tombstone that can be reversed in place.
+	struct JournalEntry
+	{
+		enum Kind : uint8_t
+		{
+			BaseChanged,      // index unused, oldValue = previous base value
+			EffectInserted,   // index = buffer position
+			EffectMerged,     // index = buffer position, oldValue = previous modification
+			EffectRemoved,    // index = buffer position, oldValue = previous operation
+			HandleAdded,      // index = handle slot, appended for this acquire
+			HandleAcquired,   // index = handle slot taken from the free list, oldValue = its previous generation
+			HandleReleased,   // index = handle slot
+			EffectsCleared    // index = position in clearedStates
+		};
+		Kind kind;
+		uint8_t attribute;
+		uint32_t index;
+		int oldValue;
+	};
+	// everything ClearLayeredEffects throws away; the store itself is kept
+	// alive by the shared_ptr, so saving it is O(1)
+	struct ClearedState
+	{
+		std::shared_ptr<EffectStore> store;
+		std::array<int, NumAttributes> cache;
+		std::bitset<NumAttributes> attributeDirty;
+		std::array<uint32_t, NumAttributes> recalculateFrom;
+	};
+	std::vector<JournalEntry> journal;
+	std::vector<ClearedState> clearedStates;
+	bool journaling = false;
+
+#if defined(LAYERED_ATTRIBUTES_STATS)
+	mutable AttributeStatsCounters stats;
+#endif
+
+	EffectStore& ownStore();
+	int calculateAttribute(AttributeKey attribute) const;
+	void updateAttribute(const Effect& effect, int& result) const;
+	void markDirty(AttributeKey attribute, uint32_t position) const;
+	void markBaseChanged(AttributeKey attribute) const;
+	bool updateIncrementally(AttributeKey attribute, const Effect& effect);
+	uint32_t insertEffect(AttributeKey attribute, const Effect& effect);
+	void addEffect(AttributeKey attribute, const Effect& effect);
+	void flushPendingEffects();
+	void publishChanges();
+	EffectHandle acquireHandleSlot(AttributeKey attribute, const Effect& effect);
+	void releaseHandleSlot(uint32_t slot);
+	void compactEffects();
+	void record(JournalEntry::Kind kind, AttributeKey attribute, uint32_t index, int oldValue = 0);
+	void undo(const JournalEntry& entry);
+
+	bool attributeInBounds(AttributeKey attribute) const;
+	void logError(AttributeKey attribute) const;
+};
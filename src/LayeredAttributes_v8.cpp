@@ -0,0 +1,181 @@
+#include "LayeredAttributes_v8.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+LayeredAttributes_v8::LayeredAttributes_v8(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
+{
+	roots.fill(NoNode);
+	baseAttributes.fill(0);
+	currentAttributes.fill(0);
+	nodes.reserve(this->reservationSize);
+}
+
+//Set the base value for an attribute on this object. All base values
+//default to 0 until set. Note that resetting a base attribute does not
+//alter any existing layered effects.
+void LayeredAttributes_v8::SetBaseAttribute(AttributeKey attribute, int value)
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		return;
+	}
+	baseAttributes[attribute] = value;
+	currentAttributes[attribute] = evaluate(roots[attribute], value);
+}
+
+//Return the current value for an attribute on this object. Will
+//be equal to the base value, modified by any applicable layered
+//effects.
+int LayeredAttributes_v8::GetCurrentAttribute(AttributeKey attribute) const
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		return std::numeric_limits<int>::min();
+	}
+	return currentAttributes[attribute];
+}
+
+//Applies a new layered effect to this object's attributes. See
+//LayeredEffectDefinition for details on how layered effects are
+//applied. Note that any number of layered effects may be applied
+//at any given time. Also note that layered effects are not necessarily
+//applied in the same order they were added. (see LayeredEffectDefinition.Layer)
+void LayeredAttributes_v8::AddLayeredEffect(LayeredEffectDefinition effectDef)
+{
+	if (attributeInBounds(effectDef.Attribute) == false)
+	{
+		return;
+	}
+	AttributeKey attribute = effectDef.Attribute;
+	Node node;
+	node.layer = effectDef.Layer;
+	node.timestamp = getNextTimestamp();
+	node.transfer = EffectTransfer::fromEffect(effectDef.Operation, effectDef.Modification);
+	node.subtree = ComposedTransfer(node.transfer);
+	node.priority = nextPriority();
+	uint32_t inserted = static_cast<uint32_t>(nodes.size());
+	nodes.push_back(node);
+
+	// the new effect has the newest timestamp, so it goes after every effect in the same layer
+	uint32_t left, right;
+	split(roots[attribute], effectDef.Layer, left, right);
+	roots[attribute] = merge(merge(left, inserted), right);
+	currentAttributes[attribute] = evaluate(roots[attribute], baseAttributes[attribute]);
+}
+
+//Removes all layered effects from this object. After this call,
+//all current attributes will be equal to the base attributes.
+void LayeredAttributes_v8::ClearLayeredEffects()
+{
+	nodes.clear();
+	roots.fill(NoNode);
+	currentAttributes = baseAttributes;
+}
+
+bool LayeredAttributes_v8::attributeInBounds(AttributeKey attribute) const
+{
+	bool outOfBounds = attribute < 0 || attribute >= static_cast<int>(NumAttributes);
+	if (outOfBounds && errorLoggingEnabled)
+	{
+		logError(attribute);
+	}
+	if (outOfBounds && errorHandlingEnabled)
+	{
+		throw std::out_of_range("Attribute out of range");
+	}
+	return !outOfBounds;
+}
+
+void LayeredAttributes_v8::logError([[maybe_unused]] AttributeKey attribute) const
+{
+	// Imagine that this method writes something useful to glog or similar logging service
+}
+
+uint32_t LayeredAttributes_v8::nextPriority()
+{
+	// xorshift32 keeps the treap shape deterministic for a given call sequence
+	prioritySeed ^= prioritySeed << 13;
+	prioritySeed ^= prioritySeed >> 17;
+	prioritySeed ^= prioritySeed << 5;
+	return prioritySeed;
+}
+
+void LayeredAttributes_v8::updateNode(uint32_t node)
+{
+	Node& current = nodes[node];
+	ComposedTransfer subtree;
+	if (current.left != NoNode)
+	{
+		subtree = nodes[current.left].subtree;
+	}
+	subtree.append(current.transfer);
+	if (current.right != NoNode)
+	{
+		subtree.append(nodes[current.right].subtree);
+	}
+	current.subtree = subtree;
+}
+
+// Splits the treap into effects with a layer <= the given layer and the rest.
+void LayeredAttributes_v8::split(uint32_t node, int layer, uint32_t& left, uint32_t& right)
+{
+	if (node == NoNode)
+	{
+		left = NoNode;
+		right = NoNode;
+		return;
+	}
+	if (nodes[node].layer <= layer)
+	{
+		split(nodes[node].right, layer, nodes[node].right, right);
+		left = node;
+	}
+	else
+	{
+		split(nodes[node].left, layer, left, nodes[node].left);
+		right = node;
+	}
+	updateNode(node);
+}
+
+// Joins two treaps where every effect in left sorts before every effect in right.
+uint32_t LayeredAttributes_v8::merge(uint32_t left, uint32_t right)
+{
+	if (left == NoNode)
+	{
+		return right;
+	}
+	if (right == NoNode)
+	{
+		return left;
+	}
+	if (nodes[left].priority > nodes[right].priority)
+	{
+		uint32_t merged = merge(nodes[left].right, right);
+		nodes[left].right = merged;
+		updateNode(left);
+		return left;
+	}
+	uint32_t merged = merge(left, nodes[right].left);
+	nodes[right].left = merged;
+	updateNode(right);
+	return right;
+}
+
+int LayeredAttributes_v8::evaluate(uint32_t node, int value) const
+{
+	if (node == NoNode)
+	{
+		return value;
+	}
+	const Node& current = nodes[node];
+	if (!current.subtree.isOverflowed())
+	{
+		return current.subtree.apply(value);
+	}
+	value = evaluate(current.left, value);
+	value = current.transfer.apply(value);
+	return evaluate(current.right, value);
+}
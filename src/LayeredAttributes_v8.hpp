@@ -0,0 +1,64 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include "EffectTransfer.hpp"
+#include <vector>
+#include <array>
+#include <cstdint>
+
+// Composed-transfer engine.
+// Each attribute's effects live in a treap ordered by {layer, timestamp}.
+// Every node caches the composition of the effects in its subtree as a
+// ComposedTransfer, so inserting an effect anywhere in the stack costs
+// O(log n) node updates, a base change costs one application of the root
+// transfer, and reads are a plain array lookup. Stacks that alternate between
+// arithmetic and bitwise operations more often than a ComposedTransfer can
+// hold fall back to evaluating the affected subtrees node by node.
+class LayeredAttributes_v8 : public ILayeredAttributes
+{
+public:
+	LayeredAttributes_v8(bool errorLoggingEnabled = false, bool errorHandlingEnabled = false, size_t rereservationSize = 10ULL);
+	virtual ~LayeredAttributes_v8() = default;
+	void SetBaseAttribute(AttributeKey attribute, int value) override;
+	int GetCurrentAttribute(AttributeKey attribute) const override;
+	void AddLayeredEffect(LayeredEffectDefinition effect) override;
+	void ClearLayeredEffects() override;
+
+private:
+	bool errorLoggingEnabled;
+	bool errorHandlingEnabled;
+	size_t reservationSize;
+
+	static const size_t NumAttributes = AttributeKey::AttributeKey_Controller + 1;
+	static constexpr uint32_t NoNode = UINT32_MAX;
+
+	size_t nextTimestamp = 0;
+	size_t getNextTimestamp() { return nextTimestamp++; }
+
+	struct Node
+	{
+		int layer;
+		size_t timestamp;
+		EffectTransfer transfer;
+		ComposedTransfer subtree; // left subtree, this node, right subtree
+		uint32_t priority;
+		uint32_t left = NoNode;
+		uint32_t right = NoNode;
+	};
+
+	// one node pool shared by every attribute of this object
+	std::vector<Node> nodes;
+	std::array<uint32_t, NumAttributes> roots;
+	uint32_t prioritySeed = 0x9E3779B9u;
+
+	std::array<int, NumAttributes> baseAttributes;
+	std::array<int, NumAttributes> currentAttributes;
+
+	uint32_t nextPriority();
+	void updateNode(uint32_t node);
+	void split(uint32_t node, int layer, uint32_t& left, uint32_t& right);
+	uint32_t merge(uint32_t left, uint32_t right);
+	int evaluate(uint32_t node, int value) const;
+
+	bool attributeInBounds(AttributeKey attribute) const;
+	void logError(AttributeKey attribute) const;
+};
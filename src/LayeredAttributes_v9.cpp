@@ -0,0 +1,363 @@
+#include "LayeredAttributes_v9.hpp"
+#include "Timeline.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+LayeredAttributes_v9::LayeredAttributes_v9(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
+{
+	baseAttributes.fill(0);
+	currentAttributes.fill(0);
+	runStarts.fill(0);
+	lastKeys.fill(NoKey);
+	effects.reserve(this->reservationSize);
+}
+
+//Set the base value for an attribute on this object. All base values
+//default to 0 until set. Note that resetting a base attribute does not
+//alter any existing layered effects.
+void LayeredAttributes_v9::SetBaseAttribute(AttributeKey attribute, int value)
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		return;
+	}
+	baseAttributes[attribute] = value;
+	dirtyAttributes |= 1u << attribute;
+}
+
+//Return the current value for an attribute on this object. Will
+//be equal to the base value, modified by any applicable layered
+//effects.
+int LayeredAttributes_v9::GetCurrentAttribute(AttributeKey attribute) const
+{
+	if (attributeInBounds(attribute) == false)
+	{
+		return std::numeric_limits<int>::min();
+	}
+	uint32_t bit = 1u << attribute;
+	if (dirtyAttributes & bit)
+	{
+		currentAttributes[attribute] = calculateAttribute(attribute);
+		dirtyAttributes &= ~bit;
+	}
+	return currentAttributes[attribute];
+}
+
+//Applies a new layered effect to this object's attributes. See
+//LayeredEffectDefinition for details on how layered effects are
+//applied. Note that any number of layered effects may be applied
+//at any given time. Also note that layered effects are not necessarily
+//applied in the same order they were added. (see LayeredEffectDefinition.Layer)
+void LayeredAttributes_v9::AddLayeredEffect(LayeredEffectDefinition effectDef)
+{
+	if (attributeInBounds(effectDef.Attribute) == false)
+	{
+		return;
+	}
+	addEffect(effectDef);
+}
+
+void LayeredAttributes_v9::AddLayeredEffects(const LayeredEffectDefinition* effectDefs, size_t count)
+{
+	effects.reserve(effects.size() + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (attributeInBounds(effectDefs[i].Attribute))
+		{
+			addEffect(effectDefs[i]);
+		}
+	}
+}
+
+//Removes all layered effects from this object. After this call,
+//all current attributes will be equal to the base attributes.
+void LayeredAttributes_v9::ClearLayeredEffects()
+{
+	effects.clear();
+	sortedCount = 0;
+	tailAttributes = 0;
+	runStarts.fill(0);
+	lastKeys.fill(NoKey);
+	newestEffect = NoEffect;
+	nextTimestamp = 0;
+	currentAttributes = baseAttributes;
+	dirtyAttributes = 0;
+}
+
+void LayeredAttributes_v9::RenumberTimestamps()
+{
+	if (effects.size() > MaxTimestamp)
+	{
+		throw std::length_error("Too many layered effects to renumber");
+	}
+	if (sortedCount != effects.size())
+	{
+		mergeTail();
+	}
+	// timestamps only order the effects of one attribute and layer, and the
+	// sorted vector already holds those in timestamp order
+	for (size_t i = 0; i < effects.size(); ++i)
+	{
+		effects[i].key = withTimestamp(effects[i].key, i);
+	}
+	for (size_t attribute = 0; attribute < NumAttributes; ++attribute)
+	{
+		bool empty = runStarts[attribute] == runStarts[attribute + 1];
+		lastKeys[attribute] = empty ? NoKey : effects[runStarts[attribute + 1] - 1].key;
+	}
+	nextTimestamp = effects.size();
+}
+
+bool LayeredAttributes_v9::attributeInBounds(AttributeKey attribute) const
+{
+	bool outOfBounds = attribute < 0 || attribute >= static_cast<int>(NumAttributes);
+	if (outOfBounds && errorLoggingEnabled)
+	{
+		logError(attribute);
+	}
+	if (outOfBounds && errorHandlingEnabled)
+	{
+		throw std::out_of_range("Attribute out of range");
+	}
+	return !outOfBounds;
+}
+
+void LayeredAttributes_v9::logError([[maybe_unused]] AttributeKey attribute) const
+{
+	// Imagine that this method writes something useful to glog or similar logging service
+}
+
+void LayeredAttributes_v9::addEffect(const LayeredEffectDefinition& effectDef)
+{
+	if (nextTimestamp > MaxTimestamp)
+	{
+		RenumberTimestamps();
+	}
+	AttributeKey attribute = effectDef.Attribute;
+	uint32_t bit = 1u << attribute;
+	bool appliesLast;
+	if (mergeIntoNewest(effectDef))
+	{
+		appliesLast = effects[newestEffect].key == lastKeys[attribute];
+	}
+	else
+	{
+		uint64_t key = packKey(attribute, effectDef.Layer, getNextTimestamp());
+		bool inOrder = sortedCount == effects.size() && (effects.empty() || key > effects.back().key);
+		effects.push_back({ key, effectDef.Modification, effectDef.Operation });
+		newestEffect = effects.size() - 1;
+		if (inOrder)
+		{
+			// no later attribute has effects yet, so their runs start at the end
+			sortedCount = effects.size();
+			for (size_t later = static_cast<size_t>(attribute) + 1; later <= NumAttributes; ++later)
+			{
+				runStarts[later] = sortedCount;
+			}
+		}
+		else
+		{
+			tailAttributes |= bit;
+		}
+		// the timestamp is the newest, so only a lower layer keeps it from applying last
+		appliesLast = lastKeys[attribute] == NoKey || key > lastKeys[attribute];
+		if (appliesLast)
+		{
+			lastKeys[attribute] = key;
+		}
+	}
+	if (appliesLast && (dirtyAttributes & bit) == 0)
+	{
+		updateAttribute(effectDef.Operation, effectDef.Modification, currentAttributes[attribute]);
+	}
+	else
+	{
+		dirtyAttributes |= bit;
+	}
+}
+
+// The most recently added effect is next to a new effect of the same
+// attribute and layer in their stack, so one of the same operation folds
+// into it instead of taking a slot.
+bool LayeredAttributes_v9::mergeIntoNewest(const LayeredEffectDefinition& effectDef)
+{
+	if (newestEffect == NoEffect)
+	{
+		return false;
+	}
+	Effect& newest = effects[newestEffect];
+	uint64_t group = packKey(effectDef.Attribute, effectDef.Layer, 0);
+	if (withTimestamp(newest.key, 0) != group || newest.operation != effectDef.Operation)
+	{
+		return false;
+	}
+	int operation = effectDef.Operation;
+	if (operation == EffectOperation_Set)
+	{
+		newest.modification = effectDef.Modification;
+	}
+	else if (operation == EffectOperation_Add || operation == EffectOperation_Subtract)
+	{
+		newest.modification += effectDef.Modification;
+	}
+	else if (operation == EffectOperation_Multiply)
+	{
+		newest.modification *= effectDef.Modification;
+	}
+	else if (operation == EffectOperation_BitwiseOr)
+	{
+		newest.modification |= effectDef.Modification;
+	}
+	else if (operation == EffectOperation_BitwiseAnd)
+	{
+		newest.modification &= effectDef.Modification;
+	}
+	else if (operation == EffectOperation_BitwiseXor)
+	{
+		newest.modification ^= effectDef.Modification;
+	}
+	else
+	{
+		// do nothing
+	}
+	return true;
+}
+
+void LayeredAttributes_v9::mergeTail() const
+{
+	TIMELINE_SPAN("LayeredAttributes_v9::mergeTail", reinterpret_cast<uintptr_t>(this));
+	auto byKey = [](const Effect& a, const Effect& b) { return a.key < b.key; };
+	Effect* first = effects.data();
+	Effect* sortedEnd = first + sortedCount;
+	Effect* last = first + effects.size();
+	if (static_cast<size_t>(last - sortedEnd) >= RadixSortThreshold)
+	{
+		radixSort(sortedEnd, last);
+	}
+	else
+	{
+		std::sort(sortedEnd, last, byKey);
+	}
+
+	// only the part of the prefix that sorts after the tail's first effect moves
+	Effect* displaced = std::upper_bound(first, sortedEnd, *sortedEnd, byKey);
+	if (displaced != sortedEnd)
+	{
+		scratch.assign(displaced, sortedEnd);
+		const Effect* prefix = scratch.data();
+		const Effect* prefixEnd = prefix + scratch.size();
+		const Effect* tail = sortedEnd;
+		Effect* out = displaced;
+		// out never passes tail, so merging forward in place is safe; once the
+		// displaced effects run out, the rest of the tail is already in place
+		while (prefix != prefixEnd && tail != last)
+		{
+			*out++ = tail->key < prefix->key ? *tail++ : *prefix++;
+		}
+		std::copy(prefix, prefixEnd, out);
+	}
+
+	sortedCount = effects.size();
+	tailAttributes = 0;
+	newestEffect = NoEffect;
+	for (size_t attribute = 0; attribute <= NumAttributes; ++attribute)
+	{
+		uint64_t runKey = uint64_t(attribute) << 60;
+		runStarts[attribute] = static_cast<size_t>(std::lower_bound(first, last, runKey,
+			[](const Effect& effect, uint64_t key) { return effect.key < key; }) - first);
+	}
+}
+
+// LSD radix sort on the key, a byte per pass. Passes over a byte that every
+// key shares (the attribute and layer bytes of most saved games) are skipped.
+void LayeredAttributes_v9::radixSort(Effect* first, Effect* last) const
+{
+	size_t count = static_cast<size_t>(last - first);
+	std::array<std::array<size_t, 256>, 8> counts{};
+	for (const Effect* effect = first; effect != last; ++effect)
+	{
+		for (size_t pass = 0; pass < 8; ++pass)
+		{
+			++counts[pass][(effect->key >> (pass * 8)) & 0xFF];
+		}
+	}
+	scratch.resize(count);
+	Effect* from = first;
+	Effect* to = scratch.data();
+	for (size_t pass = 0; pass < 8; ++pass)
+	{
+		auto& offsets = counts[pass];
+		if (offsets[(from->key >> (pass * 8)) & 0xFF] == count)
+		{
+			continue;
+		}
+		size_t offset = 0;
+		for (auto& bucket : offsets)
+		{
+			size_t bucketSize = bucket;
+			bucket = offset;
+			offset += bucketSize;
+		}
+		for (const Effect* effect = from; effect != from + count; ++effect)
+		{
+			to[offsets[(effect->key >> (pass * 8)) & 0xFF]++] = *effect;
+		}
+		std::swap(from, to);
+	}
+	if (from != first)
+	{
+		std::copy(from, from + count, first);
+	}
+}
+
+int LayeredAttributes_v9::calculateAttribute(AttributeKey attribute) const
+{
+	if (tailAttributes & (1u << attribute))
+	{
+		mergeTail();
+	}
+	int result = baseAttributes[attribute];
+	for (size_t i = runStarts[attribute], end = runStarts[attribute + 1]; i < end; ++i)
+	{
+		updateAttribute(effects[i].operation, effects[i].modification, result);
+	}
+	return result;
+}
+
+void LayeredAttributes_v9::updateAttribute(int operation, int modification, int& result) const
+{
+	if (operation == EffectOperation_Set)
+	{
+		result = modification;
+	}
+	else if (operation == EffectOperation_Add)
+	{
+		result += modification;
+	}
+	else if (operation == EffectOperation_Subtract)
+	{
+		result -= modification;
+	}
+	else if (operation == EffectOperation_Multiply)
+	{
+		result *= modification;
+	}
+	else if (operation == EffectOperation_BitwiseOr)
+	{
+		result |= modification;
+	}
+	else if (operation == EffectOperation_BitwiseAnd)
+	{
+		result &= modification;
+	}
+	else if (operation == EffectOperation_BitwiseXor)
+	{
+		result ^= modification;
+	}
+	else
+	{
+		// do nothing
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "ILayeredAttributes.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sorted-vector engine.
+// Every effect of the object lives in one contiguous vector ordered by a
+// packed {attribute, layer, timestamp} key, so each attribute's stack is one
+// run of it, found through a per-attribute offset index. Effects that arrive
+// in key order extend the sorted prefix; the rest collect in an unsorted tail
+// that is sorted (LSD radix sort once it is large) and merged into the prefix
+// only when a read needs one of its attributes. The merge only moves the part
+// of the prefix the tail overlaps. Current values are cached and updated in
+// place when a new effect applies last in its stack.
+class LayeredAttributes_v9 : public ILayeredAttributes
+{
+public:
+	LayeredAttributes_v9(bool errorLoggingEnabled = false, bool errorHandlingEnabled = false, size_t rereservationSize = 10ULL);
+	virtual ~LayeredAttributes_v9() = default;
+	void SetBaseAttribute(AttributeKey attribute, int value) override;
+	int GetCurrentAttribute(AttributeKey attribute) const override;
+	void AddLayeredEffect(LayeredEffectDefinition effect) override;
+	void ClearLayeredEffects() override;
+
+	// Adds many effects at once; equivalent to calling AddLayeredEffect for
+	// each definition in order. The batch lands in the tail, so a saved game
+	// is radix sorted once by the first read instead of inserted one by one.
+	void AddLayeredEffects(const LayeredEffectDefinition* effectDefs, size_t count);
+	void AddLayeredEffects(const std::vector<LayeredEffectDefinition>& effectDefs) { AddLayeredEffects(effectDefs.data(), effectDefs.size()); }
+
+	// Renumbers the timestamps of the current effects 0, 1, 2, ... keeping
+	// their order, so new timestamps fit in their field again. AddLayeredEffect
+	// calls it when the counter would overflow; calling it early changes no value.
+	void RenumberTimestamps();
+
+	// tails at least this long are radix sorted, shorter ones with std::sort
+	static constexpr size_t RadixSortThreshold = 256;
+
+private:
+	bool errorLoggingEnabled;
+	bool errorHandlingEnabled;
+	size_t reservationSize;
+
+	static constexpr size_t NumAttributes = AttributeKey::AttributeKey_Controller + 1;
+	static_assert(NumAttributes <= 16, "attributes must fit in the key's top 4 bits");
+
+	// The key is the attribute in the top 4 bits, then the layer (biased to
+	// unsigned) in 32 bits, then a 28-bit timestamp, so comparing keys
+	// compares {attribute, layer, timestamp}.
+	static constexpr unsigned TimestampBits = 28;
+	static constexpr size_t MaxTimestamp = (size_t(1) << TimestampBits) - 1;
+	static constexpr uint64_t NoKey = UINT64_MAX;
+	static constexpr size_t NoEffect = SIZE_MAX;
+
+	static uint64_t packKey(AttributeKey attribute, int layer, size_t timestamp)
+	{
+		uint64_t biasedLayer = static_cast<uint32_t>(layer) ^ 0x80000000u;
+		return (uint64_t(attribute) << 60) | (biasedLayer << TimestampBits) | uint64_t(timestamp);
+	}
+	static size_t keyAttribute(uint64_t key) { return static_cast<size_t>(key >> 60); }
+	static uint64_t keyLayer(uint64_t key) { return (key >> TimestampBits) & 0xFFFFFFFFu; }
+	static uint64_t withTimestamp(uint64_t key, size_t timestamp) { return (key & ~uint64_t(MaxTimestamp)) | uint64_t(timestamp); }
+
+	struct Effect
+	{
+		uint64_t key;
+		int modification;
+		int operation;
+	};
+
+	size_t nextTimestamp = 0;
+	size_t getNextTimestamp() { return nextTimestamp++; }
+
+	std::array<int, NumAttributes> baseAttributes;
+	mutable std::array<int, NumAttributes> currentAttributes;
+	// bit a: the current value of attribute a must be recalculated
+	mutable uint32_t dirtyAttributes = 0;
+
+	// effects[0, sortedCount) are in key order, the rest are not yet
+	mutable std::vector<Effect> effects;
+	mutable size_t sortedCount = 0;
+	// bit a: the tail holds an effect of attribute a
+	mutable uint32_t tailAttributes = 0;
+	// attribute a's run of the sorted prefix is [runStarts[a], runStarts[a + 1])
+	mutable std::array<size_t, NumAttributes + 1> runStarts;
+	// radix sort and merge buffer, kept for its capacity
+	mutable std::vector<Effect> scratch;
+	// the key each attribute's stack applies last, NoKey if it has no effects
+	std::array<uint64_t, NumAttributes> lastKeys;
+	// where the most recently added effect is, while merging has not moved it
+	mutable size_t newestEffect = NoEffect;
+
+	void addEffect(const LayeredEffectDefinition& effectDef);
+	void mergeTail() const;
+	void radixSort(Effect* first, Effect* last) const;
+	int calculateAttribute(AttributeKey attribute) const;
+	void updateAttribute(int operation, int modification, int& result) const;
+	bool mergeIntoNewest(const LayeredEffectDefinition& effectDef);
+
+	bool attributeInBounds(AttributeKey attribute) const;
+	void logError(AttributeKey attribute) const;
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <type_traits>
+
+// A vector that keeps up to N elements inside the object and only allocates,
+// from its memory resource, once it grows past them. Most effect stacks hold
+// a handful of effects, so most never allocate at all. Elements must be
+// trivially copyable; they are moved with memcpy/memmove. Copies allocate
+// from the default resource, like the std::pmr containers.
+template <typename T, size_t N>
+class SmallVector
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector moves its elements with memcpy");
+
+public:
+	using value_type = T;
+	using allocator_type = std::pmr::polymorphic_allocator<T>;
+	using iterator = T*;
+	using const_iterator = const T*;
+	static constexpr size_t InlineCapacity = N;
+
+	explicit SmallVector(const allocator_type& allocator = allocator_type()) : allocator(allocator) {}
+	SmallVector(const SmallVector& other) : SmallVector(other, allocator_type()) {}
+	SmallVector(const SmallVector& other, const allocator_type& allocator) : allocator(allocator) { assign(other); }
+	SmallVector(SmallVector&& other) noexcept : allocator(other.allocator) { steal(other); }
+	SmallVector(SmallVector&& other, const allocator_type& allocator) : allocator(allocator)
+	{
+		if (allocator == other.allocator)
+		{
+			steal(other);
+		}
+		else
+		{
+			assign(other);
+		}
+	}
+	SmallVector& operator=(const SmallVector& other)
+	{
+		if (this != &other)
+		{
+			assign(other);
+		}
+		return *this;
+	}
+	// keeps this vector's resource, like the std::pmr containers
+	SmallVector& operator=(SmallVector&& other)
+	{
+		if (this != &other && allocator == other.allocator)
+		{
+			release();
+			steal(other);
+		}
+		else if (this != &other)
+		{
+			assign(other);
+		}
+		return *this;
+	}
+	~SmallVector() { release(); }
+
+	iterator begin() { return elements; }
+	iterator end() { return elements + count; }
+	const_iterator begin() const { return elements; }
+	const_iterator end() const { return elements + count; }
+	T* data() { return elements; }
+	const T* data() const { return elements; }
+	T& operator[](size_t index) { return elements[index]; }
+	const T& operator[](size_t index) const { return elements[index]; }
+	T& back() { return elements[count - 1]; }
+	const T& back() const { return elements[count - 1]; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t capacity() const { return reserved; }
+	// true while the elements are stored inside the object
+	bool isInline() const { return elements == inlineElements(); }
+	allocator_type get_allocator() const { return allocator; }
+
+	// keeps the capacity, inline or not
+	void clear() { count = 0; }
+
+	void reserve(size_t capacity)
+	{
+		if (capacity > reserved)
+		{
+			reallocate(capacity);
+		}
+	}
+
+	void push_back(const T& value)
+	{
+		T copy = value; // value may live in this vector
+		if (count == reserved)
+		{
+			reallocate(std::max<size_t>(count + 1, reserved * 2));
+		}
+		std::memcpy(static_cast<void*>(elements + count), &copy, sizeof(T));
+		++count;
+	}
+
+	iterator insert(const_iterator position, const T& value)
+	{
+		size_t index = static_cast<size_t>(position - elements);
+		T copy = value;
+		if (count == reserved)
+		{
+			reallocate(std::max<size_t>(count + 1, reserved * 2));
+		}
+		std::memmove(static_cast<void*>(elements + index + 1), elements + index, (count - index) * sizeof(T));
+		std::memcpy(static_cast<void*>(elements + index), &copy, sizeof(T));
+		++count;
+		return elements + index;
+	}
+
+private:
+	allocator_type allocator;
+	T* elements = inlineElements();
+	size_t count = 0;
+	size_t reserved = N;
+	alignas(T) unsigned char storage[N == 0 ? 1 : N * sizeof(T)];
+
+	T* inlineElements() { return reinterpret_cast<T*>(storage); }
+	const T* inlineElements() const { return reinterpret_cast<const T*>(storage); }
+
+	void reallocate(size_t capacity)
+	{
+		T* moved = allocator.allocate(capacity);
+		std::memcpy(static_cast<void*>(moved), elements, count * sizeof(T));
+		release();
+		elements = moved;
+		reserved = capacity;
+	}
+
+	void release()
+	{
+		if (!isInline())
+		{
+			allocator.deallocate(elements, reserved);
+			elements = inlineElements();
+			reserved = N;
+		}
+	}
+
+	void assign(const SmallVector& other)
+	{
+		count = 0;
+		reserve(other.count);
+		std::memcpy(static_cast<void*>(elements), other.elements, other.count * sizeof(T));
+		count = other.count;
+	}
+
+	// takes other's heap buffer, or copies its inline elements, and leaves it empty
+	void steal(SmallVector& other)
+	{
+		if (other.isInline())
+		{
+			std::memcpy(static_cast<void*>(inlineElements()), other.elements, other.count * sizeof(T));
+			elements = inlineElements();
+			reserved = N;
+		}
+		else
+		{
+			elements = other.elements;
+			reserved = other.reserved;
+			other.elements = other.inlineElements();
+			other.reserved = N;
+		}
+		count = other.count;
+		other.count = 0;
+	}
+};
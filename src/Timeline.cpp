@@ -0,0 +1,182 @@
+#include "Timeline.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Timeline::recording{ false };
+
+namespace
+{
+	// a few tens of MB per thread at most; a stalled turn fits many times over
+	const size_t MaxSpansPerThread = size_t(1) << 20;
+
+	struct Event
+	{
+		const char* name;
+		int64_t start;    // ns since Timeline::Start()
+		int64_t duration; // ns
+		uint64_t entity;
+		int attribute;
+	};
+
+	// Only its own thread appends to a buffer; everything else reads it under
+	// the registry lock while that thread is outside any span.
+	struct ThreadBuffer
+	{
+		uint32_t thread = 0;
+		std::vector<Event> events;
+		size_t dropped = 0;
+	};
+
+	struct Registry
+	{
+		std::mutex mutex;
+		// buffers outlive their threads, so spans of joined threads are kept
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	};
+
+	Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	ThreadBuffer& threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffer = r.buffers.back().get();
+			buffer->thread = static_cast<uint32_t>(r.buffers.size());
+		}
+		return *buffer;
+	}
+
+	void writeName(std::FILE* file, const char* name)
+	{
+		for (const char* c = name; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				std::fputc('\\', file);
+			}
+			std::fputc(*c, file);
+		}
+	}
+}
+
+void Timeline::Start()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (auto& buffer : r.buffers)
+	{
+		buffer->events.clear();
+		buffer->dropped = 0;
+	}
+	r.epoch = std::chrono::steady_clock::now();
+	recording.store(true, std::memory_order_relaxed);
+}
+
+void Timeline::Stop()
+{
+	recording.store(false, std::memory_order_relaxed);
+}
+
+size_t Timeline::SpanCount()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	size_t count = 0;
+	for (const auto& buffer : r.buffers)
+	{
+		count += buffer->events.size();
+	}
+	return count;
+}
+
+size_t Timeline::DroppedCount()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	size_t count = 0;
+	for (const auto& buffer : r.buffers)
+	{
+		count += buffer->dropped;
+	}
+	return count;
+}
+
+void Timeline::record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop, uint64_t entity, int attribute)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	if (buffer.events.size() >= MaxSpansPerThread)
+	{
+		++buffer.dropped;
+		return;
+	}
+	if (buffer.events.empty())
+	{
+		// grow in large steps, a reallocation inside a span would show up in the trace
+		buffer.events.reserve(size_t(1) << 14);
+	}
+	// the epoch only changes in Start(), which is not called while spans are open
+	auto epoch = registry().epoch;
+	buffer.events.push_back({ name,
+		std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count()),
+		std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count(),
+		entity, attribute });
+}
+
+bool Timeline::WriteChromeTrace(const std::string& path)
+{
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+	bool first = true;
+	for (const auto& buffer : r.buffers)
+	{
+		if (buffer->events.empty())
+		{
+			continue;
+		}
+		std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			first ? "" : ",\n", buffer->thread, buffer->thread);
+		first = false;
+		for (const Event& event : buffer->events)
+		{
+			// timestamps are in microseconds; keep the nanoseconds as decimals
+			std::fputs(",\n{\"name\":\"", file);
+			writeName(file, event.name);
+			std::fprintf(file, "\",\"cat\":\"LayeredAttributes\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld.%03lld,\"dur\":%lld.%03lld,\"args\":{",
+				buffer->thread,
+				static_cast<long long>(event.start / 1000), static_cast<long long>(event.start % 1000),
+				static_cast<long long>(event.duration / 1000), static_cast<long long>(event.duration % 1000));
+			const char* separator = "";
+			if (event.entity != None)
+			{
+				std::fprintf(file, "\"entity\":%llu", static_cast<unsigned long long>(event.entity));
+				separator = ",";
+			}
+			if (event.attribute >= 0)
+			{
+				std::fprintf(file, "%s\"attribute\":%d", separator, event.attribute);
+			}
+			std::fputs("}}", file);
+		}
+	}
+	std::fputs("\n]}\n", file);
+	bool written = std::ferror(file) == 0;
+	return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped timeline spans for the engines, written out as Chrome trace-event
+// JSON (chrome://tracing, ui.perfetto.dev).
+// The engines open spans with TIMELINE_SPAN around recomputes, effect inserts,
+// clears, timer expiry and parallel recompute chunks. The macro is only
+// compiled in when LAYERED_ATTRIBUTES_TIMELINE is defined (see Enabled);
+// otherwise it compiles to nothing. Even when compiled in, a span costs one
+// relaxed load until Timeline::Start() is called.
+//
+// Every thread appends finished spans to its own buffer without locking.
+// WriteChromeTrace() reads every thread's buffer, so call it (and Start/Stop)
+// only while no other thread is inside a span, e.g. after RecomputeDirty
+// returns or after the threads are joined.
+class Timeline
+{
+public:
+#if defined(LAYERED_ATTRIBUTES_TIMELINE)
+	static constexpr bool Enabled = true;
+#else
+	static constexpr bool Enabled = false;
+#endif
+	// argument value meaning "not applicable"
+	static constexpr uint64_t None = UINT64_MAX;
+
+	// Discards everything recorded so far and starts recording.
+	static void Start();
+	static void Stop();
+	static bool IsRecording() { return recording.load(std::memory_order_relaxed); }
+
+	// Writes every span recorded since Start() as {"traceEvents": [...]},
+	// one complete ("X") event per span with its entity and attribute as
+	// args. Returns false if the file cannot be written.
+	static bool WriteChromeTrace(const std::string& path);
+	// spans recorded so far, and spans lost because a thread's buffer was full
+	static size_t SpanCount();
+	static size_t DroppedCount();
+
+	// Records the time between its construction and destruction. name must be
+	// a string literal (or otherwise outlive the trace). entity is an entity
+	// slot for AttributeWorld and the object's address for single-object engines.
+	class Span
+	{
+	public:
+		Span(const char* name, uint64_t entity = None, int attribute = -1)
+		{
+			if (IsRecording())
+			{
+				this->name = name;
+				this->entity = entity;
+				this->attribute = attribute;
+				start = std::chrono::steady_clock::now();
+			}
+		}
+		~Span()
+		{
+			if (name != nullptr)
+			{
+				record(name, start, std::chrono::steady_clock::now(), entity, attribute);
+			}
+		}
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+
+	private:
+		const char* name = nullptr;
+		uint64_t entity = None;
+		int attribute = -1;
+		std::chrono::steady_clock::time_point start;
+	};
+
+private:
+	static std::atomic<bool> recording;
+	static void record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop, uint64_t entity, int attribute);
+};
+
+#if defined(LAYERED_ATTRIBUTES_TIMELINE)
+#define TIMELINE_CONCAT_INNER(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_INNER(a, b)
+#define TIMELINE_SPAN(...) Timeline::Span TIMELINE_CONCAT(timelineSpan, __LINE__)(__VA_ARGS__)
+#else
+#define TIMELINE_SPAN(...) ((void)0)
+#endif
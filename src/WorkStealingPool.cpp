@@ -0,0 +1,167 @@
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+
+namespace
+{
+	uint64_t pack(uint64_t begin, uint64_t end)
+	{
+		return (begin << 32) | end;
+	}
+
+	uint64_t beginOf(uint64_t bounds)
+	{
+		return bounds >> 32;
+	}
+
+	uint64_t endOf(uint64_t bounds)
+	{
+		return bounds & 0xFFFFFFFFu;
+	}
+}
+
+WorkStealingPool::WorkStealingPool(size_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+	blocks = std::make_unique<Block[]>(threadCount);
+	for (size_t participant = 1; participant < threadCount; ++participant)
+	{
+		workers.emplace_back(&WorkStealingPool::workerLoop, this, participant);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void WorkStealingPool::ParallelFor(size_t taskCount, const std::function<void(size_t)>& taskToRun)
+{
+	if (taskCount == 0)
+	{
+		return;
+	}
+	if (workers.empty() || taskCount == 1)
+	{
+		for (size_t i = 0; i < taskCount; ++i)
+		{
+			taskToRun(i);
+		}
+		return;
+	}
+	// indices are packed into 32 bits; larger passes run as several rounds
+	const size_t maxRound = 0xFFFFFFFFu;
+	for (size_t offset = 0; offset < taskCount; offset += maxRound)
+	{
+		size_t roundCount = std::min(maxRound, taskCount - offset);
+		std::function<void(size_t)> shifted;
+		if (offset != 0)
+		{
+			shifted = [&taskToRun, offset](size_t i) { taskToRun(i + offset); };
+		}
+		size_t participants = ThreadCount();
+		for (size_t participant = 0; participant < participants; ++participant)
+		{
+			blocks[participant].bounds.store(pack(roundCount * participant / participants, roundCount * (participant + 1) / participants), std::memory_order_relaxed);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = offset == 0 ? &taskToRun : &shifted;
+			busyWorkers.store(workers.size(), std::memory_order_relaxed);
+			++pass;
+		}
+		wake.notify_all();
+		work(0);
+		// the task lives on the caller's stack, so every worker has to be out of it
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busyWorkers.load(std::memory_order_acquire) == 0; });
+		task = nullptr;
+	}
+}
+
+void WorkStealingPool::workerLoop(size_t participant)
+{
+	size_t seenPass = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || pass != seenPass; });
+			if (stopping)
+			{
+				return;
+			}
+			seenPass = pass;
+		}
+		work(participant);
+		if (busyWorkers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.notify_one();
+		}
+	}
+}
+
+void WorkStealingPool::work(size_t participant)
+{
+	size_t index;
+	while (true)
+	{
+		if (takeFront(participant, index))
+		{
+			(*task)(index);
+		}
+		else if (!steal(participant))
+		{
+			return;
+		}
+	}
+}
+
+bool WorkStealingPool::takeFront(size_t participant, size_t& index)
+{
+	auto& bounds = blocks[participant].bounds;
+	uint64_t current = bounds.load(std::memory_order_acquire);
+	while (beginOf(current) < endOf(current))
+	{
+		if (bounds.compare_exchange_weak(current, pack(beginOf(current) + 1, endOf(current)), std::memory_order_acq_rel))
+		{
+			index = static_cast<size_t>(beginOf(current));
+			return true;
+		}
+	}
+	return false;
+}
+
+// Takes the back half of the first non-empty block after our own and makes
+// it our block. Our block is empty at this point, and the stolen indices
+// have never been handed out, so a stale CAS on our block cannot succeed.
+bool WorkStealingPool::steal(size_t participant)
+{
+	size_t participants = ThreadCount();
+	for (size_t step = 1; step < participants; ++step)
+	{
+		auto& bounds = blocks[(participant + step) % participants].bounds;
+		uint64_t current = bounds.load(std::memory_order_acquire);
+		while (beginOf(current) < endOf(current))
+		{
+			uint64_t middle = beginOf(current) + (endOf(current) - beginOf(current)) / 2;
+			if (bounds.compare_exchange_weak(current, pack(beginOf(current), middle), std::memory_order_acq_rel))
+			{
+				blocks[participant].bounds.store(pack(middle, endOf(current)), std::memory_order_release);
+				return true;
+			}
+		}
+	}
+	return false;
+}
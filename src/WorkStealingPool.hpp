@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fork-join pool for data-parallel passes.
+// ParallelFor hands every thread one contiguous block of task indices, so
+// neighbouring tasks (and the memory they touch) stay on one core. A thread
+// that runs out of work steals the back half of another thread's block.
+// The calling thread takes part, and the workers sleep between passes.
+class WorkStealingPool
+{
+public:
+	// threadCount includes the calling thread; 0 picks one per hardware thread.
+	explicit WorkStealingPool(size_t threadCount = 0);
+	~WorkStealingPool();
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	size_t ThreadCount() const { return workers.size() + 1; }
+
+	// Runs task(i) exactly once for every i in [0, taskCount) and returns when
+	// all of them have finished. Tasks must not throw, and must not call
+	// ParallelFor on the same pool.
+	void ParallelFor(size_t taskCount, const std::function<void(size_t)>& task);
+
+private:
+	// [begin, end) packed into one word so that the owner (taking from the
+	// front) and thieves (taking from the back) agree through a single CAS
+	struct alignas(64) Block
+	{
+		std::atomic<uint64_t> bounds{ 0 };
+	};
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<Block[]> blocks;
+	const std::function<void(size_t)>* task = nullptr;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	size_t pass = 0;
+	bool stopping = false;
+	std::atomic<size_t> busyWorkers{ 0 };
+
+	void workerLoop(size_t participant);
+	void work(size_t participant);
+	bool takeFront(size_t participant, size_t& index);
+	bool steal(size_t participant);
+};
@@ -1,8 +1,10 @@
 #include "LA_v3_Extension_Removals.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 LA_v3_Extension_Removals::LA_v3_Extension_Removals(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
-	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max(1ULL, reservationSize))
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
 {
 	baseAttributes.fill(0);
 	currentAttributes.fill(0);
@@ -1,8 +1,10 @@
 #include "LayeredAttributes_v3.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 LayeredAttributes_v3::LayeredAttributes_v3(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
-	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max(1ULL, reservationSize))
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
 {
 	baseAttributes.fill(0);
 	currentAttributes.fill(0);
@@ -1,10 +1,12 @@
 #include "LayeredAttributes_v5.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 /*NB: Do not use this implementation. Aborting in favor a new apprach. See v6...*/
 
 LayeredAttributes_v5::LayeredAttributes_v5(bool errorLoggingEnabled, bool errorHandlingEnabled, size_t reservationSize)
-	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max(1ULL, reservationSize))
+	: errorLoggingEnabled(errorLoggingEnabled), errorHandlingEnabled(errorHandlingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
 {
 	//baseAttributes.fill(0);
 	//currentAttributes.fill(0);
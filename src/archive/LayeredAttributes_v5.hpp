@@ -1,5 +1,6 @@
 #pragma once
 #include "ILayeredAttributes.hpp"
+#include <cstddef>
 #include <vector>
 #include <map>
 //#include <array>
@@ -3,7 +3,7 @@
 #include <algorithm>
 
 LayeredAttributes_v6::LayeredAttributes_v6(bool errorLoggingEnabled, size_t reservationSize)
-	: errorLoggingEnabled(errorLoggingEnabled), reservationSize(std::max(1ULL, reservationSize))
+	: errorLoggingEnabled(errorLoggingEnabled), reservationSize(std::max<size_t>(1, reservationSize))
 {
 	baseAttributes.reserve(reservationSize);
 	cache.reserve(reservationSize);
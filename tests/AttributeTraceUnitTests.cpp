@@ -0,0 +1,206 @@
+#include "AttributeTraceUnitTests.hpp"
+#include "../src/AttributeTrace.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/LayeredAttributes_v7.hpp"
+#include "../src/LayeredAttributes_v8.hpp"
+#include <assert.h>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using ReferenceImplementation = LayeredAttributes_v2;
+
+
+void AttributeTraceUnitTests::runOperationalTests()
+{
+	testRoundTrip();
+	testReplayMatchesRecording();
+	testReplayFlagsMismatch();
+	std::cout << "** AttributeTrace operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void AttributeTraceUnitTests::runCrashTests()
+{
+	testTruncatedTrace();
+	testCorruptObjectId();
+	std::cout << "** AttributeTrace crash tests passed **" << std::endl;
+}
+
+void AttributeTraceUnitTests::testRoundTrip()
+{
+	{
+		AttributeTrace::Writer writer(path);
+		ReferenceImplementation bear;
+		ReferenceImplementation elf;
+		RecordingLayeredAttributes recordedBear(bear, &writer);
+		RecordingLayeredAttributes recordedElf(elf, &writer);
+		recordedBear.SetBaseAttribute(AttributeKey_Power, 2);
+		recordedElf.SetBaseAttribute(AttributeKey_Controller, -70000);
+		recordedBear.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Multiply, /*modifier*/-3, /*layer*/1000 });
+		assert(recordedBear.GetCurrentAttribute(AttributeKey_Power) == -6);
+		recordedElf.ClearLayeredEffects();
+		assert(recordedElf.GetCurrentAttribute(AttributeKey_Controller) == -70000);
+	}
+
+	AttributeTrace trace = AttributeTrace::Load(path);
+	std::remove(path.c_str());
+	[[maybe_unused]] const auto& calls = trace.Calls();
+	assert(trace.ObjectCount() == 2);
+	assert(calls.size() == 6);
+	assert(calls[0].object == 0 && calls[0].type == AttributeTrace::CallType_SetBase);
+	assert(calls[0].effect.Attribute == AttributeKey_Power && calls[0].effect.Modification == 2);
+	assert(calls[1].object == 1 && calls[1].effect.Attribute == AttributeKey_Controller && calls[1].effect.Modification == -70000);
+	assert(calls[2].type == AttributeTrace::CallType_AddEffect);
+	assert(calls[2].effect.Operation == EffectOperation_Multiply);
+	assert(calls[2].effect.Modification == -3 && calls[2].effect.Layer == 1000);
+	assert(calls[3].type == AttributeTrace::CallType_Read && calls[3].effect.Modification == -6);
+	assert(calls[4].object == 1 && calls[4].type == AttributeTrace::CallType_Clear);
+	assert(calls[5].type == AttributeTrace::CallType_Read && calls[5].effect.Modification == -70000);
+	std::cout << "testRoundTrip passed" << std::endl;
+}
+
+void AttributeTraceUnitTests::testReplayMatchesRecording()
+{
+	// a few dozen cards taking random calls, like a long game
+	const int cards = 40;
+	std::mt19937 rng(17);
+	std::uniform_int_distribution<int> card(0, cards - 1);
+	std::uniform_int_distribution<int> call(0, 99);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-5, 5);
+	std::uniform_int_distribution<int> layer(1, 7);
+	int64_t recordedChecksum = 0;
+	{
+		AttributeTrace::Writer writer(path);
+		std::vector<std::unique_ptr<ReferenceImplementation>> engines;
+		std::vector<std::unique_ptr<RecordingLayeredAttributes>> recorded;
+		for (int i = 0; i < cards; ++i)
+		{
+			engines.push_back(std::make_unique<ReferenceImplementation>());
+			recorded.push_back(std::make_unique<RecordingLayeredAttributes>(*engines.back(), &writer));
+		}
+		for (int i = 0; i < 20000; ++i)
+		{
+			auto& target = *recorded[card(rng)];
+			AttributeKey attribute = AttributeKey(key(rng));
+			int roll = call(rng);
+			if (roll < 50)
+			{
+				recordedChecksum += target.GetCurrentAttribute(attribute);
+			}
+			else if (roll < 60)
+			{
+				target.SetBaseAttribute(attribute, modifier(rng));
+			}
+			else if (roll < 98)
+			{
+				target.AddLayeredEffect({ attribute, EffectOperation(operation(rng)), modifier(rng), layer(rng) });
+			}
+			else
+			{
+				target.ClearLayeredEffects();
+			}
+		}
+	}
+
+	AttributeTrace trace = AttributeTrace::Load(path);
+	std::remove(path.c_str());
+	assert(trace.ObjectCount() == cards);
+	assert(trace.Calls().size() == 20000);
+
+	// every engine must reproduce every recorded read
+	[[maybe_unused]] auto reference = trace.Replay<ReferenceImplementation>();
+	assert(reference.calls == 20000);
+	assert(reference.mismatches == 0);
+	assert(reference.checksum == recordedChecksum);
+	[[maybe_unused]] auto dense = trace.Replay<LayeredAttributes_v7>();
+	assert(dense.mismatches == 0);
+	assert(dense.checksum == recordedChecksum);
+	[[maybe_unused]] auto composed = trace.Replay<LayeredAttributes_v8>();
+	assert(composed.mismatches == 0);
+	assert(composed.checksum == recordedChecksum);
+	std::cout << "testReplayMatchesRecording passed" << std::endl;
+}
+
+void AttributeTraceUnitTests::testReplayFlagsMismatch()
+{
+	{
+		AttributeTrace::Writer writer(path);
+		uint32_t object = writer.NextObject();
+		writer.Record(object, AttributeTrace::CallType_SetBase, { AttributeKey_Power, EffectOperation_Invalid, 3, 0 });
+		writer.Record(object, AttributeTrace::CallType_Read, { AttributeKey_Power, EffectOperation_Invalid, 3, 0 });
+		// recorded by an engine that got it wrong
+		writer.Record(object, AttributeTrace::CallType_Read, { AttributeKey_Toughness, EffectOperation_Invalid, 1, 0 });
+		writer.Record(object, AttributeTrace::CallType_Read, { AttributeKey_Power, EffectOperation_Invalid, 4, 0 });
+	}
+
+	AttributeTrace trace = AttributeTrace::Load(path);
+	std::remove(path.c_str());
+	[[maybe_unused]] auto result = trace.Replay<ReferenceImplementation>();
+	assert(result.mismatches == 2);
+	assert(result.firstMismatch == 2);
+	assert(result.checksum == 6);
+	std::cout << "testReplayFlagsMismatch passed" << std::endl;
+}
+
+void AttributeTraceUnitTests::testTruncatedTrace()
+{
+	{
+		AttributeTrace::Writer writer(path);
+		writer.Record(writer.NextObject(), AttributeTrace::CallType_SetBase, { AttributeKey_Power, EffectOperation_Invalid, 100000, 0 });
+	}
+	// cut the last record in half
+	{
+		std::FILE* file = std::fopen(path.c_str(), "rb");
+		std::vector<char> bytes(64);
+		bytes.resize(std::fread(bytes.data(), 1, bytes.size(), file));
+		std::fclose(file);
+		file = std::fopen(path.c_str(), "wb");
+		std::fwrite(bytes.data(), 1, bytes.size() - 1, file);
+		std::fclose(file);
+	}
+
+	std::cout << "testTruncatedTrace expects to throw an error..." << std::endl;
+	try
+	{
+		AttributeTrace::Load(path);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+	}
+	std::remove(path.c_str());
+}
+
+void AttributeTraceUnitTests::testCorruptObjectId()
+{
+	{
+		AttributeTrace::Writer writer(path);
+		writer.Record(writer.NextObject(), AttributeTrace::CallType_SetBase, { AttributeKey_Power, EffectOperation_Invalid, 2, 0 });
+	}
+	// append a Clear of object 0xFFFFFFFF, which Replay would have to allocate
+	{
+		std::FILE* file = std::fopen(path.c_str(), "ab");
+		const uint8_t record[] = { AttributeTrace::CallType_Clear, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+		std::fwrite(record, 1, sizeof(record), file);
+		std::fclose(file);
+	}
+
+	std::cout << "testCorruptObjectId expects to throw an error..." << std::endl;
+	[[maybe_unused]] bool rejected = false;
+	try
+	{
+		AttributeTrace::Load(path);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+		rejected = true;
+	}
+	std::remove(path.c_str());
+	assert(rejected);
+}
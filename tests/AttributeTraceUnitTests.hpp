@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+class AttributeTraceUnitTests
+{
+public:
+	AttributeTraceUnitTests() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	// scratch file, removed after every test
+	const std::string path = "AttributeTraceUnitTests.trace";
+
+	// operational tests
+	void testRoundTrip();
+	void testReplayMatchesRecording();
+	void testReplayFlagsMismatch();
+
+	// crash tests
+	void testTruncatedTrace();
+	void testCorruptObjectId();
+};
@@ -0,0 +1,1146 @@
+#include "AttributeWorldUnitTests.hpp"
+#include "../src/ColumnKernels.hpp"
+#include "../src/CountingResource.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/WorkStealingPool.hpp"
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <memory_resource>
+#include <random>
+
+using ReferenceImplementation = LayeredAttributes_v2;
+
+
+void AttributeWorldUnitTests::runOperationalTests()
+{
+	testEntityLifetime();
+	testBatchedRead();
+	testMatchesReference();
+	testUnknownOperations();
+	testColumnKernelsAgree();
+	testMassEffectMatchesReference();
+	testGroupEffects();
+	testGroupEffectsMatchRebuild();
+	testLargeGroupMembership();
+	testRecomputeDirtyMatchesSerial();
+	testExpiringEffectsMatchRebuild();
+	testDistantExpiry();
+	testSourceRemovalMatchesRebuild();
+	testMemoryResource();
+	testClearAllMatchesPerEntityClear();
+	std::cout << "** AttributeWorld operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void AttributeWorldUnitTests::runCrashTests()
+{
+	testStaleEntity();
+	std::cout << "** AttributeWorld crash tests passed **" << std::endl;
+}
+
+void AttributeWorldUnitTests::testEntityLifetime()
+{
+	world = std::make_unique<AttributeWorld>();
+	auto bear = world->CreateEntity();
+	auto elf = world->CreateEntity();
+	assert(world->EntityCount() == 2);
+	world->SetBaseAttribute(bear, AttributeKey_Power, 2);
+	world->AddLayeredEffect(bear, { AttributeKey_Power, EffectOperation_Add, /*modifier*/3, /*layer*/7 });
+	world->SetBaseAttribute(elf, AttributeKey_Power, 1);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 5);
+	assert(world->GetCurrentAttribute(elf, AttributeKey_Power) == 1);
+
+	// a destroyed entity's slot is reused, but its old handle stays dead
+	[[maybe_unused]] bool destroyed = world->DestroyEntity(bear);
+	assert(destroyed);
+	destroyed = world->DestroyEntity(bear);
+	assert(!destroyed);
+	auto token = world->CreateEntity();
+	assert(token.index == bear.index);
+	assert(!world->IsAlive(bear));
+	assert(world->IsAlive(token));
+	assert(world->GetCurrentAttribute(token, AttributeKey_Power) == 0);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == std::numeric_limits<int>::min());
+	world->AddLayeredEffect(bear, { AttributeKey_Power, EffectOperation_Add, /*modifier*/3, /*layer*/7 });
+	assert(world->GetCurrentAttribute(token, AttributeKey_Power) == 0);
+	assert(world->EntityCount() == 2);
+	assert(world->SlotCount() == 2);
+
+	world->AddLayeredEffect(elf, { AttributeKey_Power, EffectOperation_Multiply, /*modifier*/4, /*layer*/3 });
+	world->ClearLayeredEffects(elf);
+	assert(world->GetCurrentAttribute(elf, AttributeKey_Power) == 1);
+	std::cout << "testEntityLifetime passed" << std::endl;
+}
+
+void AttributeWorldUnitTests::testBatchedRead()
+{
+	world = std::make_unique<AttributeWorld>();
+	std::vector<AttributeWorld::Entity> creatures;
+	for (int i = 0; i < 100; ++i)
+	{
+		creatures.push_back(world->CreateEntity());
+		world->SetBaseAttribute(creatures.back(), AttributeKey_Toughness, i);
+	}
+	// an anthem on every other creature, added out of layer order
+	for (size_t i = 0; i < creatures.size(); i += 2)
+	{
+		world->AddLayeredEffect(creatures[i], { AttributeKey_Toughness, EffectOperation_Add, /*modifier*/1, /*layer*/7 });
+		world->AddLayeredEffect(creatures[i], { AttributeKey_Toughness, EffectOperation_Multiply, /*modifier*/2, /*layer*/3 });
+	}
+	world->DestroyEntity(creatures[1]);
+	auto values = world->GetCurrentAttribute(AttributeKey_Toughness, creatures);
+	const auto& column = world->GetCurrentColumn(AttributeKey_Toughness);
+	assert(column.size() == world->SlotCount());
+	for (size_t i = 0; i < creatures.size(); ++i)
+	{
+		int expected = i % 2 == 0 ? static_cast<int>(i) * 2 + 1 : static_cast<int>(i);
+		if (i == 1)
+		{
+			assert(values[i] == std::numeric_limits<int>::min());
+			assert(column[creatures[i].index] == 0);
+		}
+		else
+		{
+			assert(values[i] == expected);
+			assert(column[creatures[i].index] == expected);
+		}
+	}
+	std::cout << "testBatchedRead passed" << std::endl;
+}
+
+// Drives a handful of entities and one reference object per entity with the
+// same random calls and expects every read to agree.
+void AttributeWorldUnitTests::testMatchesReference()
+{
+	world = std::make_unique<AttributeWorld>();
+	const size_t entityCount = 8;
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<std::unique_ptr<ReferenceImplementation>> references;
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+		references.push_back(std::make_unique<ReferenceImplementation>());
+	}
+	std::mt19937 rng(19);
+	std::uniform_int_distribution<int> action(0, 99);
+	std::uniform_int_distribution<size_t> entity(0, entityCount - 1);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 20000; ++step)
+	{
+		int roll = action(rng);
+		size_t target = entity(rng);
+		if (roll < 2)
+		{
+			// the card leaves play and a new one takes its place
+			world->DestroyEntity(entities[target]);
+			entities[target] = world->CreateEntity();
+			references[target] = std::make_unique<ReferenceImplementation>();
+		}
+		else if (roll < 5)
+		{
+			world->ClearLayeredEffects(entities[target]);
+			references[target]->ClearLayeredEffects();
+		}
+		else if (roll < 15)
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			int value = modifier(rng);
+			world->SetBaseAttribute(entities[target], attribute, value);
+			references[target]->SetBaseAttribute(attribute, value);
+		}
+		else if (roll < 55)
+		{
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			world->AddLayeredEffect(entities[target], effect);
+			references[target]->AddLayeredEffect(effect);
+		}
+		else
+		{
+			[[maybe_unused]] AttributeKey attribute = AttributeKey(key(rng));
+			assert(world->GetCurrentAttribute(entities[target], attribute) == references[target]->GetCurrentAttribute(attribute));
+		}
+	}
+	std::cout << "testMatchesReference passed" << std::endl;
+}
+
+// Every kernel this CPU supports must produce the same column as the scalar one,
+// including the tails that do not fill a whole vector.
+// Operations are stored in a byte; ones outside the enum must do nothing, as
+// in the reference, whether added to one entity, many, or a group.
+void AttributeWorldUnitTests::testUnknownOperations()
+{
+	world = std::make_unique<AttributeWorld>();
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<ReferenceImplementation> references(3);
+	for (auto& reference : references)
+	{
+		auto entity = world->CreateEntity();
+		entities.push_back(entity);
+		world->SetBaseAttribute(entity, AttributeKey_Power, 5);
+		reference.SetBaseAttribute(AttributeKey_Power, 5);
+	}
+	auto group = world->CreateGroup();
+	world->AddToGroup(group, entities[2]);
+	const int operations[] = { 257, -255, 256 + EffectOperation_Multiply, 42, -1 };
+	for (int operation : operations)
+	{
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation), /*modifier*/99, /*layer*/1 };
+		world->AddLayeredEffect(entities[0], effect);
+		world->AddLayeredEffect(entities, effect);
+		world->AddGroupEffect(group, effect);
+		references[0].AddLayeredEffect(effect);
+		references[0].AddLayeredEffect(effect);
+		references[1].AddLayeredEffect(effect);
+		references[2].AddLayeredEffect(effect);
+		references[2].AddLayeredEffect(effect);
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			assert(world->GetCurrentAttribute(entities[i], AttributeKey_Power) == references[i].GetCurrentAttribute(AttributeKey_Power));
+			assert(world->GetCurrentAttribute(entities[i], AttributeKey_Power) == 5);
+		}
+	}
+	std::cout << "testUnknownOperations passed" << std::endl;
+}
+
+void AttributeWorldUnitTests::testColumnKernelsAgree()
+{
+	std::mt19937 rng(23);
+	std::uniform_int_distribution<int> value(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+	std::uniform_int_distribution<int> bit(0, 1);
+	for (int operation = EffectOperation_Invalid; operation <= EffectOperation_BitwiseXor; ++operation)
+	{
+		for (size_t count : { 0, 1, 3, 4, 7, 8, 9, 31, 64, 100 })
+		{
+			std::vector<int> values(count);
+			std::vector<uint8_t> mask(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				values[i] = value(rng);
+				mask[i] = static_cast<uint8_t>(bit(rng));
+			}
+			int modification = value(rng);
+			auto expected = values;
+			ColumnKernels::ApplyMasked(ColumnKernels::Level_Scalar, operation, modification, expected.data(), mask.data(), count);
+			for (int level = ColumnKernels::Level_SSE41; level <= ColumnKernels::DetectedLevel(); ++level)
+			{
+				auto actual = values;
+				ColumnKernels::ApplyMasked(ColumnKernels::Level(level), operation, modification, actual.data(), mask.data(), count);
+				assert(actual == expected);
+			}
+		}
+	}
+	std::cout << "testColumnKernelsAgree passed (" << ColumnKernels::LevelName(ColumnKernels::DetectedLevel()) << ")" << std::endl;
+}
+
+// Board-wide effects over random subsets of entities, including repeated and
+// stale handles, compared against one reference object per entity.
+void AttributeWorldUnitTests::testMassEffectMatchesReference()
+{
+	world = std::make_unique<AttributeWorld>();
+	const size_t entityCount = 64;
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<std::unique_ptr<ReferenceImplementation>> references;
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+		references.push_back(std::make_unique<ReferenceImplementation>());
+	}
+	auto stale = world->CreateEntity();
+	world->DestroyEntity(stale);
+	std::mt19937 rng(29);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::uniform_int_distribution<size_t> entity(0, entityCount - 1);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Toughness);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 3000; ++step)
+	{
+		int roll = action(rng);
+		LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		if (roll < 5)
+		{
+			std::vector<AttributeWorld::Entity> targets;
+			for (size_t i = 0; i < entityCount; ++i)
+			{
+				if (roll < 2 || entity(rng) % 3 == 0)
+				{
+					targets.push_back(entities[i]);
+					references[i]->AddLayeredEffect(effect);
+				}
+			}
+			if (roll == 4 && !targets.empty())
+			{
+				size_t repeated = entity(rng) % targets.size();
+				targets.push_back(targets[repeated]);
+				references[targets[repeated].index]->AddLayeredEffect(effect);
+				targets.push_back(stale);
+			}
+			world->AddLayeredEffect(targets, effect);
+		}
+		else if (roll < 7)
+		{
+			size_t target = entity(rng);
+			world->SetBaseAttribute(entities[target], effect.Attribute, effect.Modification);
+			references[target]->SetBaseAttribute(effect.Attribute, effect.Modification);
+		}
+		else if (roll == 7)
+		{
+			size_t target = entity(rng);
+			world->ClearLayeredEffects(entities[target]);
+			references[target]->ClearLayeredEffects();
+		}
+		else
+		{
+			auto values = world->GetCurrentAttribute(effect.Attribute, entities);
+			for (size_t i = 0; i < entityCount; ++i)
+			{
+				assert(values[i] == references[i]->GetCurrentAttribute(effect.Attribute));
+			}
+		}
+	}
+	std::cout << "testMassEffectMatchesReference passed" << std::endl;
+}
+
+void AttributeWorldUnitTests::testGroupEffects()
+{
+	world = std::make_unique<AttributeWorld>();
+	auto bear = world->CreateEntity();
+	auto elf = world->CreateEntity();
+	world->SetBaseAttribute(bear, AttributeKey_Power, 2);
+	world->SetBaseAttribute(elf, AttributeKey_Power, 1);
+	auto creatures = world->CreateGroup();
+	[[maybe_unused]] bool changed = world->AddToGroup(creatures, bear);
+	assert(changed);
+	changed = world->AddToGroup(creatures, bear);
+	assert(!changed);
+	world->AddToGroup(creatures, elf);
+
+	auto anthem = world->AddGroupEffect(creatures, { AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/7 });
+	// a private effect in an earlier layer still applies before the anthem
+	world->AddLayeredEffect(bear, { AttributeKey_Power, EffectOperation_Multiply, /*modifier*/3, /*layer*/3 });
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 2 * 3 + 1);
+	assert(world->GetCurrentAttribute(elf, AttributeKey_Power) == 2);
+
+	// clearing a member's own effects keeps the group's
+	world->ClearLayeredEffects(bear);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 3);
+
+	changed = world->RemoveFromGroup(creatures, elf);
+	assert(changed);
+	assert(world->GetCurrentAttribute(elf, AttributeKey_Power) == 1);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 3);
+
+	changed = world->RemoveGroupEffect(anthem);
+	assert(changed);
+	changed = world->RemoveGroupEffect(anthem);
+	assert(!changed);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 2);
+
+	world->AddGroupEffect(creatures, { AttributeKey_Power, EffectOperation_Set, /*modifier*/0, /*layer*/1 });
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 0);
+	changed = world->DestroyGroup(creatures);
+	assert(changed);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 2);
+	changed = world->AddToGroup(creatures, bear);
+	assert(!changed);
+	auto stale = world->AddGroupEffect(creatures, { AttributeKey_Power, EffectOperation_Set, /*modifier*/0, /*layer*/1 });
+	assert(stale.group.index == AttributeWorld::Group().index);
+	std::cout << "testGroupEffects passed" << std::endl;
+}
+
+// Random group membership, group effects and private effects, compared against
+// a reference rebuilt from every effect that applies to the entity, in the
+// order the effects were added.
+void AttributeWorldUnitTests::testGroupEffectsMatchRebuild()
+{
+	world = std::make_unique<AttributeWorld>();
+	const size_t entityCount = 12;
+	const size_t groupCount = 4;
+	struct Tracked
+	{
+		size_t sequence;
+		LayeredEffectDefinition effect;
+		AttributeWorld::GroupEffect handle;
+	};
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<std::vector<Tracked>> privateEffects(entityCount);
+	std::vector<AttributeWorld::Group> groups;
+	std::vector<std::vector<Tracked>> groupEffects(groupCount);
+	std::vector<std::vector<bool>> membership(groupCount, std::vector<bool>(entityCount));
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+	}
+	for (size_t g = 0; g < groupCount; ++g)
+	{
+		groups.push_back(world->CreateGroup());
+	}
+	size_t sequence = 0;
+	std::mt19937 rng(31);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::uniform_int_distribution<size_t> entity(0, entityCount - 1);
+	std::uniform_int_distribution<size_t> group(0, groupCount - 1);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 4000; ++step)
+	{
+		int roll = action(rng);
+		size_t e = entity(rng);
+		size_t g = group(rng);
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		if (roll < 2)
+		{
+			if (membership[g][e])
+			{
+				world->RemoveFromGroup(groups[g], entities[e]);
+			}
+			else
+			{
+				world->AddToGroup(groups[g], entities[e]);
+			}
+			membership[g][e] = !membership[g][e];
+		}
+		else if (roll < 4)
+		{
+			groupEffects[g].push_back({ sequence++, effect, world->AddGroupEffect(groups[g], effect) });
+		}
+		else if (roll == 4 && !groupEffects[g].empty())
+		{
+			size_t victim = std::uniform_int_distribution<size_t>(0, groupEffects[g].size() - 1)(rng);
+			[[maybe_unused]] bool removed = world->RemoveGroupEffect(groupEffects[g][victim].handle);
+			assert(removed);
+			groupEffects[g].erase(groupEffects[g].begin() + victim);
+		}
+		else if (roll < 8)
+		{
+			world->AddLayeredEffect(entities[e], effect);
+			privateEffects[e].push_back({ sequence++, effect, {} });
+		}
+		else if (roll == 8)
+		{
+			world->ClearLayeredEffects(entities[e]);
+			privateEffects[e].clear();
+		}
+		else
+		{
+			std::map<size_t, LayeredEffectDefinition> applied;
+			for (const auto& tracked : privateEffects[e])
+			{
+				applied[tracked.sequence] = tracked.effect;
+			}
+			for (size_t other = 0; other < groupCount; ++other)
+			{
+				for (const auto& tracked : groupEffects[other])
+				{
+					if (membership[other][e])
+					{
+						applied[tracked.sequence] = tracked.effect;
+					}
+				}
+			}
+			ReferenceImplementation reference;
+			for (const auto& entry : applied)
+			{
+				reference.AddLayeredEffect(entry.second);
+			}
+			assert(world->GetCurrentAttribute(entities[e], AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+		}
+	}
+	std::cout << "testGroupEffectsMatchRebuild passed" << std::endl;
+}
+
+// Gives every entity of a large world several groups, then removes members
+// in random order, destroys some entities and destroys a whole group. Each
+// removal moves another member into the leaving member's place, so this
+// checks that every member can still leave its groups and that each value
+// sums exactly the groups it is still in.
+void AttributeWorldUnitTests::testLargeGroupMembership()
+{
+	world = std::make_unique<AttributeWorld>();
+	const size_t entityCount = 20000;
+	std::vector<AttributeWorld::Entity> entities;
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+	}
+	auto first = world->CreateGroup();
+	auto second = world->CreateGroup();
+	auto third = world->CreateGroup();
+	world->AddGroupEffect(first, { AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/7 });
+	world->AddGroupEffect(second, { AttributeKey_Power, EffectOperation_Add, /*modifier*/2, /*layer*/7 });
+	world->AddGroupEffect(third, { AttributeKey_Power, EffectOperation_Add, /*modifier*/4, /*layer*/7 });
+	for (size_t e = 0; e < entityCount; ++e)
+	{
+		world->AddToGroup(first, entities[e]);
+		world->AddToGroup(second, entities[e]);
+		world->AddToGroup(third, entities[e]);
+	}
+
+	std::vector<size_t> order(entityCount);
+	for (size_t e = 0; e < entityCount; ++e)
+	{
+		order[e] = e;
+	}
+	std::mt19937 rng(47);
+	std::shuffle(order.begin(), order.end(), rng);
+	std::vector<bool> inFirst(entityCount, true);
+	std::vector<bool> inThird(entityCount, true);
+	std::vector<bool> destroyed(entityCount, false);
+	for (size_t i = 0; i < entityCount / 2; ++i)
+	{
+		[[maybe_unused]] bool removed = world->RemoveFromGroup(first, entities[order[i]]);
+		assert(removed);
+		inFirst[order[i]] = false;
+	}
+	std::shuffle(order.begin(), order.end(), rng);
+	for (size_t i = 0; i < entityCount / 3; ++i)
+	{
+		[[maybe_unused]] bool removed = world->RemoveFromGroup(third, entities[order[i]]);
+		assert(removed);
+		inThird[order[i]] = false;
+	}
+	for (size_t i = entityCount / 3; i < entityCount / 3 + entityCount / 10; ++i)
+	{
+		world->DestroyEntity(entities[order[i]]);
+		destroyed[order[i]] = true;
+	}
+	[[maybe_unused]] bool changed = world->DestroyGroup(second);
+	assert(changed);
+	for (size_t e = 0; e < entityCount; ++e)
+	{
+		if (!destroyed[e])
+		{
+			[[maybe_unused]] int expected = (inFirst[e] ? 1 : 0) + (inThird[e] ? 4 : 0);
+			assert(world->GetCurrentAttribute(entities[e], AttributeKey_Power) == expected);
+		}
+	}
+
+	// every remaining member can still leave, and leaving twice is refused
+	std::shuffle(order.begin(), order.end(), rng);
+	for (size_t e : order)
+	{
+		if (!destroyed[e] && inFirst[e])
+		{
+			changed = world->RemoveFromGroup(first, entities[e]);
+			assert(changed);
+			changed = world->RemoveFromGroup(first, entities[e]);
+			assert(!changed);
+		}
+	}
+	changed = world->DestroyGroup(third);
+	assert(changed);
+	for (size_t e = 0; e < entityCount; ++e)
+	{
+		if (!destroyed[e])
+		{
+			assert(world->GetCurrentAttribute(entities[e], AttributeKey_Power) == 0);
+		}
+	}
+	std::cout << "testLargeGroupMembership passed" << std::endl;
+}
+
+// Dirties a few thousand entities (several chunks, some in groups, some
+// destroyed) and recomputes copies of the world with different thread counts;
+// every copy must match the lazily read original.
+void AttributeWorldUnitTests::testRecomputeDirtyMatchesSerial()
+{
+	world = std::make_unique<AttributeWorld>();
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<AttributeWorld::Group> groups;
+	for (size_t i = 0; i < 5000; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+	}
+	for (size_t g = 0; g < 3; ++g)
+	{
+		groups.push_back(world->CreateGroup());
+	}
+	std::mt19937 rng(37);
+	std::uniform_int_distribution<size_t> entity(0, entities.size() - 1);
+	std::uniform_int_distribution<size_t> group(0, groups.size() - 1);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 20000; ++step)
+	{
+		LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		if (step % 50 == 0)
+		{
+			world->AddGroupEffect(groups[group(rng)], effect);
+		}
+		else if (step % 10 == 0)
+		{
+			world->AddToGroup(groups[group(rng)], entities[entity(rng)]);
+		}
+		else if (step % 3 == 0)
+		{
+			world->SetBaseAttribute(entities[entity(rng)], effect.Attribute, effect.Modification);
+		}
+		else
+		{
+			world->AddLayeredEffect(entities[entity(rng)], effect);
+		}
+	}
+	for (size_t i = 0; i < entities.size(); i += 97)
+	{
+		world->DestroyEntity(entities[i]);
+	}
+
+	for (size_t threads : { 1, 2, 3, 8 })
+	{
+		AttributeWorld recomputed = *world;
+		WorkStealingPool pool(threads);
+		recomputed.RecomputeDirty(pool);
+		for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+		{
+			assert(recomputed.GetCurrentColumn(AttributeKey(attribute)) == world->GetCurrentColumn(AttributeKey(attribute)));
+		}
+
+		// every task runs exactly once, however the blocks are stolen
+		std::vector<std::atomic<int>> runs(10007);
+		pool.ParallelFor(runs.size(), [&runs](size_t i) { runs[i].fetch_add(1, std::memory_order_relaxed); });
+		assert(std::all_of(runs.begin(), runs.end(), [](const std::atomic<int>& count) { return count.load() == 1; }));
+	}
+	std::cout << "testRecomputeDirtyMatchesSerial passed" << std::endl;
+}
+
+// Mixes permanent and expiring effects (private, batched and group) with
+// expiries from one tick to beyond the top wheel level, advances time in
+// small and large steps, and compares every entity against a reference
+// rebuilt from the effects that should still be active.
+void AttributeWorldUnitTests::testExpiringEffectsMatchRebuild()
+{
+	world = std::make_unique<AttributeWorld>();
+	const size_t entityCount = 8;
+	const size_t groupedCount = 4;
+	const uint64_t permanent = std::numeric_limits<uint64_t>::max();
+	struct Tracked
+	{
+		size_t sequence;
+		LayeredEffectDefinition effect;
+		uint64_t expiresAt;
+	};
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<std::vector<Tracked>> privateEffects(entityCount);
+	std::vector<Tracked> groupEffects;
+	auto group = world->CreateGroup();
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+		if (i < groupedCount)
+		{
+			world->AddToGroup(group, entities.back());
+		}
+	}
+	size_t sequence = 0;
+	std::mt19937 rng(41);
+	std::uniform_int_distribution<int> action(0, 19);
+	std::uniform_int_distribution<size_t> entity(0, entityCount - 1);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	const uint64_t delays[] = { 1, 2, 5, 63, 64, 65, 100, 4095, 4096, 300000, (uint64_t(1) << 24) + 7 };
+	std::uniform_int_distribution<size_t> delay(0, std::size(delays) - 1);
+	for (int step = 0; step < 3000; ++step)
+	{
+		int roll = action(rng);
+		size_t e = entity(rng);
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		uint64_t expiresAt = world->CurrentTime() + delays[delay(rng)];
+		if (roll < 4)
+		{
+			world->AddLayeredEffect(entities[e], effect, expiresAt);
+			privateEffects[e].push_back({ sequence++, effect, expiresAt });
+		}
+		else if (roll < 6)
+		{
+			world->AddLayeredEffect(entities[e], effect);
+			privateEffects[e].push_back({ sequence++, effect, permanent });
+		}
+		else if (roll == 6)
+		{
+			world->AddLayeredEffect(entities, effect, expiresAt);
+			for (auto& tracked : privateEffects)
+			{
+				tracked.push_back({ sequence, effect, expiresAt });
+			}
+			++sequence;
+		}
+		else if (roll == 7)
+		{
+			world->AddGroupEffect(group, effect, expiresAt);
+			groupEffects.push_back({ sequence++, effect, expiresAt });
+		}
+		else if (roll == 8 && step % 4 == 0)
+		{
+			world->ClearLayeredEffects(entities[e]);
+			privateEffects[e].clear();
+		}
+		else if (roll < 14)
+		{
+			world->AdvanceTime(world->CurrentTime() + (step % 50 == 0 ? 3000000 : std::uniform_int_distribution<uint64_t>(0, 40)(rng)));
+		}
+		else
+		{
+			std::map<size_t, LayeredEffectDefinition> applied;
+			for (const auto& tracked : privateEffects[e])
+			{
+				if (tracked.expiresAt > world->CurrentTime())
+				{
+					applied[tracked.sequence] = tracked.effect;
+				}
+			}
+			for (const auto& tracked : groupEffects)
+			{
+				if (e < groupedCount && tracked.expiresAt > world->CurrentTime())
+				{
+					applied[tracked.sequence] = tracked.effect;
+				}
+			}
+			ReferenceImplementation reference;
+			for (const auto& entry : applied)
+			{
+				reference.AddLayeredEffect(entry.second);
+			}
+			assert(world->GetCurrentAttribute(entities[e], AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+		}
+	}
+	std::cout << "testExpiringEffectsMatchRebuild passed" << std::endl;
+}
+
+// Time jumps over ticks with nothing to expire or cascade, so advancing
+// billions of ticks toward a distant timer must not visit them one by one,
+// and every timer must still expire exactly when its tick is reached.
+void AttributeWorldUnitTests::testDistantExpiry()
+{
+	world = std::make_unique<AttributeWorld>();
+	auto bear = world->CreateEntity();
+	const uint64_t expiries[] = { 3, 2000000000ULL, 2000000001ULL, 50000000000ULL, uint64_t(1) << 40 };
+	int remaining = 0;
+	for (size_t i = 0; i < std::size(expiries); ++i)
+	{
+		world->AddLayeredEffect(bear, { AttributeKey_Power, EffectOperation_Add, /*modifier*/1 << i, /*layer*/1 }, expiries[i]);
+		remaining += 1 << i;
+	}
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == remaining);
+	for (size_t i = 0; i < std::size(expiries); ++i)
+	{
+		world->AdvanceTime(expiries[i] - 1);
+		assert(world->CurrentTime() == expiries[i] - 1);
+		assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == remaining);
+		world->AdvanceTime(expiries[i]);
+		remaining -= 1 << i;
+		assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == remaining);
+	}
+
+	// a timer scheduled after a jump lands relative to the new time
+	world->AddLayeredEffect(bear, { AttributeKey_Power, EffectOperation_Add, /*modifier*/7, /*layer*/1 }, world->CurrentTime() + 4096);
+	world->AdvanceTime(world->CurrentTime() + 4095);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 7);
+	world->AdvanceTime(std::numeric_limits<uint64_t>::max() - 1);
+	assert(world->GetCurrentAttribute(bear, AttributeKey_Power) == 0);
+	std::cout << "testDistantExpiry passed" << std::endl;
+}
+
+// Tags private, batched and group effects with a handful of sources, some of
+// them expiring, mixes in untagged effects, clears, destroyed entities and
+// sources, and removes sources at random. Every read is compared against a
+// reference rebuilt from the effects that should still be in place, and every
+// removal must report exactly the effects of that source still in place.
+void AttributeWorldUnitTests::testSourceRemovalMatchesRebuild()
+{
+	world = std::make_unique<AttributeWorld>();
+	const size_t entityCount = 10;
+	const size_t groupedCount = 5;
+	const size_t sourceCount = 4;
+	const size_t untagged = sourceCount;
+	struct Tracked
+	{
+		size_t sequence;
+		LayeredEffectDefinition effect;
+		size_t source;
+		uint64_t expiresAt;
+	};
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<std::vector<Tracked>> privateEffects(entityCount);
+	std::vector<Tracked> groupEffects;
+	std::vector<AttributeWorld::Source> sources;
+	auto group = world->CreateGroup();
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+		if (i < groupedCount)
+		{
+			world->AddToGroup(group, entities.back());
+		}
+	}
+	for (size_t i = 0; i < sourceCount; ++i)
+	{
+		sources.push_back(world->CreateSource());
+	}
+	auto active = [&](const Tracked& tracked) { return tracked.expiresAt > world->CurrentTime(); };
+	size_t sequence = 0;
+	std::mt19937 rng(43);
+	std::uniform_int_distribution<int> action(0, 19);
+	std::uniform_int_distribution<size_t> entity(0, entityCount - 1);
+	std::uniform_int_distribution<size_t> source(0, sourceCount - 1);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 4000; ++step)
+	{
+		int roll = action(rng);
+		size_t e = entity(rng);
+		size_t s = source(rng);
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		uint64_t expiresAt = step % 3 == 0 ? world->CurrentTime() + 1 + step % 7 : AttributeWorld::Permanent;
+		if (roll < 5)
+		{
+			world->AddLayeredEffect(entities[e], effect, sources[s], expiresAt);
+			privateEffects[e].push_back({ sequence++, effect, s, expiresAt });
+		}
+		else if (roll == 5)
+		{
+			world->AddLayeredEffect(entities[e], effect);
+			privateEffects[e].push_back({ sequence++, effect, untagged, AttributeWorld::Permanent });
+		}
+		else if (roll == 6)
+		{
+			world->AddLayeredEffect(entities, effect, sources[s], expiresAt);
+			for (auto& tracked : privateEffects)
+			{
+				tracked.push_back({ sequence, effect, s, expiresAt });
+			}
+			++sequence;
+		}
+		else if (roll == 7)
+		{
+			world->AddGroupEffect(group, effect, sources[s], expiresAt);
+			groupEffects.push_back({ sequence++, effect, s, expiresAt });
+		}
+		else if (roll == 8)
+		{
+			size_t expected = 0;
+			for (auto& tracked : privateEffects)
+			{
+				expected += std::count_if(tracked.begin(), tracked.end(), [&](const Tracked& t) { return t.source == s && active(t); });
+				tracked.erase(std::remove_if(tracked.begin(), tracked.end(), [&](const Tracked& t) { return t.source == s; }), tracked.end());
+			}
+			expected += std::count_if(groupEffects.begin(), groupEffects.end(), [&](const Tracked& t) { return t.source == s && active(t); });
+			groupEffects.erase(std::remove_if(groupEffects.begin(), groupEffects.end(), [&](const Tracked& t) { return t.source == s; }), groupEffects.end());
+			if (step % 2 == 0)
+			{
+				[[maybe_unused]] size_t removed = world->RemoveEffectsFromSource(sources[s]);
+				assert(removed == expected);
+			}
+			else
+			{
+				[[maybe_unused]] bool destroyed = world->DestroySource(sources[s]);
+				assert(destroyed);
+				assert(world->RemoveEffectsFromSource(sources[s]) == 0);
+				sources[s] = world->CreateSource();
+			}
+		}
+		else if (roll == 9 && step % 3 == 0)
+		{
+			world->ClearLayeredEffects(entities[e]);
+			privateEffects[e].clear();
+		}
+		else if (roll == 10 && step % 5 == 0 && e >= groupedCount)
+		{
+			world->DestroyEntity(entities[e]);
+			entities[e] = world->CreateEntity();
+			privateEffects[e].clear();
+		}
+		else if (roll < 13)
+		{
+			world->AdvanceTime(world->CurrentTime() + std::uniform_int_distribution<uint64_t>(0, 3)(rng));
+		}
+		else
+		{
+			std::map<size_t, LayeredEffectDefinition> applied;
+			for (const auto& tracked : privateEffects[e])
+			{
+				if (active(tracked))
+				{
+					applied[tracked.sequence] = tracked.effect;
+				}
+			}
+			for (const auto& tracked : groupEffects)
+			{
+				if (e < groupedCount && active(tracked))
+				{
+					applied[tracked.sequence] = tracked.effect;
+				}
+			}
+			ReferenceImplementation reference;
+			for (const auto& entry : applied)
+			{
+				reference.AddLayeredEffect(entry.second);
+			}
+			assert(world->GetCurrentAttribute(entities[e], AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+		}
+	}
+	std::cout << "testSourceRemovalMatchesRebuild passed" << std::endl;
+}
+
+// Drives a world on a counting resource, one on an arena and one on the heap
+// with the same calls while the default resource refuses to allocate, so
+// every container has to be on the world's resource. Every read must agree,
+// the counted world must give back everything it allocated, and the arena
+// must hold on to its memory until release().
+void AttributeWorldUnitTests::testMemoryResource()
+{
+	auto drive = [](AttributeWorld& world)
+	{
+		std::vector<int> reads;
+		std::vector<AttributeWorld::Entity> entities;
+		for (int i = 0; i < 200; ++i)
+		{
+			entities.push_back(world.CreateEntity());
+		}
+		auto group = world.CreateGroup();
+		auto source = world.CreateSource();
+		std::mt19937 rng(44);
+		std::uniform_int_distribution<int> action(0, 9);
+		std::uniform_int_distribution<size_t> entity(0, entities.size() - 1);
+		std::uniform_int_distribution<int> attribute(AttributeKey_Power, AttributeKey_Controller);
+		std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+		std::uniform_int_distribution<int> modifier(-3, 3);
+		std::uniform_int_distribution<int> layer(0, 7);
+		for (int step = 0; step < 5000; ++step)
+		{
+			int roll = action(rng);
+			size_t e = entity(rng);
+			LayeredEffectDefinition effect{ AttributeKey(attribute(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			uint64_t expiresAt = step % 2 == 0 ? world.CurrentTime() + 1 + step % 70 : AttributeWorld::Permanent;
+			if (roll < 3)
+			{
+				world.AddLayeredEffect(entities[e], effect, source, expiresAt);
+			}
+			else if (roll == 3)
+			{
+				world.AddLayeredEffect(entities, effect, expiresAt);
+			}
+			else if (roll == 4)
+			{
+				world.AddToGroup(group, entities[e]);
+				world.AddGroupEffect(group, effect, expiresAt);
+			}
+			else if (roll == 5 && step % 50 == 0)
+			{
+				world.RemoveEffectsFromSource(source);
+				world.DestroyEntity(entities[e]);
+				entities[e] = world.CreateEntity();
+			}
+			else if (roll == 6)
+			{
+				world.AdvanceTime(world.CurrentTime() + 1);
+			}
+			else
+			{
+				reads.push_back(world.GetCurrentAttribute(entities[e], effect.Attribute));
+			}
+		}
+		world.RecomputeDirty();
+		for (size_t a = AttributeKey_Power; a <= AttributeKey_Controller; ++a)
+		{
+			const auto& column = world.GetCurrentColumn(AttributeKey(a));
+			reads.insert(reads.end(), column.begin(), column.end());
+		}
+		return reads;
+	};
+
+	std::pmr::memory_resource* previousDefault = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+	AttributeWorld heapWorld(false, false, std::pmr::new_delete_resource());
+	std::vector<int> expected = drive(heapWorld);
+
+	CountingResource counting;
+	world = std::make_unique<AttributeWorld>(false, false, &counting);
+	assert(drive(*world) == expected);
+	assert(counting.Allocations() > 0);
+	world.reset();
+	assert(counting.BytesInUse() == 0);
+	assert(counting.Deallocations() == counting.Allocations());
+
+	CountingResource arenaUpstream;
+	{
+		std::pmr::monotonic_buffer_resource arena(&arenaUpstream);
+		world = std::make_unique<AttributeWorld>(false, false, &arena);
+		assert(drive(*world) == expected);
+		world.reset();
+		// destroying the world gave nothing back, the arena frees it all at once
+		assert(arenaUpstream.BytesInUse() > 0);
+		arena.release();
+		assert(arenaUpstream.BytesInUse() == 0);
+		assert(arenaUpstream.Allocations() < counting.Allocations() / 10);
+	}
+	std::pmr::set_default_resource(previousDefault);
+	std::cout << "testMemoryResource passed" << std::endl;
+}
+
+// Plays turns on two worlds with the same calls; at the end of every turn one
+// clears each entity and the other calls ClearAllLayeredEffects. Reads,
+// columns and a parallel recompute must agree, including for entities in
+// groups, effects that expire or are removed by source after the clear, and
+// slots reused since. Once a turn has warmed up, turns that only add and
+// read must not allocate.
+void AttributeWorldUnitTests::testClearAllMatchesPerEntityClear()
+{
+	AttributeWorld eachEntity;
+	world = std::make_unique<AttributeWorld>();
+	std::vector<AttributeWorld::Entity> entities;
+	std::vector<AttributeWorld::Entity> eachEntities;
+	for (int i = 0; i < 3000; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+		eachEntities.push_back(eachEntity.CreateEntity());
+	}
+	auto group = world->CreateGroup();
+	auto eachGroup = eachEntity.CreateGroup();
+	auto source = world->CreateSource();
+	auto eachSource = eachEntity.CreateSource();
+	std::mt19937 rng(45);
+	std::uniform_int_distribution<size_t> entity(0, entities.size() - 1);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	WorkStealingPool pool(3);
+	for (int turn = 0; turn < 20; ++turn)
+	{
+		for (int step = 0; step < 2000; ++step)
+		{
+			size_t e = entity(rng);
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			uint64_t expiresAt = world->CurrentTime() + 1 + step % 40;
+			switch (step % 10)
+			{
+			case 0:
+				world->AddToGroup(group, entities[e]);
+				eachEntity.AddToGroup(eachGroup, eachEntities[e]);
+				world->AddGroupEffect(group, effect);
+				eachEntity.AddGroupEffect(eachGroup, effect);
+				break;
+			case 1:
+				world->AddLayeredEffect(entities[e], effect, source, expiresAt);
+				eachEntity.AddLayeredEffect(eachEntities[e], effect, eachSource, expiresAt);
+				break;
+			case 2:
+				world->SetBaseAttribute(entities[e], effect.Attribute, effect.Modification);
+				eachEntity.SetBaseAttribute(eachEntities[e], effect.Attribute, effect.Modification);
+				break;
+			case 3:
+				world->AdvanceTime(world->CurrentTime() + 1);
+				eachEntity.AdvanceTime(eachEntity.CurrentTime() + 1);
+				break;
+			case 4:
+				if (step % 500 == 4)
+				{
+					world->DestroyEntity(entities[e]);
+					eachEntity.DestroyEntity(eachEntities[e]);
+					entities[e] = world->CreateEntity();
+					eachEntities[e] = eachEntity.CreateEntity();
+				}
+				break;
+			case 5:
+				assert(world->GetCurrentAttribute(entities[e], effect.Attribute) == eachEntity.GetCurrentAttribute(eachEntities[e], effect.Attribute));
+				break;
+			default:
+				world->AddLayeredEffect(entities[e], effect);
+				eachEntity.AddLayeredEffect(eachEntities[e], effect);
+				break;
+			}
+		}
+		if (turn % 5 == 4)
+		{
+			assert(world->RemoveEffectsFromSource(source) == eachEntity.RemoveEffectsFromSource(eachSource));
+		}
+		if (turn % 3 == 0)
+		{
+			world->RecomputeDirty(pool);
+		}
+		world->ClearAllLayeredEffects();
+		for (const auto& each : eachEntities)
+		{
+			eachEntity.ClearLayeredEffects(each);
+		}
+		if (turn % 2 == 0)
+		{
+			for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+			{
+				assert(world->GetCurrentColumn(AttributeKey(attribute)) == eachEntity.GetCurrentColumn(AttributeKey(attribute)));
+			}
+		}
+	}
+	world->RecomputeDirty(pool);
+	for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+	{
+		assert(world->GetCurrentColumn(AttributeKey(attribute)) == eachEntity.GetCurrentColumn(AttributeKey(attribute)));
+	}
+
+	// the same turn over and over reuses the stacks the clear left behind
+	CountingResource counting;
+	world = std::make_unique<AttributeWorld>(false, false, &counting);
+	entities.clear();
+	for (int i = 0; i < 1000; ++i)
+	{
+		entities.push_back(world->CreateEntity());
+	}
+	[[maybe_unused]] uint64_t warmedUp = 0;
+	for (int turn = 0; turn < 5; ++turn)
+	{
+		std::mt19937 turnRng(46);
+		for (int step = 0; step < 5000; ++step)
+		{
+			size_t e = entity(turnRng) % entities.size();
+			LayeredEffectDefinition effect{ AttributeKey(key(turnRng)), EffectOperation(operation(turnRng)), modifier(turnRng), layer(turnRng) };
+			world->AddLayeredEffect(entities[e], effect);
+			world->GetCurrentAttribute(entities[e], effect.Attribute);
+		}
+		world->ClearAllLayeredEffects();
+		if (turn == 0)
+		{
+			warmedUp = counting.Allocations();
+		}
+	}
+	assert(counting.Allocations() == warmedUp);
+	for ([[maybe_unused]] const auto& each : entities)
+	{
+		assert(world->GetCurrentAttribute(each, AttributeKey_Power) == 0);
+	}
+	// the world must not outlive the resource it allocates from
+	world.reset();
+	std::cout << "testClearAllMatchesPerEntityClear passed" << std::endl;
+}
+
+void AttributeWorldUnitTests::testStaleEntity()
+{
+	world = std::make_unique<AttributeWorld>();
+	auto entity = world->CreateEntity();
+	world->DestroyEntity(entity);
+	world->SetBaseAttribute(entity, AttributeKey_Power, 2);
+	assert(world->GetCurrentAttribute(AttributeWorld::Entity(), AttributeKey_Power) == std::numeric_limits<int>::min());
+
+	std::cout << "testStaleEntity expects to throw an error..." << std::endl;
+	world = std::make_unique<AttributeWorld>(true, true);
+	try
+	{
+		world->SetBaseAttribute(entity, AttributeKey_Power, 2);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+	}
+}
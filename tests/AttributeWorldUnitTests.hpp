@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include "../src/AttributeWorld.hpp"
+
+class AttributeWorldUnitTests
+{
+public:
+	AttributeWorldUnitTests() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	std::unique_ptr<AttributeWorld> world;
+
+	// operational tests
+	void testEntityLifetime();
+	void testBatchedRead();
+	void testMatchesReference();
+	void testUnknownOperations();
+	void testColumnKernelsAgree();
+	void testMassEffectMatchesReference();
+	void testGroupEffects();
+	void testGroupEffectsMatchRebuild();
+	void testLargeGroupMembership();
+	void testRecomputeDirtyMatchesSerial();
+	void testExpiringEffectsMatchRebuild();
+	void testDistantExpiry();
+	void testSourceRemovalMatchesRebuild();
+	void testMemoryResource();
+	void testClearAllMatchesPerEntityClear();
+
+	// crash tests
+	void testStaleEntity();
+};
@@ -0,0 +1,243 @@
+#include "DerivedAttributesUnitTests.hpp"
+#include "../src/DerivedAttributes.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include <assert.h>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using ReferenceImplementation = LayeredAttributes_v2;
+using DerivedAttribute = DerivedAttributes::DerivedAttribute;
+
+
+void DerivedAttributesUnitTests::runOperationalTests()
+{
+	testDerivedValue();
+	testEarlyCutoff();
+	testChain();
+	testClearLayeredEffects();
+	testCollectChanged();
+	testMatchesPolling();
+	std::cout << "** DerivedAttributes operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void DerivedAttributesUnitTests::runCrashTests()
+{
+	testUnknownInput();
+	std::cout << "** DerivedAttributes crash tests passed **" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testDerivedValue()
+{
+	ReferenceImplementation engine;
+	DerivedAttributes bear(engine);
+	bear.SetBaseAttribute(AttributeKey_Power, 2);
+	bear.SetBaseAttribute(AttributeKey_Toughness, 2);
+	[[maybe_unused]] DerivedAttribute total = bear.AddDerivedAttribute({ AttributeKey_Power, AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] + inputs[1]; });
+	assert(bear.GetDerivedAttribute(total) == 4);
+	bear.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/3, /*layer*/7 });
+	assert(bear.GetCurrentAttribute(AttributeKey_Power) == 5);
+	assert(engine.GetCurrentAttribute(AttributeKey_Power) == 5);
+	assert(bear.GetDerivedAttribute(total) == 7);
+	bear.SetBaseAttribute(AttributeKey_Toughness, 4);
+	assert(bear.GetDerivedAttribute(total) == 9);
+	std::cout << "testDerivedValue passed" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testEarlyCutoff()
+{
+	ReferenceImplementation engine;
+	DerivedAttributes bear(engine);
+	bear.SetBaseAttribute(AttributeKey_Toughness, 3);
+	[[maybe_unused]] DerivedAttribute lethal = bear.AddDerivedAttribute({ AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] <= 0 ? 1 : 0; });
+	assert(bear.GetDerivedAttribute(lethal) == 0);
+	assert(bear.EvaluationCount() == 1);
+
+	// an unrelated attribute never reaches the derived attribute
+	bear.SetBaseAttribute(AttributeKey_Power, 5);
+	bear.AddLayeredEffect({ AttributeKey_Color, EffectOperation_BitwiseOr, /*modifier*/4, /*layer*/5 });
+	assert(bear.GetDerivedAttribute(lethal) == 0);
+	assert(bear.EvaluationCount() == 1);
+
+	// Toughness is written but ends where it was, so nothing is re-evaluated
+	bear.AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Add, /*modifier*/0, /*layer*/7 });
+	bear.SetBaseAttribute(AttributeKey_Toughness, 3);
+	assert(bear.GetDerivedAttribute(lethal) == 0);
+	assert(bear.EvaluationCount() == 1);
+
+	bear.AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Subtract, /*modifier*/3, /*layer*/7 });
+	assert(bear.GetDerivedAttribute(lethal) == 1);
+	assert(bear.EvaluationCount() == 2);
+	std::cout << "testEarlyCutoff passed" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testChain()
+{
+	ReferenceImplementation engine;
+	DerivedAttributes bear(engine);
+	bear.SetBaseAttribute(AttributeKey_Power, 2);
+	bear.SetBaseAttribute(AttributeKey_Toughness, 3);
+	DerivedAttribute power = bear.AddDerivedAttribute({ AttributeKey_Power },
+		[](const std::vector<int>& inputs) { return inputs[0] > 0 ? inputs[0] : 0; });
+	DerivedAttribute toughness = bear.AddDerivedAttribute({ AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] > 0 ? inputs[0] : 0; });
+	[[maybe_unused]] DerivedAttribute stronger = bear.AddDerivedAttribute({ power, toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] > inputs[1] ? 1 : 0; });
+	assert(bear.GetDerivedAttribute(stronger) == 0);
+	assert(bear.EvaluationCount() == 3);
+
+	// power clamps to 0 instead of 2, so stronger is re-evaluated and stays 0
+	bear.SetBaseAttribute(AttributeKey_Power, -1);
+	assert(bear.GetDerivedAttribute(stronger) == 0);
+	assert(bear.GetDerivedAttribute(power) == 0);
+	assert(bear.EvaluationCount() == 5);
+
+	// -1 to -4 clamps to 0 again, so the chain stops at power
+	bear.SetBaseAttribute(AttributeKey_Power, -4);
+	assert(bear.GetDerivedAttribute(stronger) == 0);
+	assert(bear.EvaluationCount() == 6);
+
+	bear.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/9, /*layer*/7 });
+	assert(bear.GetDerivedAttribute(stronger) == 1);
+	assert(bear.EvaluationCount() == 8);
+	std::cout << "testChain passed" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testClearLayeredEffects()
+{
+	ReferenceImplementation engine;
+	DerivedAttributes bear(engine);
+	bear.SetBaseAttribute(AttributeKey_Power, 1);
+	[[maybe_unused]] DerivedAttribute doubled = bear.AddDerivedAttribute({ AttributeKey_Power },
+		[](const std::vector<int>& inputs) { return inputs[0] * 2; });
+	bear.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/4, /*layer*/7 });
+	assert(bear.GetDerivedAttribute(doubled) == 10);
+	bear.ClearLayeredEffects();
+	assert(bear.GetDerivedAttribute(doubled) == 2);
+	std::cout << "testClearLayeredEffects passed" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testCollectChanged()
+{
+	ReferenceImplementation engine;
+	DerivedAttributes bear(engine);
+	bear.SetBaseAttribute(AttributeKey_Toughness, 2);
+	[[maybe_unused]] DerivedAttribute lethal = bear.AddDerivedAttribute({ AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] <= 0 ? 1 : 0; });
+	[[maybe_unused]] DerivedAttribute total = bear.AddDerivedAttribute({ AttributeKey_Power, AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] + inputs[1]; });
+
+	// a new derived attribute is reported once
+	std::vector<DerivedAttribute> changed;
+	bear.CollectChangedDerivedAttributes(changed);
+	assert(changed.size() == 2);
+	assert(changed[0].index == lethal.index && changed[1].index == total.index);
+	changed.clear();
+	bear.CollectChangedDerivedAttributes(changed);
+	assert(changed.empty());
+
+	// total changes, lethal does not
+	bear.AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Subtract, /*modifier*/1, /*layer*/7 });
+	bear.CollectChangedDerivedAttributes(changed);
+	assert(changed.size() == 1 && changed[0].index == total.index);
+	changed.clear();
+
+	// a change that is undone before the check is not reported
+	bear.SetBaseAttribute(AttributeKey_Power, 3);
+	bear.SetBaseAttribute(AttributeKey_Power, 0);
+	bear.CollectChangedDerivedAttributes(changed);
+	assert(changed.empty());
+
+	bear.AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Subtract, /*modifier*/1, /*layer*/7 });
+	bear.CollectChangedDerivedAttributes(changed);
+	assert(changed.size() == 2);
+	assert(bear.GetDerivedAttribute(lethal) == 1);
+	std::cout << "testCollectChanged passed" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testMatchesPolling()
+{
+	// random calls, checking every derived attribute against a recomputation
+	ReferenceImplementation engine;
+	DerivedAttributes card(engine);
+	std::vector<DerivedAttribute> derived;
+	derived.push_back(card.AddDerivedAttribute({ AttributeKey_Power, AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] - inputs[1]; }));
+	derived.push_back(card.AddDerivedAttribute({ AttributeKey_Toughness },
+		[](const std::vector<int>& inputs) { return inputs[0] <= 0 ? 1 : 0; }));
+	derived.push_back(card.AddDerivedAttribute({ derived[0], AttributeKey_Color },
+		[](const std::vector<int>& inputs) { return (inputs[0] > 0 ? 1 : 0) | (inputs[1] & 6); }));
+	[[maybe_unused]] auto poll = [&engine](size_t index)
+	{
+		int power = engine.GetCurrentAttribute(AttributeKey_Power);
+		int toughness = engine.GetCurrentAttribute(AttributeKey_Toughness);
+		int color = engine.GetCurrentAttribute(AttributeKey_Color);
+		if (index == 0) return power - toughness;
+		if (index == 1) return toughness <= 0 ? 1 : 0;
+		return (power - toughness > 0 ? 1 : 0) | (color & 6);
+	};
+
+	std::mt19937 rng(29);
+	std::uniform_int_distribution<int> call(0, 99);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(1, 7);
+	std::vector<int> collected(derived.size(), 0);
+	std::vector<DerivedAttribute> changed;
+	for (int i = 0; i < 5000; ++i)
+	{
+		int roll = call(rng);
+		AttributeKey attribute = static_cast<AttributeKey>(key(rng));
+		if (roll < 30)
+		{
+			card.SetBaseAttribute(attribute, modifier(rng));
+		}
+		else if (roll < 85)
+		{
+			card.AddLayeredEffect({ attribute, static_cast<EffectOperation>(operation(rng)), modifier(rng), layer(rng) });
+		}
+		else if (roll < 87)
+		{
+			card.ClearLayeredEffects();
+		}
+		else
+		{
+			// a state-based-action check
+			changed.clear();
+			card.CollectChangedDerivedAttributes(changed);
+			for (DerivedAttribute attributeChanged : changed)
+			{
+				collected[attributeChanged.index] = card.GetDerivedAttribute(attributeChanged);
+			}
+			for (size_t d = 0; d < derived.size(); ++d)
+			{
+				assert(collected[d] == poll(d));
+				assert(card.GetDerivedAttribute(derived[d]) == poll(d));
+			}
+		}
+	}
+	std::cout << "testMatchesPolling passed" << std::endl;
+}
+
+void DerivedAttributesUnitTests::testUnknownInput()
+{
+	ReferenceImplementation engine;
+	DerivedAttributes bear(engine);
+	std::cout << "testUnknownInput expects to throw an error..." << std::endl;
+	try
+	{
+		// a derived attribute of another object is not an input of this one
+		DerivedAttributes other(engine);
+		other.AddDerivedAttribute({ AttributeKey_Power }, [](const std::vector<int>& inputs) { return inputs[0]; });
+		DerivedAttribute foreign = other.AddDerivedAttribute({ AttributeKey_Power }, [](const std::vector<int>& inputs) { return inputs[0]; });
+		bear.AddDerivedAttribute({ foreign }, [](const std::vector<int>& inputs) { return inputs[0]; });
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+	}
+}
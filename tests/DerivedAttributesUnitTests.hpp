@@ -0,0 +1,21 @@
+#pragma once
+
+class DerivedAttributesUnitTests
+{
+public:
+	DerivedAttributesUnitTests() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	// operational tests
+	void testDerivedValue();
+	void testEarlyCutoff();
+	void testChain();
+	void testClearLayeredEffects();
+	void testCollectChanged();
+	void testMatchesPolling();
+
+	// crash tests
+	void testUnknownInput();
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <memory>
+#include "../src/ILayeredAttributes.hpp"
+
+class LayeredAttributesUnitTests_v1
+{
+public:
+	LayeredAttributesUnitTests_v1() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	std::unique_ptr<ILayeredAttributes> attributes;
+
+	// operational tests
+	void testClearLayeredEffects();
+	void testRepeatedClears();
+	void testMatchesReference();
+
+	// crash tests
+	void testOutOfBounds();
+};
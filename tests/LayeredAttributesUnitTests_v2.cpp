@@ -1,8 +1,12 @@
 #include "LayeredAttributesUnitTests_v2.hpp"
 #include "../src/LayeredAttributes_v1.hpp"
 #include "../src/LayeredAttributes_v2.hpp"
+#include "../src/CountingResource.hpp"
 #include <assert.h>
+#include <climits>
 #include <iostream>
+#include <memory_resource>
+#include <vector>
 
 //using Implementation = LayeredAttributes_v1;
 using Implementation = LayeredAttributes_v2;
@@ -16,6 +20,10 @@ void LayeredAttributesUnitTests_v2::runOperationalTests()
 	testConsolidation();
 	testComplexAdd_v1();
 	testComplexAdd_v2();
+	testMemoryResource();
+	testClearReusesStorage();
+	testInlineEffects();
+	testPackedEffects();
 	std::cout << "** Operational tests passed **" << std::endl;
 }
 
@@ -231,6 +239,187 @@ void LayeredAttributesUnitTests_v2::testComplexAdd_v2()
 	std::cout << "testComplexAdd_v2 passed" << std::endl;
 }
 
+// Every map and effect vector must allocate from the resource passed in:
+// the default resource refuses to allocate meanwhile. A counted object gives
+// everything back when destroyed; objects on an arena give nothing back
+// until the arena is released. Only LayeredAttributes_v2 takes a resource.
+void LayeredAttributesUnitTests_v2::testMemoryResource()
+{
+	std::vector<LayeredEffectDefinition> effects;
+	for (int i = 0; i < 300; ++i)
+	{
+		effects.push_back({ AttributeKey(AttributeKey_Power + i % 4), EffectOperation(EffectOperation_Set + i % 7), /*modifier*/i % 5 - 2, /*layer*/(i * 7) % 11 });
+	}
+	auto drive = [&effects](LayeredAttributes_v2& object)
+	{
+		std::vector<int> reads;
+		object.SetBaseAttribute(AttributeKey_Power, 2);
+		for (size_t i = 0; i < effects.size(); ++i)
+		{
+			object.AddLayeredEffect(effects[i]);
+			reads.push_back(object.GetCurrentAttribute(effects[i].Attribute));
+			if (i == effects.size() / 2)
+			{
+				object.ClearLayeredEffects();
+			}
+		}
+		return reads;
+	};
+
+	std::pmr::memory_resource* previousDefault = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+	LayeredAttributes_v2 heapObject(false, 10, std::pmr::new_delete_resource());
+	std::vector<int> expected = drive(heapObject);
+
+	CountingResource counting;
+	attributes = std::make_unique<LayeredAttributes_v2>(false, 10, &counting);
+	assert(drive(static_cast<LayeredAttributes_v2&>(*attributes)) == expected);
+	assert(counting.Allocations() > 0);
+	attributes.reset();
+	assert(counting.BytesInUse() == 0);
+	assert(counting.Deallocations() == counting.Allocations());
+
+	CountingResource arenaUpstream;
+	{
+		std::pmr::monotonic_buffer_resource arena(&arenaUpstream);
+		std::vector<std::unique_ptr<LayeredAttributes_v2>> game;
+		for (int i = 0; i < 20; ++i)
+		{
+			game.push_back(std::make_unique<LayeredAttributes_v2>(false, 10, &arena));
+			assert(drive(*game.back()) == expected);
+		}
+		game.clear();
+		assert(arenaUpstream.BytesInUse() > 0);
+		arena.release();
+		assert(arenaUpstream.BytesInUse() == 0);
+		assert(arenaUpstream.Allocations() < counting.Allocations());
+	}
+	std::pmr::set_default_resource(previousDefault);
+	std::cout << "testMemoryResource passed" << std::endl;
+}
+
+// Plays the same turn several times with a clear after each. Every turn must
+// read the same values as the first, which a stack left over from the turn
+// before would change, and once the first turn has grown the stacks no
+// later turn may allocate.
+void LayeredAttributesUnitTests_v2::testClearReusesStorage()
+{
+	std::vector<LayeredEffectDefinition> turn;
+	for (int i = 0; i < 60; ++i)
+	{
+		turn.push_back({ AttributeKey(AttributeKey_Power + i % 5), EffectOperation(EffectOperation_Set + (i * 3) % 7), /*modifier*/i % 7 - 3, /*layer*/(i * 5) % 9 });
+	}
+	CountingResource counting;
+	LayeredAttributes_v2 object(false, 10, &counting);
+	object.SetBaseAttribute(AttributeKey_Power, 3);
+	object.SetBaseAttribute(AttributeKey_Toughness, 4);
+	std::vector<int> firstTurn;
+	[[maybe_unused]] uint64_t warmedUp = 0;
+	for (int repetition = 0; repetition < 5; ++repetition)
+	{
+		std::vector<int> reads;
+		for (const auto& effect : turn)
+		{
+			object.AddLayeredEffect(effect);
+			reads.push_back(object.GetCurrentAttribute(effect.Attribute));
+		}
+		object.ClearLayeredEffects();
+		assert(object.GetCurrentAttribute(AttributeKey_Power) == 3);
+		assert(object.GetCurrentAttribute(AttributeKey_Toughness) == 4);
+		assert(object.GetCurrentAttribute(AttributeKey_Loyalty) == 0);
+		if (repetition == 0)
+		{
+			firstTurn = reads;
+			warmedUp = counting.Allocations();
+		}
+		assert(reads == firstTurn);
+	}
+	assert(counting.Allocations() == warmedUp);
+	std::cout << "testClearReusesStorage passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v2::testInlineEffects()
+{
+	const int inlineEffects = static_cast<int>(LayeredAttributes_v2::InlineEffects);
+	CountingResource counting;
+	LayeredAttributes_v2 object(false, 10, &counting);
+	object.SetBaseAttribute(AttributeKey_Power, 1);
+	// one effect per layer, so none of them merge
+	object.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/0 });
+	assert(object.GetCurrentAttribute(AttributeKey_Power) == 2);
+	[[maybe_unused]] uint64_t nodes = counting.Allocations();
+	for (int layer = 1; layer < inlineEffects; ++layer)
+	{
+		object.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/layer });
+		assert(object.GetCurrentAttribute(AttributeKey_Power) == 2 + layer);
+	}
+	if (inlineEffects > 0)
+	{
+		// the stack fits inline until one effect more than that, when its
+		// keys and its modifications both spill
+		assert(counting.Allocations() == nodes);
+		object.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/inlineEffects });
+		assert(counting.Allocations() == nodes + 2);
+	}
+	assert(object.GetCurrentAttribute(AttributeKey_Power) == 2 + inlineEffects);
+	// effects that sort before the spilled ones still land in layer order
+	object.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/10, /*layer*/0 });
+	assert(object.GetCurrentAttribute(AttributeKey_Power) == 10 + inlineEffects);
+
+	// copies take both inline and spilled stacks with them
+	object.AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Add, /*modifier*/2, /*layer*/1 });
+	LayeredAttributes_v2 copy = object;
+	object.ClearLayeredEffects();
+	assert(object.GetCurrentAttribute(AttributeKey_Power) == 1);
+	assert(object.GetCurrentAttribute(AttributeKey_Toughness) == 0);
+	assert(copy.GetCurrentAttribute(AttributeKey_Power) == 10 + inlineEffects);
+	assert(copy.GetCurrentAttribute(AttributeKey_Toughness) == 2);
+	std::cout << "testInlineEffects passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v2::testPackedEffects()
+{
+	// negative layers sort before layer 0, whenever they were added
+	LayeredAttributes_v2 layers;
+	layers.SetBaseAttribute(AttributeKey_Power, 2);
+	layers.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/0 });
+	layers.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/5, /*layer*/-1 });
+	layers.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Multiply, /*modifier*/2, /*layer*/INT_MIN });
+	layers.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Subtract, /*modifier*/3, /*layer*/INT_MAX });
+	assert(layers.GetCurrentAttribute(AttributeKey_Power) == 5 + 1 - 3);
+	// operations outside the enum do nothing
+	layers.AddLayeredEffect({ AttributeKey_Power, EffectOperation(42), /*modifier*/7, /*layer*/1 });
+	assert(layers.GetCurrentAttribute(AttributeKey_Power) == 3);
+
+	// renumbering timestamps at any point changes no value
+	std::vector<LayeredEffectDefinition> turn;
+	for (int i = 0; i < 200; ++i)
+	{
+		turn.push_back({ AttributeKey(AttributeKey_Power + i % 4), EffectOperation(EffectOperation_Set + (i * 5) % 7), /*modifier*/i % 9 - 4, /*layer*/(i * 7) % 5 - 2 });
+	}
+	LayeredAttributes_v2 renumbered;
+	LayeredAttributes_v2 reference;
+	for (int repetition = 0; repetition < 3; ++repetition)
+	{
+		for (size_t i = 0; i < turn.size(); ++i)
+		{
+			renumbered.AddLayeredEffect(turn[i]);
+			reference.AddLayeredEffect(turn[i]);
+			if (i % 37 == 0)
+			{
+				renumbered.RenumberTimestamps();
+			}
+			for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Color; ++attribute)
+			{
+				assert(renumbered.GetCurrentAttribute(AttributeKey(attribute)) == reference.GetCurrentAttribute(AttributeKey(attribute)));
+			}
+		}
+		renumbered.ClearLayeredEffects();
+		reference.ClearLayeredEffects();
+		renumbered.RenumberTimestamps();
+	}
+	std::cout << "testPackedEffects passed" << std::endl;
+}
+
 void LayeredAttributesUnitTests_v2::testZeroReservation()
 {
 	std::cout << "testZeroReservation now expects to NOT throw an error..." << std::endl;
@@ -19,6 +19,10 @@ private:
 	void testBitwise();
 	void testComplexAdd_v1();
 	void testComplexAdd_v2();
+	void testMemoryResource();
+	void testClearReusesStorage();
+	void testInlineEffects();
+	void testPackedEffects();
 
 	// crash tests
 	void testZeroReservation();
@@ -0,0 +1,853 @@
+#include "LayeredAttributesUnitTests_v7.hpp"
+#include "../src/EffectProgram.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/LayeredAttributes_v7.hpp"
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+using Implementation = LayeredAttributes_v7;
+using ReferenceImplementation = LayeredAttributes_v2;
+
+
+void LayeredAttributesUnitTests_v7::runOperationalTests()
+{
+	testSetAndGet();
+	testRunsStayIsolated();
+	testMatchesReference();
+	testUnknownOperations();
+	testRemoveLayeredEffect();
+	testRemovalMatchesRebuild();
+	testBatchedChangesMatchRebuild();
+	testBulkAddMatchesReference();
+	testConcurrentReads();
+	testForkMatchesRebuild();
+	testRollbackMatchesFork();
+	testRollbackRetiresHandles();
+	testEffectProgramMatchesSteps();
+	testBaseChangesMatchRebuild();
+	testStatsCounters();
+	std::cout << "** v7 operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void LayeredAttributesUnitTests_v7::runCrashTests()
+{
+	testOutOfBounds();
+	std::cout << "** v7 crash tests passed **" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v7::testSetAndGet()
+{
+	attributes = std::make_unique<Implementation>();
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Power, 2);
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Toughness, 1);
+	for (int i = AttributeKey::AttributeKey_NotAssessed; i <= AttributeKey::AttributeKey_Controller; ++i)
+	{
+		if (i == AttributeKey::AttributeKey_Power)
+		{
+			assert(attributes->GetCurrentAttribute(AttributeKey(i)) == 2);
+		}
+		else if (i == AttributeKey::AttributeKey_Toughness)
+		{
+			assert(attributes->GetCurrentAttribute(AttributeKey(i)) == 1);
+		}
+		else
+		{
+			assert(attributes->GetCurrentAttribute(AttributeKey(i)) == 0);
+		}
+	}
+	std::cout << "testSetAndGet passed" << std::endl;
+}
+
+// All effects share one buffer, so an out-of-order insert into one attribute
+// must not disturb the runs of its neighbours.
+void LayeredAttributesUnitTests_v7::testRunsStayIsolated()
+{
+	attributes = std::make_unique<Implementation>(false, false, 0);
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Power, 2);
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Toughness, 2);
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Controller, 1);
+	attributes->AddLayeredEffect({ AttributeKey_Controller, EffectOperation_BitwiseOr, /*modifier*/2, /*layer*/1 });
+	attributes->AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Add, /*modifier*/3, /*layer*/7 });
+	attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/3, /*layer*/7 });
+	attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Multiply, /*modifier*/2, /*layer*/3 });
+	attributes->AddLayeredEffect({ AttributeKey_Toughness, EffectOperation_Set, /*modifier*/0, /*layer*/1 });
+	attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/5, /*layer*/1 });
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 13);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Toughness) == 3);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Controller) == 3);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Loyalty) == 0);
+	attributes->ClearLayeredEffects();
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 2);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Toughness) == 2);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Controller) == 1);
+	std::cout << "testRunsStayIsolated passed" << std::endl;
+}
+
+// Drives v7 and the reference implementation with the same random calls
+// and expects every read to agree.
+void LayeredAttributesUnitTests_v7::testMatchesReference()
+{
+	attributes = std::make_unique<Implementation>();
+	auto reference = std::make_unique<ReferenceImplementation>();
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> action(0, 99);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 20000; ++step)
+	{
+		int roll = action(rng);
+		if (roll < 5)
+		{
+			attributes->ClearLayeredEffects();
+			reference->ClearLayeredEffects();
+		}
+		else if (roll < 15)
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			int value = modifier(rng);
+			attributes->SetBaseAttribute(attribute, value);
+			reference->SetBaseAttribute(attribute, value);
+		}
+		else if (roll < 55)
+		{
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			attributes->AddLayeredEffect(effect);
+			reference->AddLayeredEffect(effect);
+		}
+		else
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			assert(attributes->GetCurrentAttribute(attribute) == reference->GetCurrentAttribute(attribute));
+		}
+	}
+	std::cout << "testMatchesReference passed" << std::endl;
+}
+
+// Operations are stored in a byte; ones outside the enum must do nothing, as
+// in the reference, instead of wrapping around into a real operation.
+void LayeredAttributesUnitTests_v7::testUnknownOperations()
+{
+	attributes = std::make_unique<Implementation>();
+	ReferenceImplementation reference;
+	const int operations[] = { 257, -255, 256 + EffectOperation_Multiply, 42, -1 };
+	for (int operation : operations)
+	{
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation), /*modifier*/4, /*layer*/3 };
+		attributes->AddLayeredEffect(effect);
+		reference.AddLayeredEffect(effect);
+		assert(attributes->GetCurrentAttribute(AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+	}
+	LayeredEffectDefinition add{ AttributeKey_Power, EffectOperation_Add, /*modifier*/2, /*layer*/3 };
+	attributes->AddLayeredEffect(add);
+	reference.AddLayeredEffect(add);
+	assert(attributes->GetCurrentAttribute(AttributeKey_Power) == 2);
+	assert(reference.GetCurrentAttribute(AttributeKey_Power) == 2);
+
+	// a tracked effect with an unknown operation can still be removed
+	Implementation tracked;
+	tracked.SetBaseAttribute(AttributeKey_Toughness, 5);
+	auto handle = tracked.AddLayeredEffectWithHandle({ AttributeKey_Toughness, EffectOperation(257), /*modifier*/0, /*layer*/1 });
+	assert(tracked.GetCurrentAttribute(AttributeKey_Toughness) == 5);
+	[[maybe_unused]] bool removed = tracked.RemoveLayeredEffect(handle);
+	assert(removed);
+	assert(tracked.GetCurrentAttribute(AttributeKey_Toughness) == 5);
+	std::cout << "testUnknownOperations passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v7::testRemoveLayeredEffect()
+{
+	Implementation layered;
+	layered.SetBaseAttribute(AttributeKey::AttributeKey_Power, 2);
+	auto anthem = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/3, /*layer*/7 });
+	auto doubler = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Multiply, /*modifier*/2, /*layer*/3 });
+	// must not be merged into the tracked anthem
+	layered.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/7 });
+	assert(layered.GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 2 * 2 + 3 + 1);
+	[[maybe_unused]] bool removed = layered.RemoveLayeredEffect(anthem);
+	assert(removed);
+	assert(layered.GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 2 * 2 + 1);
+	removed = layered.RemoveLayeredEffect(anthem);
+	assert(!removed);
+	removed = layered.RemoveLayeredEffect(doubler);
+	assert(removed);
+	assert(layered.GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 2 + 1);
+
+	// handles do not survive a clear, and a reused slot does not revive an old handle
+	auto cleared = layered.AddLayeredEffectWithHandle({ AttributeKey_Toughness, EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	layered.ClearLayeredEffects();
+	removed = layered.RemoveLayeredEffect(cleared);
+	assert(!removed);
+	auto reused = layered.AddLayeredEffectWithHandle({ AttributeKey_Toughness, EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	assert(reused.slot == cleared.slot);
+	removed = layered.RemoveLayeredEffect(cleared);
+	assert(!removed);
+	assert(layered.GetCurrentAttribute(AttributeKey::AttributeKey_Toughness) == 1);
+	removed = layered.RemoveLayeredEffect(reused);
+	assert(removed);
+	assert(layered.GetCurrentAttribute(AttributeKey::AttributeKey_Toughness) == 0);
+	removed = layered.RemoveLayeredEffect(Implementation::EffectHandle());
+	assert(!removed);
+	std::cout << "testRemoveLayeredEffect passed" << std::endl;
+}
+
+// Removes random effects and compares against a reference rebuilt from the
+// surviving effects in their original order.
+void LayeredAttributesUnitTests_v7::testRemovalMatchesRebuild()
+{
+	Implementation layered;
+	std::vector<std::pair<Implementation::EffectHandle, LayeredEffectDefinition>> live;
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<int> action(0, 2);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Toughness);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 4);
+	for (int step = 0; step < 1000; ++step)
+	{
+		if (action(rng) == 0 && !live.empty())
+		{
+			size_t victim = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+			[[maybe_unused]] bool removed = layered.RemoveLayeredEffect(live[victim].first);
+			assert(removed);
+			live.erase(live.begin() + victim);
+		}
+		else
+		{
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			live.push_back({ layered.AddLayeredEffectWithHandle(effect), effect });
+		}
+		ReferenceImplementation reference;
+		for (const auto& survivor : live)
+		{
+			reference.AddLayeredEffect(survivor.second);
+		}
+		assert(layered.GetCurrentAttribute(AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+		assert(layered.GetCurrentAttribute(AttributeKey_Toughness) == reference.GetCurrentAttribute(AttributeKey_Toughness));
+	}
+	std::cout << "testRemovalMatchesRebuild passed" << std::endl;
+}
+
+// Same as testRemovalMatchesRebuild, but several changes land between reads,
+// so cached prefix values have to survive compaction of a dirty run.
+void LayeredAttributesUnitTests_v7::testBatchedChangesMatchRebuild()
+{
+	Implementation layered;
+	std::vector<std::pair<Implementation::EffectHandle, LayeredEffectDefinition>> live;
+	int base = 0;
+	std::mt19937 rng(13);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 3000; ++step)
+	{
+		int roll = action(rng);
+		if (roll < 4 && !live.empty())
+		{
+			size_t victim = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+			[[maybe_unused]] bool removed = layered.RemoveLayeredEffect(live[victim].first);
+			assert(removed);
+			live.erase(live.begin() + victim);
+		}
+		else if (roll == 4)
+		{
+			base = modifier(rng);
+			layered.SetBaseAttribute(AttributeKey_Power, base);
+		}
+		else
+		{
+			LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			live.push_back({ layered.AddLayeredEffectWithHandle(effect), effect });
+		}
+		if (step % 7 == 0)
+		{
+			ReferenceImplementation reference;
+			reference.SetBaseAttribute(AttributeKey_Power, base);
+			for (const auto& survivor : live)
+			{
+				reference.AddLayeredEffect(survivor.second);
+			}
+			assert(layered.GetCurrentAttribute(AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+		}
+	}
+	std::cout << "testBatchedChangesMatchRebuild passed" << std::endl;
+}
+
+// Loads random batches through AddLayeredEffects, and single adds with write
+// combining on, while the reference receives the same effects one at a time.
+void LayeredAttributesUnitTests_v7::testBulkAddMatchesReference()
+{
+	Implementation layered;
+	ReferenceImplementation reference;
+	std::mt19937 rng(17);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::uniform_int_distribution<int> batchSize(0, 40);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 2000; ++step)
+	{
+		int roll = action(rng);
+		if (roll == 0)
+		{
+			layered.ClearLayeredEffects();
+			reference.ClearLayeredEffects();
+		}
+		else if (roll == 1)
+		{
+			layered.SetWriteCombining(step % 2 == 0);
+		}
+		else if (roll < 5)
+		{
+			std::vector<LayeredEffectDefinition> batch;
+			for (int i = batchSize(rng); i > 0; --i)
+			{
+				batch.push_back({ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) });
+				reference.AddLayeredEffect(batch.back());
+			}
+			layered.AddLayeredEffects(batch);
+		}
+		else if (roll < 8)
+		{
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			layered.AddLayeredEffect(effect);
+			reference.AddLayeredEffect(effect);
+		}
+		else
+		{
+			for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+			{
+				assert(layered.GetCurrentAttribute(AttributeKey(attribute)) == reference.GetCurrentAttribute(AttributeKey(attribute)));
+			}
+		}
+	}
+	std::cout << "testBulkAddMatchesReference passed" << std::endl;
+}
+
+// One writer keeps adding +1 effects in random layers while readers poll.
+// Additions commute, so every value a reader sees must be one the writer
+// published: never lower than the last one it saw and never past the end.
+void LayeredAttributesUnitTests_v7::testConcurrentReads()
+{
+	const int effectCount = 20000;
+	Implementation layered;
+	ReferenceImplementation reference;
+	layered.SetBaseAttribute(AttributeKey_Power, 1);
+	reference.SetBaseAttribute(AttributeKey_Power, 1);
+	layered.SetConcurrentReads(true);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 1);
+
+	std::atomic<bool> writing{ true };
+	std::vector<std::thread> readers;
+	for (int reader = 0; reader < 4; ++reader)
+	{
+		readers.emplace_back([&]()
+			{
+				int last = 1;
+				while (writing.load())
+				{
+					int value = layered.GetCurrentAttribute(AttributeKey_Power);
+					assert(value >= last && value <= 1 + effectCount);
+					last = value;
+				}
+			});
+	}
+	std::mt19937 rng(37);
+	std::uniform_int_distribution<int> layer(0, 7);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	for (int i = 0; i < effectCount; ++i)
+	{
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, layer(rng) };
+		layered.AddLayeredEffect(effect);
+		reference.AddLayeredEffect(effect);
+		// unrelated churn on another attribute
+		LayeredEffectDefinition churn{ AttributeKey_Toughness, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		layered.AddLayeredEffect(churn);
+		reference.AddLayeredEffect(churn);
+	}
+	writing = false;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 1 + effectCount);
+	assert(layered.GetCurrentAttribute(AttributeKey_Toughness) == reference.GetCurrentAttribute(AttributeKey_Toughness));
+	layered.SetConcurrentReads(false);
+	layered.SetBaseAttribute(AttributeKey_Power, 2);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 2 + effectCount);
+	std::cout << "testConcurrentReads passed" << std::endl;
+}
+
+// Grows a pool of forks the way a search tree would: forks are changed, read
+// and dropped in random order while they still share effects, and every read
+// is compared against a reference rebuilt from that fork's own history.
+void LayeredAttributesUnitTests_v7::testForkMatchesRebuild()
+{
+	struct Node
+	{
+		Implementation layered;
+		std::vector<std::pair<Implementation::EffectHandle, LayeredEffectDefinition>> live;
+		int base = 0;
+	};
+	std::vector<Node> nodes(1);
+	std::mt19937 rng(19);
+	std::uniform_int_distribution<int> action(0, 15);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 4000; ++step)
+	{
+		Node& node = nodes[std::uniform_int_distribution<size_t>(0, nodes.size() - 1)(rng)];
+		int roll = action(rng);
+		if (roll < 3 && nodes.size() < 16)
+		{
+			Node child{ node.layered.Fork(), node.live, node.base };
+			nodes.push_back(std::move(child));
+		}
+		else if (roll == 3 && nodes.size() > 1)
+		{
+			nodes.erase(nodes.begin() + std::uniform_int_distribution<size_t>(0, nodes.size() - 1)(rng));
+		}
+		else if (roll == 4 && !node.live.empty())
+		{
+			size_t victim = std::uniform_int_distribution<size_t>(0, node.live.size() - 1)(rng);
+			[[maybe_unused]] bool removed = node.layered.RemoveLayeredEffect(node.live[victim].first);
+			assert(removed);
+			node.live.erase(node.live.begin() + victim);
+		}
+		else if (roll == 5)
+		{
+			node.base = modifier(rng);
+			node.layered.SetBaseAttribute(AttributeKey_Power, node.base);
+		}
+		else if (roll == 6 && step % 5 == 0)
+		{
+			node.layered.ClearLayeredEffects();
+			for (const auto& survivor : node.live)
+			{
+				[[maybe_unused]] bool removed = node.layered.RemoveLayeredEffect(survivor.first);
+				assert(!removed);
+			}
+			node.live.clear();
+		}
+		else if (roll < 12)
+		{
+			LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			node.live.push_back({ node.layered.AddLayeredEffectWithHandle(effect), effect });
+		}
+		else
+		{
+			ReferenceImplementation reference;
+			reference.SetBaseAttribute(AttributeKey_Power, node.base);
+			for (const auto& survivor : node.live)
+			{
+				reference.AddLayeredEffect(survivor.second);
+			}
+			assert(node.layered.GetCurrentAttribute(AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+		}
+	}
+	std::cout << "testForkMatchesRebuild passed" << std::endl;
+}
+
+// Walks a search tree depth first: checkpoints are nested, every kind of
+// change is made between them, and each rollback must give back exactly the
+// state a fork taken at the checkpoint still holds.
+void LayeredAttributesUnitTests_v7::testRollbackMatchesFork()
+{
+	struct Frame
+	{
+		Implementation::UndoMarker marker;
+		Implementation snapshot;
+		std::vector<Implementation::EffectHandle> handles;
+	};
+	Implementation layered;
+	std::vector<Implementation::EffectHandle> handles;
+	std::vector<Frame> frames;
+	std::mt19937 rng(23);
+	std::uniform_int_distribution<int> action(0, 11);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	auto randomEffect = [&]() { return LayeredEffectDefinition{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) }; };
+	for (int step = 0; step < 4000; ++step)
+	{
+		int roll = action(rng);
+		if (roll == 0 && frames.size() < 6)
+		{
+			frames.push_back({ layered.Checkpoint(), layered.Fork(), handles });
+		}
+		else if (roll == 1 && !frames.empty())
+		{
+			const Frame& frame = frames.back();
+			[[maybe_unused]] bool rolledBack = layered.RollbackTo(frame.marker);
+			assert(rolledBack);
+			handles = frame.handles;
+			// the same change on both sides must land in the same place
+			Implementation probe = frame.snapshot.Fork();
+			LayeredEffectDefinition effect = randomEffect();
+			probe.AddLayeredEffect(effect);
+			layered.AddLayeredEffect(effect);
+			for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+			{
+				assert(layered.GetCurrentAttribute(AttributeKey(attribute)) == probe.GetCurrentAttribute(AttributeKey(attribute)));
+			}
+			layered.RollbackTo(frame.marker);
+			if (step % 2 == 0)
+			{
+				frames.pop_back();
+			}
+		}
+		else if (roll == 2 && !handles.empty())
+		{
+			size_t victim = std::uniform_int_distribution<size_t>(0, handles.size() - 1)(rng);
+			[[maybe_unused]] bool removed = layered.RemoveLayeredEffect(handles[victim]);
+			assert(removed);
+			handles.erase(handles.begin() + victim);
+		}
+		else if (roll == 3)
+		{
+			layered.SetBaseAttribute(AttributeKey(key(rng)), modifier(rng));
+		}
+		else if (roll == 4 && step % 4 == 0)
+		{
+			layered.ClearLayeredEffects();
+			handles.clear();
+		}
+		else if (roll == 5)
+		{
+			std::vector<LayeredEffectDefinition> batch(std::uniform_int_distribution<size_t>(0, 8)(rng));
+			for (auto& effect : batch)
+			{
+				effect = randomEffect();
+			}
+			layered.AddLayeredEffects(batch);
+		}
+		else if (roll == 6)
+		{
+			layered.SetWriteCombining(step % 3 == 0);
+		}
+		else if (roll < 9)
+		{
+			layered.AddLayeredEffect(randomEffect());
+		}
+		else
+		{
+			handles.push_back(layered.AddLayeredEffectWithHandle(randomEffect()));
+		}
+		if (frames.empty() && step % 5 == 0)
+		{
+			layered.ReleaseCheckpoints();
+		}
+	}
+	while (!frames.empty())
+	{
+		layered.RollbackTo(frames.back().marker);
+		for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+		{
+			assert(layered.GetCurrentAttribute(AttributeKey(attribute)) == frames.back().snapshot.GetCurrentAttribute(AttributeKey(attribute)));
+		}
+		frames.pop_back();
+	}
+	layered.ReleaseCheckpoints();
+	[[maybe_unused]] bool rolledBack = layered.RollbackTo(Implementation::UndoMarker());
+	assert(!rolledBack);
+	std::cout << "testRollbackMatchesFork passed" << std::endl;
+}
+
+// A handle issued in a branch that is rolled back must not match the effect
+// that reuses its slot in the next branch.
+void LayeredAttributesUnitTests_v7::testRollbackRetiresHandles()
+{
+	Implementation layered;
+	layered.SetBaseAttribute(AttributeKey_Power, 1);
+	auto kept = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/10, /*layer*/1 });
+	auto freed = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/20, /*layer*/1 });
+	[[maybe_unused]] bool removed = layered.RemoveLayeredEffect(freed);
+	assert(removed);
+	Implementation::UndoMarker marker = layered.Checkpoint();
+
+	// one branch takes the free slot and a new one
+	auto reused = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/100, /*layer*/1 });
+	auto appended = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1000, /*layer*/1 });
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 1111);
+	[[maybe_unused]] bool rolledBack = layered.RollbackTo(marker);
+	assert(rolledBack);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 11);
+
+	// the next branch takes the same slots again
+	[[maybe_unused]] auto reusedAgain = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/200, /*layer*/1 });
+	auto appendedAgain = layered.AddLayeredEffectWithHandle({ AttributeKey_Power, EffectOperation_Add, /*modifier*/2000, /*layer*/1 });
+	assert(reusedAgain.slot == reused.slot && appendedAgain.slot == appended.slot);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 2211);
+	removed = layered.RemoveLayeredEffect(reused);
+	assert(!removed);
+	removed = layered.RemoveLayeredEffect(appended);
+	assert(!removed);
+	removed = layered.RemoveLayeredEffect(freed);
+	assert(!removed);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 2211);
+
+	// handles from before the checkpoint still work in every branch
+	removed = layered.RemoveLayeredEffect(kept);
+	assert(removed);
+	removed = layered.RemoveLayeredEffect(appendedAgain);
+	assert(removed);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 201);
+	layered.RollbackTo(marker);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 11);
+	removed = layered.RemoveLayeredEffect(kept);
+	assert(removed);
+	assert(layered.GetCurrentAttribute(AttributeKey_Power) == 1);
+	layered.ReleaseCheckpoints();
+	std::cout << "testRollbackRetiresHandles passed" << std::endl;
+}
+
+// Compiles random stacks, including long single-class stretches, cancelling
+// pairs and removed effects, and runs them on a few base values; every result
+// must match applying the effects one at a time.
+void LayeredAttributesUnitTests_v7::testEffectProgramMatchesSteps()
+{
+	std::mt19937 rng(17);
+	std::uniform_int_distribution<int> operation(EffectOperation_Invalid, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> classOperation(0, 2);
+	std::uniform_int_distribution<int> modifier(-40, 40);
+	std::uniform_int_distribution<int> length(0, 24);
+	const int bases[] = { 0, 1, -7, 1000, std::numeric_limits<int>::max(), std::numeric_limits<int>::min() };
+	std::vector<EffectProgram::Instruction> code;
+	for (int round = 0; round < 2000; ++round)
+	{
+		std::vector<std::pair<int, int>> stack;
+		int count = length(rng);
+		for (int i = 0; i < count; ++i)
+		{
+			int op = operation(rng);
+			if (round % 3 == 1)
+			{
+				// arithmetic only, without Set
+				op = EffectOperation_Add + classOperation(rng);
+			}
+			else if (round % 3 == 2)
+			{
+				op = EffectOperation_BitwiseOr + classOperation(rng);
+			}
+			stack.push_back({ op, modifier(rng) });
+		}
+		EffectProgram::Builder builder(code);
+		for (const auto& effect : stack)
+		{
+			builder.append(effect.first, effect.second);
+		}
+		builder.finish();
+		if (round % 3 != 0)
+		{
+			assert(EffectProgram::Length(code.data()) <= 1);
+		}
+		for (int base : bases)
+		{
+			uint32_t expected = static_cast<uint32_t>(base);
+			for (const auto& effect : stack)
+			{
+				uint32_t m = static_cast<uint32_t>(effect.second);
+				switch (effect.first)
+				{
+				case EffectOperation_Set: expected = m; break;
+				case EffectOperation_Add: expected += m; break;
+				case EffectOperation_Subtract: expected -= m; break;
+				case EffectOperation_Multiply: expected *= m; break;
+				case EffectOperation_BitwiseOr: expected |= m; break;
+				case EffectOperation_BitwiseAnd: expected &= m; break;
+				case EffectOperation_BitwiseXor: expected ^= m; break;
+				default: break;
+				}
+			}
+			assert(EffectProgram::Run(code.data(), base) == static_cast<int>(expected));
+		}
+	}
+	std::cout << "testEffectProgramMatchesSteps passed" << std::endl;
+}
+
+// Changes the base value far more often than the effects, so most reads run
+// the compiled program, while adds, removals, forks and rollbacks keep
+// replacing it. Every read is compared against a rebuilt reference.
+void LayeredAttributesUnitTests_v7::testBaseChangesMatchRebuild()
+{
+	Implementation layered;
+	std::vector<std::pair<Implementation::EffectHandle, LayeredEffectDefinition>> live;
+	int base = 0;
+	Implementation::UndoMarker marker;
+	std::vector<std::pair<Implementation::EffectHandle, LayeredEffectDefinition>> markedLive;
+	int markedBase = 0;
+	bool marked = false;
+	std::mt19937 rng(19);
+	std::uniform_int_distribution<int> action(0, 19);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	auto check = [&](const Implementation& object)
+	{
+		ReferenceImplementation reference;
+		reference.SetBaseAttribute(AttributeKey_Power, base);
+		for (const auto& survivor : live)
+		{
+			reference.AddLayeredEffect(survivor.second);
+		}
+		assert(object.GetCurrentAttribute(AttributeKey_Power) == reference.GetCurrentAttribute(AttributeKey_Power));
+	};
+	for (int step = 0; step < 4000; ++step)
+	{
+		int roll = action(rng);
+		LayeredEffectDefinition effect{ AttributeKey_Power, EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+		if (roll < 12)
+		{
+			base = step % 97 - 48;
+			layered.SetBaseAttribute(AttributeKey_Power, base);
+		}
+		else if (roll < 14)
+		{
+			live.push_back({ layered.AddLayeredEffectWithHandle(effect), effect });
+		}
+		else if (roll == 14)
+		{
+			layered.AddLayeredEffect(effect);
+			live.push_back({ Implementation::EffectHandle(), effect });
+		}
+		else if (roll == 15 && !live.empty())
+		{
+			size_t victim = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+			if (layered.RemoveLayeredEffect(live[victim].first))
+			{
+				live.erase(live.begin() + victim);
+			}
+		}
+		else if (roll == 16)
+		{
+			// a fork reads the shared program while the parent keeps going
+			Implementation child = layered.Fork();
+			int childBase = base;
+			base = step % 13;
+			child.SetBaseAttribute(AttributeKey_Power, base);
+			check(child);
+			base = childBase;
+		}
+		else if (roll == 17 && step % 5 == 0)
+		{
+			if (marked)
+			{
+				[[maybe_unused]] bool rolledBack = layered.RollbackTo(marker);
+				assert(rolledBack);
+				live = markedLive;
+				base = markedBase;
+			}
+			else
+			{
+				marker = layered.Checkpoint();
+				markedLive = live;
+				markedBase = base;
+				marked = true;
+			}
+		}
+		else if (roll == 18 && step % 50 == 0)
+		{
+			layered.ReleaseCheckpoints();
+			marked = false;
+			if (step % 100 == 0)
+			{
+				layered.ClearLayeredEffects();
+				live.clear();
+			}
+		}
+		check(layered);
+	}
+	std::cout << "testBaseChangesMatchRebuild passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v7::testStatsCounters()
+{
+	// append, merge, append, then an insert in front of the stack
+	const LayeredEffectDefinition effects[] = {
+		{ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/1 },
+		{ AttributeKey_Power, EffectOperation_Add, /*modifier*/2, /*layer*/1 },
+		{ AttributeKey_Power, EffectOperation_Multiply, /*modifier*/2, /*layer*/1 },
+		{ AttributeKey_Power, EffectOperation_Set, /*modifier*/5, /*layer*/0 } };
+
+	Implementation dense;
+	ReferenceImplementation reference;
+	dense.SetBaseAttribute(AttributeKey_Power, 2);
+	reference.SetBaseAttribute(AttributeKey_Power, 2);
+	for (const auto& effect : effects)
+	{
+		dense.AddLayeredEffect(effect);
+		reference.AddLayeredEffect(effect);
+	}
+	assert(dense.GetCurrentAttribute(AttributeKey_Power) == 16);
+	assert(dense.GetCurrentAttribute(AttributeKey_Power) == 16);
+	assert(reference.GetCurrentAttribute(AttributeKey_Power) == 16);
+	assert(reference.GetCurrentAttribute(AttributeKey_Power) == 16);
+
+	[[maybe_unused]] AttributeStats stats = dense.GetStats();
+	[[maybe_unused]] AttributeStats referenceStats = reference.GetStats();
+	if (!AttributeStats::Enabled)
+	{
+		// compiled out: nothing is ever counted
+		assert(stats.reads == 0 && stats.adds == 0 && stats.stackDepth[1] == 0);
+		assert(referenceStats.reads == 0 && referenceStats.adds == 0);
+		std::cout << "testStatsCounters passed (statistics disabled)" << std::endl;
+		return;
+	}
+	assert(stats.reads == 2 && stats.cacheHits == 1);
+	assert(stats.recomputes == 1 && stats.recomputeLength[AttributeStats::Bucket(3)] == 1);
+	assert(stats.adds == 4 && stats.merges == 1 && stats.appends == 2 && stats.inserts == 1);
+	assert(stats.stackDepth[AttributeStats::Bucket(1)] == 2);
+	// depths 2 and 3 share a bucket
+	assert(stats.stackDepth[AttributeStats::Bucket(2)] == 2 && AttributeStats::Bucket(3) == AttributeStats::Bucket(2));
+	// v2 does not append to an empty stack, it bails out and inserts
+	assert(referenceStats.reads == 2 && referenceStats.cacheHits == 1 && referenceStats.recomputes == 1);
+	assert(referenceStats.adds == 4 && referenceStats.merges == 1 && referenceStats.appends == 1 && referenceStats.inserts == 2);
+
+	// after a base change the first recompute compiles the run and the next one runs the program
+	dense.ResetStats();
+	assert(dense.GetStats().reads == 0);
+	dense.SetBaseAttribute(AttributeKey_Power, 7);
+	assert(dense.GetCurrentAttribute(AttributeKey_Power) == 16);
+	dense.SetBaseAttribute(AttributeKey_Power, 8);
+	assert(dense.GetCurrentAttribute(AttributeKey_Power) == 16);
+	stats = dense.GetStats();
+	assert(stats.recomputes == 2 && stats.programRuns == 1);
+
+	// forks start from a copy of the counters
+	Implementation fork = dense.Fork();
+	fork.GetCurrentAttribute(AttributeKey_Power);
+	assert(fork.GetStats().reads == 3);
+	assert(dense.GetStats().reads == 2);
+	std::cout << "testStatsCounters passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v7::testOutOfBounds()
+{
+	attributes = std::make_unique<Implementation>();
+	attributes->SetBaseAttribute(AttributeKey(-1), 2);
+	attributes->AddLayeredEffect({ AttributeKey(100), EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	assert(attributes->GetCurrentAttribute(AttributeKey(100)) == std::numeric_limits<int>::min());
+
+	std::cout << "testOutOfBounds expects to throw an error..." << std::endl;
+	attributes = std::make_unique<Implementation>(true, true);
+	try
+	{
+		attributes->SetBaseAttribute(AttributeKey(-1), 2);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+	}
+}
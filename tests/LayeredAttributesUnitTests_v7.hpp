@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include "../src/ILayeredAttributes.hpp"
+
+class LayeredAttributesUnitTests_v7
+{
+public:
+	LayeredAttributesUnitTests_v7() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	std::unique_ptr<ILayeredAttributes> attributes;
+
+	// operational tests
+	void testSetAndGet();
+	void testRunsStayIsolated();
+	void testMatchesReference();
+	void testUnknownOperations();
+	void testRemoveLayeredEffect();
+	void testRemovalMatchesRebuild();
+	void testBatchedChangesMatchRebuild();
+	void testBulkAddMatchesReference();
+	void testConcurrentReads();
+	void testForkMatchesRebuild();
+	void testRollbackMatchesFork();
+	void testRollbackRetiresHandles();
+	void testEffectProgramMatchesSteps();
+	void testBaseChangesMatchRebuild();
+	void testStatsCounters();
+
+	// crash tests
+	void testOutOfBounds();
+};
@@ -0,0 +1,170 @@
+#include "LayeredAttributesUnitTests_v8.hpp"
+#include "../src/EffectTransfer.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/LayeredAttributes_v8.hpp"
+#include <assert.h>
+#include <iostream>
+#include <limits>
+#include <random>
+
+using Implementation = LayeredAttributes_v8;
+using ReferenceImplementation = LayeredAttributes_v2;
+
+
+void LayeredAttributesUnitTests_v8::runOperationalTests()
+{
+	testTransferComposition();
+	testOutOfOrderInsert();
+	testAlternatingOperations();
+	testMatchesReference();
+	std::cout << "** v8 operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void LayeredAttributesUnitTests_v8::runCrashTests()
+{
+	testOutOfBounds();
+	std::cout << "** v8 crash tests passed **" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v8::testTransferComposition()
+{
+	// (x * 3 - 2) + 5
+	ComposedTransfer arithmetic;
+	arithmetic.append(EffectTransfer::fromEffect(EffectOperation_Multiply, 3));
+	arithmetic.append(EffectTransfer::fromEffect(EffectOperation_Subtract, 2));
+	arithmetic.append(EffectTransfer::fromEffect(EffectOperation_Add, 5));
+	assert(arithmetic.apply(4) == 15);
+	assert(arithmetic.apply(-1) == 0);
+
+	// ((x & 6) | 1) ^ 3
+	ComposedTransfer bitwise;
+	bitwise.append(EffectTransfer::fromEffect(EffectOperation_BitwiseAnd, 6));
+	bitwise.append(EffectTransfer::fromEffect(EffectOperation_BitwiseOr, 1));
+	bitwise.append(EffectTransfer::fromEffect(EffectOperation_BitwiseXor, 3));
+	for (int x = -8; x <= 8; ++x)
+	{
+		assert(bitwise.apply(x) == (((x & 6) | 1) ^ 3));
+	}
+
+	// a Set discards everything before it, even across operation classes
+	bitwise.append(EffectTransfer::fromEffect(EffectOperation_Set, 7));
+	bitwise.append(EffectTransfer::fromEffect(EffectOperation_Add, 1));
+	assert(bitwise.apply(12345) == 8);
+
+	// And 0 is a constant, so it collapses to a Set as well
+	ComposedTransfer mixed;
+	for (int i = 0; i < 10; ++i)
+	{
+		mixed.append(EffectTransfer::fromEffect(EffectOperation_Add, 1));
+		mixed.append(EffectTransfer::fromEffect(EffectOperation_BitwiseXor, 1));
+	}
+	assert(mixed.isOverflowed());
+	mixed.append(EffectTransfer::fromEffect(EffectOperation_BitwiseAnd, 0));
+	assert(!mixed.isOverflowed());
+	assert(mixed.apply(99) == 0);
+	std::cout << "testTransferComposition passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v8::testOutOfOrderInsert()
+{
+	attributes = std::make_unique<Implementation>();
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Power, 2);
+	// insert layers 100..1 in descending order, each adding its layer number,
+	// then a layer 0 Set that must be applied first
+	int expected = 2;
+	for (int layer = 100; layer >= 1; --layer)
+	{
+		attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/layer, layer });
+		expected += layer;
+		assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected);
+	}
+	attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/0, /*layer*/0 });
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected - 2);
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Power, 1000);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected - 2);
+	attributes->ClearLayeredEffects();
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 1000);
+	std::cout << "testOutOfOrderInsert passed" << std::endl;
+}
+
+// Stacks that keep switching between arithmetic and bitwise operations
+// overflow the composed transfers and take the node-by-node path.
+void LayeredAttributesUnitTests_v8::testAlternatingOperations()
+{
+	attributes = std::make_unique<Implementation>();
+	auto reference = std::make_unique<ReferenceImplementation>();
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Color, 5);
+	reference->SetBaseAttribute(AttributeKey::AttributeKey_Color, 5);
+	for (int i = 0; i < 200; ++i)
+	{
+		LayeredEffectDefinition effect{ AttributeKey_Color, (i % 2) ? EffectOperation_BitwiseXor : EffectOperation_Add, /*modifier*/i % 7 + 1, /*layer*/(i * 37) % 11 };
+		attributes->AddLayeredEffect(effect);
+		reference->AddLayeredEffect(effect);
+		assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Color) == reference->GetCurrentAttribute(AttributeKey::AttributeKey_Color));
+	}
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Color, -3);
+	reference->SetBaseAttribute(AttributeKey::AttributeKey_Color, -3);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Color) == reference->GetCurrentAttribute(AttributeKey::AttributeKey_Color));
+	std::cout << "testAlternatingOperations passed" << std::endl;
+}
+
+// Drives v8 and the reference implementation with the same random calls
+// and expects every read to agree.
+void LayeredAttributesUnitTests_v8::testMatchesReference()
+{
+	attributes = std::make_unique<Implementation>();
+	auto reference = std::make_unique<ReferenceImplementation>();
+	std::mt19937 rng(8);
+	std::uniform_int_distribution<int> action(0, 99);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 20000; ++step)
+	{
+		int roll = action(rng);
+		if (roll < 5)
+		{
+			attributes->ClearLayeredEffects();
+			reference->ClearLayeredEffects();
+		}
+		else if (roll < 15)
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			int value = modifier(rng);
+			attributes->SetBaseAttribute(attribute, value);
+			reference->SetBaseAttribute(attribute, value);
+		}
+		else if (roll < 55)
+		{
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			attributes->AddLayeredEffect(effect);
+			reference->AddLayeredEffect(effect);
+		}
+		else
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			assert(attributes->GetCurrentAttribute(attribute) == reference->GetCurrentAttribute(attribute));
+		}
+	}
+	std::cout << "testMatchesReference passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v8::testOutOfBounds()
+{
+	attributes = std::make_unique<Implementation>();
+	attributes->AddLayeredEffect({ AttributeKey(100), EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	assert(attributes->GetCurrentAttribute(AttributeKey(100)) == std::numeric_limits<int>::min());
+
+	std::cout << "testOutOfBounds expects to throw an error..." << std::endl;
+	attributes = std::make_unique<Implementation>(true, true);
+	try
+	{
+		attributes->SetBaseAttribute(AttributeKey(-1), 2);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+	}
+}
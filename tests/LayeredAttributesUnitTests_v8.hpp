@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include "../src/ILayeredAttributes.hpp"
+
+class LayeredAttributesUnitTests_v8
+{
+public:
+	LayeredAttributesUnitTests_v8() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	std::unique_ptr<ILayeredAttributes> attributes;
+
+	// operational tests
+	void testTransferComposition();
+	void testOutOfOrderInsert();
+	void testAlternatingOperations();
+	void testMatchesReference();
+
+	// crash tests
+	void testOutOfBounds();
+};
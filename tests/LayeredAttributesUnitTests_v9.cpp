@@ -0,0 +1,199 @@
+#include "LayeredAttributesUnitTests_v9.hpp"
+#include "../src/LayeredAttributes_v2.hpp"
+#include "../src/LayeredAttributes_v9.hpp"
+#include <assert.h>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+using Implementation = LayeredAttributes_v9;
+using ReferenceImplementation = LayeredAttributes_v2;
+
+
+void LayeredAttributesUnitTests_v9::runOperationalTests()
+{
+	testOutOfOrderInsert();
+	testInterleavedAttributes();
+	testBulkLoad();
+	testRenumberTimestamps();
+	testMatchesReference();
+	std::cout << "** v9 operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void LayeredAttributesUnitTests_v9::runCrashTests()
+{
+	testOutOfBounds();
+	std::cout << "** v9 crash tests passed **" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v9::testOutOfOrderInsert()
+{
+	attributes = std::make_unique<Implementation>();
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Power, 2);
+	// insert layers 100..1 in descending order, each adding its layer number,
+	// then a layer 0 Set that must be applied first
+	int expected = 2;
+	for (int layer = 100; layer >= 1; --layer)
+	{
+		attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/layer, layer });
+		expected += layer;
+		assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected);
+	}
+	attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/0, /*layer*/0 });
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected - 2);
+	// negative layers sort before layer 0
+	attributes->AddLayeredEffect({ AttributeKey_Power, EffectOperation_Multiply, /*modifier*/9, /*layer*/-5 });
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected - 2);
+	attributes->SetBaseAttribute(AttributeKey::AttributeKey_Power, 1000);
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == expected - 2);
+	attributes->ClearLayeredEffects();
+	assert(attributes->GetCurrentAttribute(AttributeKey::AttributeKey_Power) == 1000);
+	std::cout << "testOutOfOrderInsert passed" << std::endl;
+}
+
+// Effects of a lower attribute after a higher one go to the tail; reads of
+// attributes with nothing in the tail must not need it merged.
+void LayeredAttributesUnitTests_v9::testInterleavedAttributes()
+{
+	attributes = std::make_unique<Implementation>();
+	auto reference = std::make_unique<ReferenceImplementation>();
+	for (int round = 0; round < 50; ++round)
+	{
+		for (int attribute = AttributeKey_Controller; attribute >= AttributeKey_Power; --attribute)
+		{
+			LayeredEffectDefinition effect{ AttributeKey(attribute), EffectOperation((round + attribute) % 7 + 1), /*modifier*/round % 5 - 2, /*layer*/(round * 3 + attribute) % 6 };
+			attributes->AddLayeredEffect(effect);
+			reference->AddLayeredEffect(effect);
+			// same attribute, layer and operation: folds into the effect just added
+			attributes->AddLayeredEffect(effect);
+			reference->AddLayeredEffect(effect);
+			if (attribute % 3 == round % 3)
+			{
+				assert(attributes->GetCurrentAttribute(AttributeKey(attribute)) == reference->GetCurrentAttribute(AttributeKey(attribute)));
+			}
+		}
+	}
+	for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+	{
+		assert(attributes->GetCurrentAttribute(AttributeKey(attribute)) == reference->GetCurrentAttribute(AttributeKey(attribute)));
+	}
+	std::cout << "testInterleavedAttributes passed" << std::endl;
+}
+
+// A saved game is loaded in one batch and radix sorted by the first read;
+// loading it again on top merges a second large tail into the prefix.
+void LayeredAttributesUnitTests_v9::testBulkLoad()
+{
+	std::mt19937 rng(9);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(-2, 7);
+	std::vector<LayeredEffectDefinition> savedGame;
+	for (size_t i = 0; i < 10 * Implementation::RadixSortThreshold; ++i)
+	{
+		savedGame.push_back({ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) });
+	}
+	Implementation batched;
+	Implementation oneByOne;
+	ReferenceImplementation reference;
+	for (int load = 0; load < 2; ++load)
+	{
+		batched.AddLayeredEffects(savedGame);
+		for (const auto& effect : savedGame)
+		{
+			oneByOne.AddLayeredEffect(effect);
+			reference.AddLayeredEffect(effect);
+		}
+		for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Controller; ++attribute)
+		{
+			assert(batched.GetCurrentAttribute(AttributeKey(attribute)) == reference.GetCurrentAttribute(AttributeKey(attribute)));
+			assert(oneByOne.GetCurrentAttribute(AttributeKey(attribute)) == reference.GetCurrentAttribute(AttributeKey(attribute)));
+		}
+	}
+	std::cout << "testBulkLoad passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v9::testRenumberTimestamps()
+{
+	Implementation renumbered;
+	ReferenceImplementation reference;
+	for (int i = 0; i < 300; ++i)
+	{
+		LayeredEffectDefinition effect{ AttributeKey(AttributeKey_Power + i % 4), EffectOperation(EffectOperation_Set + (i * 5) % 7), /*modifier*/i % 9 - 4, /*layer*/(i * 7) % 5 - 2 };
+		renumbered.AddLayeredEffect(effect);
+		reference.AddLayeredEffect(effect);
+		if (i % 37 == 0)
+		{
+			// with and without an unsorted tail
+			renumbered.RenumberTimestamps();
+		}
+		for (int attribute = AttributeKey_Power; attribute <= AttributeKey_Color; ++attribute)
+		{
+			assert(renumbered.GetCurrentAttribute(AttributeKey(attribute)) == reference.GetCurrentAttribute(AttributeKey(attribute)));
+		}
+	}
+	std::cout << "testRenumberTimestamps passed" << std::endl;
+}
+
+// Drives v9 and the reference implementation with the same random calls
+// and expects every read to agree.
+void LayeredAttributesUnitTests_v9::testMatchesReference()
+{
+	attributes = std::make_unique<Implementation>();
+	auto reference = std::make_unique<ReferenceImplementation>();
+	std::mt19937 rng(10);
+	std::uniform_int_distribution<int> action(0, 99);
+	std::uniform_int_distribution<int> key(AttributeKey_Power, AttributeKey_Controller);
+	std::uniform_int_distribution<int> operation(EffectOperation_Set, EffectOperation_BitwiseXor);
+	std::uniform_int_distribution<int> modifier(-3, 3);
+	std::uniform_int_distribution<int> layer(0, 7);
+	for (int step = 0; step < 20000; ++step)
+	{
+		int roll = action(rng);
+		if (roll < 3)
+		{
+			attributes->ClearLayeredEffects();
+			reference->ClearLayeredEffects();
+		}
+		else if (roll < 13)
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			int value = modifier(rng);
+			attributes->SetBaseAttribute(attribute, value);
+			reference->SetBaseAttribute(attribute, value);
+		}
+		else if (roll < 63)
+		{
+			LayeredEffectDefinition effect{ AttributeKey(key(rng)), EffectOperation(operation(rng)), modifier(rng), layer(rng) };
+			attributes->AddLayeredEffect(effect);
+			reference->AddLayeredEffect(effect);
+		}
+		else
+		{
+			AttributeKey attribute = AttributeKey(key(rng));
+			assert(attributes->GetCurrentAttribute(attribute) == reference->GetCurrentAttribute(attribute));
+		}
+	}
+	std::cout << "testMatchesReference passed" << std::endl;
+}
+
+void LayeredAttributesUnitTests_v9::testOutOfBounds()
+{
+	attributes = std::make_unique<Implementation>();
+	attributes->AddLayeredEffect({ AttributeKey(100), EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	assert(attributes->GetCurrentAttribute(AttributeKey(100)) == std::numeric_limits<int>::min());
+
+	std::cout << "testOutOfBounds expects to throw an error..." << std::endl;
+	attributes = std::make_unique<Implementation>(true, true);
+	try
+	{
+		attributes->SetBaseAttribute(AttributeKey(-1), 2);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Expected exception caught: " << e.what() << '\n';
+	}
+}
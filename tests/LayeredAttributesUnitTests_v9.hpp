@@ -0,0 +1,24 @@
+#pragma once
+#include <memory>
+#include "../src/ILayeredAttributes.hpp"
+
+class LayeredAttributesUnitTests_v9
+{
+public:
+	LayeredAttributesUnitTests_v9() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	std::unique_ptr<ILayeredAttributes> attributes;
+
+	// operational tests
+	void testOutOfOrderInsert();
+	void testInterleavedAttributes();
+	void testBulkLoad();
+	void testRenumberTimestamps();
+	void testMatchesReference();
+
+	// crash tests
+	void testOutOfBounds();
+};
@@ -0,0 +1,143 @@
+#include "TimelineUnitTests.hpp"
+#include "../src/AttributeWorld.hpp"
+#include "../src/LayeredAttributes_v7.hpp"
+#include "../src/Timeline.hpp"
+#include "../src/WorkStealingPool.hpp"
+#include <assert.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	std::string readFile(const std::string& path)
+	{
+		std::ifstream file(path);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		return contents.str();
+	}
+
+	size_t countOccurrences(const std::string& text, const std::string& pattern)
+	{
+		size_t count = 0;
+		for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
+
+void TimelineUnitTests::runOperationalTests()
+{
+	testSpansWrittenAsChromeTrace();
+	testEngineSpans();
+	std::cout << "** Timeline operational tests passed **" << std::endl;
+}
+
+// Warning: These tests may throw an error
+void TimelineUnitTests::runCrashTests()
+{
+	testUnwritablePath();
+	std::cout << "** Timeline crash tests passed **" << std::endl;
+}
+
+void TimelineUnitTests::testSpansWrittenAsChromeTrace()
+{
+	{
+		// nothing is recorded before Start()
+		Timeline::Span ignored("ignored", 1, 1);
+	}
+	Timeline::Start();
+	{
+		Timeline::Span outer("outer", /*entity*/7, /*attribute*/AttributeKey_Power);
+		Timeline::Span inner("inner \"quoted\"");
+	}
+	std::thread worker([]()
+		{
+			Timeline::Span span("worker", /*entity*/8);
+		});
+	worker.join();
+	Timeline::Stop();
+	{
+		Timeline::Span ignored("ignored", 1, 1);
+	}
+	assert(Timeline::SpanCount() == 3);
+	assert(Timeline::DroppedCount() == 0);
+
+	[[maybe_unused]] bool written = Timeline::WriteChromeTrace(path);
+	assert(written);
+	std::string json = readFile(path);
+	std::remove(path.c_str());
+	assert(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+	assert(json.rfind("]}") != std::string::npos);
+	assert(countOccurrences(json, "\"ph\":\"X\"") == 3);
+	assert(json.find("ignored") == std::string::npos);
+	assert(json.find("\"name\":\"outer\"") != std::string::npos);
+	assert(json.find("\"args\":{\"entity\":7,\"attribute\":1}") != std::string::npos);
+	assert(json.find("\"name\":\"inner \\\"quoted\\\"\"") != std::string::npos);
+	assert(json.find("\"args\":{\"entity\":8}") != std::string::npos);
+	// one thread_name record per thread that recorded spans
+	assert(countOccurrences(json, "\"thread_name\"") == 2);
+
+	// Start() discards the previous recording
+	Timeline::Start();
+	Timeline::Stop();
+	assert(Timeline::SpanCount() == 0);
+	std::cout << "testSpansWrittenAsChromeTrace passed" << std::endl;
+}
+
+void TimelineUnitTests::testEngineSpans()
+{
+	Timeline::Start();
+	LayeredAttributes_v7 attributes;
+	attributes.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	attributes.AddLayeredEffect({ AttributeKey_Power, EffectOperation_Set, /*modifier*/3, /*layer*/0 });
+	[[maybe_unused]] int power = attributes.GetCurrentAttribute(AttributeKey_Power);
+	assert(power == 4);
+
+	AttributeWorld world;
+	std::vector<AttributeWorld::Entity> entities;
+	for (int i = 0; i < 3000; ++i)
+	{
+		entities.push_back(world.CreateEntity());
+	}
+	world.AddLayeredEffect(entities, { AttributeKey_Toughness, EffectOperation_Add, /*modifier*/1, /*layer*/1 });
+	world.AddLayeredEffect(entities[5], { AttributeKey_Toughness, EffectOperation_Set, /*modifier*/0, /*layer*/0 });
+	WorkStealingPool pool(2);
+	world.RecomputeDirty(pool);
+	Timeline::Stop();
+
+	[[maybe_unused]] bool written = Timeline::WriteChromeTrace(path);
+	assert(written);
+	std::string json = readFile(path);
+	std::remove(path.c_str());
+	if (!Timeline::Enabled)
+	{
+		// compiled out: the engines never open a span
+		assert(Timeline::SpanCount() == 0);
+		assert(countOccurrences(json, "\"ph\":\"X\"") == 0);
+		std::cout << "testEngineSpans passed (timeline disabled)" << std::endl;
+		return;
+	}
+	assert(json.find("\"name\":\"LayeredAttributes_v7::AddLayeredEffect\"") != std::string::npos);
+	assert(json.find("\"name\":\"LayeredAttributes_v7::calculateAttribute\"") != std::string::npos);
+	assert(json.find("\"name\":\"AttributeWorld::AddLayeredEffect\",\"cat\"") != std::string::npos);
+	assert(json.find("\"args\":{\"entity\":5,\"attribute\":2}") != std::string::npos);
+	assert(json.find("\"name\":\"AttributeWorld::RecomputeDirty\"") != std::string::npos);
+	// 3000 entities make three chunks
+	assert(countOccurrences(json, "\"name\":\"AttributeWorld::recomputeChunk\"") == 3);
+	std::cout << "testEngineSpans passed" << std::endl;
+}
+
+void TimelineUnitTests::testUnwritablePath()
+{
+	Timeline::Start();
+	Timeline::Stop();
+	[[maybe_unused]] bool written = Timeline::WriteChromeTrace("no-such-directory/timeline.json");
+	assert(!written);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+class TimelineUnitTests
+{
+public:
+	TimelineUnitTests() = default;
+	void runOperationalTests();
+	void runCrashTests(); // may throw errors
+
+private:
+	// scratch file, removed after every test
+	const std::string path = "TimelineUnitTests.json";
+
+	// operational tests
+	void testSpansWrittenAsChromeTrace();
+	void testEngineSpans();
+
+	// crash tests
+	void testUnwritablePath();
+};